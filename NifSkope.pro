@@ -5,7 +5,7 @@
 TEMPLATE = vcapp
 TARGET   = NifSkope
 
-QT += xml opengl network widgets
+QT += xml opengl network widgets concurrent
 
 # Require Qt 5.7 or higher
 contains(QT_VERSION, ^5\\.[0-6]\\..*) {
@@ -17,7 +17,7 @@ contains(QT_VERSION, ^5\\.[0-6]\\..*) {
 CONFIG += c++20
 
 # Dependencies
-CONFIG += nvtristrip qhull zlib lz4 fsengine gli
+CONFIG += qhull zlib lz4 fsengine gli
 
 # Debug/Release options
 CONFIG(debug, debug|release) {
@@ -139,12 +139,16 @@ INCLUDEPATH += src lib
 
 HEADERS += \
 	src/data/nifitem.h \
+	src/data/nifitemarena.h \
 	src/data/niftypes.h \
 	src/data/nifvalue.h \
+	src/gl/gltools/animationbaker.h \
 	src/gl/gltools/boneweights.h \
 	src/gl/gltools/boundsphere.h \
+	src/gl/gltools/meshoptimizer.h \
 	src/gl/gltools/skinpartition.h \
 	src/gl/gltools/vertexweight.h \
+	src/gl/gltools/vertexweld.h \
 	src/gl/marker/constraints.h \
 	src/gl/marker/furniture.h \
 	src/gl/bsshape.h \
@@ -181,6 +185,7 @@ HEADERS += \
 	src/spells/tangentspace.h \
 	src/spells/texture.h \
 	src/spells/transform.h \
+	src/ui/widgets/arrayedit.h \
 	src/ui/widgets/colorwheel.h \
 	src/ui/widgets/fileselect.h \
 	src/ui/widgets/floatedit.h \
@@ -216,6 +221,7 @@ HEADERS += \
 	lib/tiny_gltf.h
 
 SOURCES += \
+	src/data/nifitemarena.cpp \
 	src/data/niftypes.cpp \
 	src/data/nifvalue.cpp \
 	src/gl/bsshape.cpp \
@@ -230,9 +236,12 @@ SOURCES += \
 	src/gl/gltex.cpp \
 	src/gl/gltexloaders.cpp \
 	src/gl/gltools.cpp \
+	src/gl/gltools/animationbaker.cpp \
 	src/gl/gltools/boneweights.cpp \
 	src/gl/gltools/boundsphere.cpp \
+	src/gl/gltools/meshoptimizer.cpp \
 	src/gl/gltools/skinpartition.cpp \
+	src/gl/gltools/vertexweld.cpp \
 	src/gl/renderer.cpp \
 	src/io/material.cpp \
 	src/io/nifstream.cpp \
@@ -274,6 +283,7 @@ SOURCES += \
 	src/spells/tangentspace.cpp \
 	src/spells/texture.cpp \
 	src/spells/transform.cpp \
+	src/ui/widgets/arrayedit.cpp \
 	src/ui/widgets/colorwheel.cpp \
 	src/ui/widgets/fileselect.cpp \
 	src/ui/widgets/floatedit.cpp \
@@ -333,18 +343,6 @@ fsengine {
 		lib/fsengine/fsengine.cpp
 }
 
-nvtristrip {
-	INCLUDEPATH += lib/NvTriStrip
-	HEADERS += \
-		lib/NvTriStrip/NvTriStrip.h \
-		lib/NvTriStrip/NvTriStripObjects.h \
-		lib/NvTriStrip/VertexCache.h
-	SOURCES += \
-		lib/NvTriStrip/NvTriStrip.cpp \
-		lib/NvTriStrip/NvTriStripObjects.cpp \
-		lib/NvTriStrip/VertexCache.cpp
-}
-
 qhull {
     !*msvc*:QMAKE_CFLAGS += -isystem ../nifskope/lib/qhull/src
     !*msvc*:QMAKE_CXXFLAGS += -isystem ../nifskope/lib/qhull/src
@@ -44,7 +44,6 @@ FILES="NifSkope.pro \
     widgets/*.h \
     spells/*.h \
     importex/*.h \
-    NvTriStrip/*.h \
     niftypes.cpp \
     nifvalue.cpp \
     basemodel.cpp \
@@ -64,7 +63,6 @@ FILES="NifSkope.pro \
     widgets/*.cpp \
     spells/*.cpp \
     importex/*.cpp \
-    NvTriStrip/*.cpp \
     fsengine/*.h \
     fsengine/*.cpp
     shaders/*.frag
@@ -141,7 +139,7 @@ cd ../linux-install
 
 # copy source files
 cd nifskope-$VERSION
-mkdir -p gl widgets NvTriStrip spells importex fsengine
+mkdir -p gl widgets spells importex fsengine
 cd ../..
 cp --parents $FILES linux-install/nifskope-$VERSION
 cd linux-install
@@ -33,6 +33,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef NIFITEM_H
 #define NIFITEM_H
 
+#include "data/nifitemarena.h"
 #include "data/nifvalue.h"
 #include "xml/nifexpr.h"
 
@@ -41,6 +42,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QString>
 #include <QVector>
 
+#include <algorithm>
+
 
 //! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData
 
@@ -138,6 +141,8 @@ public:
 	NifData()
 		: d( new NifSharedData() ) {}
 
+	//! Identity of the shared definition; copies share it until one of them is modified.
+	inline const void * key() const { return d.constData(); }
 	//! Get the name of the data.
 	inline const QString & name() const { return d->name; }
 	//! Get the type of the data.
@@ -284,6 +289,37 @@ public:
 		qDeleteAll( childItems );
 	}
 
+	//! Allocate an item from the slabs of \a arena
+	static void * operator new( size_t size, NifItemArena & arena )
+	{
+		return arena.allocate( size );
+	}
+
+	static void operator delete( void * p, NifItemArena & )
+	{
+		NifItemArena::release( p );
+	}
+
+	static void operator delete( void * p )
+	{
+		NifItemArena::release( p );
+	}
+
+	//! Return the arena that children of this item are allocated from
+	NifItemArena & arena() const
+	{
+		const NifItem * top = this;
+		while ( top->parentItem )
+			top = top->parentItem;
+
+		if ( NifItemArena * owner = NifItemArena::owner( top ) )
+			return *owner;
+
+		// The tree was detached from a model that no longer exists
+		static NifItemArena shared( sizeof( NifItem ) );
+		return shared;
+	}
+
 	//! Return the parent item.
 	NifItem * parent() const
 	{
@@ -296,9 +332,6 @@ public:
 		if ( !parentItem )
 			return 0;
 
-		if ( rowIdx < 0 )
-			rowIdx = parentItem->childItems.indexOf( const_cast<NifItem *>(this) );
-
 		return rowIdx;
 	}
 
@@ -325,17 +358,17 @@ public:
 	 */
 	NifItem * insertChild( const NifData & data, int at = -1 )
 	{
-		NifItem * item = new NifItem( data, this );
+		NifItem * item = new ( arena() ) NifItem( data, this );
 
 		if ( data.isConditionless() )
 			item->setCondition( true );
 
 		if ( at < 0 || at > childItems.count() ) {
+			item->rowIdx = childItems.count();
 			childItems.append( item );
 		} else {
-			if ( at < childItems.size() - 1 )
-				invalidateRowCounts();
 			childItems.insert( at, item );
+			updateRows( at );
 		}
 
 		populateLinksUp( item );
@@ -354,10 +387,11 @@ public:
 		child->parentItem = this;
 
 		if ( at < 0 || at > childItems.count() ) {
+			child->rowIdx = childItems.count();
 			childItems.append( child );
 		} else {
-			invalidateRowCounts();
 			childItems.insert( at, child );
+			updateRows( at );
 		}
 
 		populateLinksUp( child );
@@ -395,10 +429,11 @@ public:
 	NifItem * takeChild( int row )
 	{
 		NifItem * item = child( row );
-		invalidateRowCounts();
 		if ( item ) {
 			childItems.remove( row );
+			updateRows( row );
 			item->parentItem = 0;
+			item->rowIdx = 0;
 		}
 
 		return item;
@@ -411,9 +446,9 @@ public:
 	void removeChild( int row )
 	{
 		NifItem * item = child( row );
-		invalidateRowCounts();
 		if ( item ) {
 			childItems.remove( row );
+			updateRows( row );
 			delete item;
 		}
 	}
@@ -425,7 +460,6 @@ public:
 	 */
 	void removeChildren( int row, int count )
 	{
-		invalidateRowCounts();
 		for ( int c = row; c < row + count; c++ ) {
 			NifItem * item = childItems.value( c );
 			if ( item )
@@ -433,6 +467,7 @@ public:
 		}
 
 		childItems.remove( row, count );
+		updateRows( row );
 	}
 
 	//! Return the child item at the specified row
@@ -490,6 +525,13 @@ public:
 		return linkRows;
 	}
 
+	//! Forget the link rows, once all child items were removed
+	void clearLinkRows()
+	{
+		linkRows.clear();
+		linkAncestorRows.clear();
+	}
+
 	//! Conditions for each child in the array (if fixed)
 	const QVector<bool> & arrayConditions()
 	{
@@ -570,60 +612,40 @@ public:
 		vercondStatus = -1;
 	}
 
-	//! Invalidate the cached row index
-	void invalidateRow()
+	//! Renumber the children from the given row on after a structural edit
+	void updateRows( int at = 0 )
 	{
-		rowIdx = -1;
-	}
-
-	//! Invalidate the cached row index for this item and its children
-	void invalidateRowCounts()
-	{
-		invalidateRow();
-		for ( NifItem * c : childItems ) {
-			c->invalidateRow();
-		}
-	}
-
-	//! Invalidate the cached row index for this item and its children starting at the given index
-	void invalidateRowCounts( int at )
-	{
-		if ( at < childCount() ) {
-			invalidateRow();
-			for ( int i = at; i < childCount(); i++ ) {
-				childItems.value( i )->invalidateRow();
-			}
-		} else {
-			invalidateRowCounts();
-		}
-
+		for ( int i = std::max( at, 0 ); i < childItems.count(); i++ )
+			childItems[i]->rowIdx = i;
 	}
 
+	//! Return the item data
+	inline const NifData & data() const { return itemData; }
 	//! Return the value of the item data (const version)
 	inline const NifValue & value() const { return itemData.value; }
 	//! Return the value of the item data
 	inline NifValue & value() { return itemData.value; }
 
 	//! Return the name of the data
-	inline QString name() const {   return itemData.name(); }
+	inline const QString & name() const {   return itemData.name(); }
 	//! Return the type of the data
-	inline QString type() const {   return itemData.type(); }
+	inline const QString & type() const {   return itemData.type(); }
 	//! Return the template type of the data
-	inline QString temp() const {   return itemData.temp(); }
+	inline const QString & temp() const {   return itemData.temp(); }
 	//! Return the argument attribute of the data
-	inline QString arg()  const {   return itemData.arg();  }
+	inline const QString & arg() const {   return itemData.arg();  }
 	//! Return the first array length of the data
-	inline QString arr1() const {   return itemData.arr1(); }
+	inline const QString & arr1() const {   return itemData.arr1(); }
 	//! Return the second array length of the data
-	inline QString arr2() const {   return itemData.arr2(); }
+	inline const QString & arr2() const {   return itemData.arr2(); }
 	//! Return the condition attribute of the data
-	inline QString cond() const {   return itemData.cond(); }
+	inline const QString & cond() const {   return itemData.cond(); }
 	//! Return the earliest version attribute of the data
 	inline quint32 ver1() const {   return itemData.ver1(); }
 	//! Return the latest version attribute of the data
 	inline quint32 ver2() const {   return itemData.ver2(); }
 	//! Return the description text of the data
-	inline QString text() const {   return itemData.text(); }
+	inline const QString & text() const {   return itemData.text(); }
 
 	//! Return the condition attribute of the data, as an expression
 	inline const NifExpr & argexpr() const { return itemData.argexpr(); }
@@ -632,7 +654,7 @@ public:
 	//! Return the arr1 attribute of the data, as an expression
 	inline const NifExpr & arr1expr() const {   return itemData.arr1expr(); }
 	//! Return the version condition attribute of the data
-	inline QString vercond() const {   return itemData.vercond();  }
+	inline const QString & vercond() const {   return itemData.vercond();  }
 	//! Return the version condition attribute of the data, as an expression
 	inline const NifExpr & verexpr() const {   return itemData.verexpr();  }
 	//! Return the abstract attribute of the data
@@ -723,8 +745,8 @@ private:
 	//! If item is array with fixed compounds, the conditions are stored here for reuse
 	QVector<bool> arrConds;
 
-	//! Item's row index, -1 is invalid, otherwise 0+
-	mutable int rowIdx = -1;
+	//! Item's row in its parent, kept current by every structural edit of the parent
+	int rowIdx = 0;
 	//! Item's condition status, -1 is invalid, otherwise 0/1
 	char conditionStatus = -1;
 	//! Item's vercond status, -1 is invalid, otherwise 0/1
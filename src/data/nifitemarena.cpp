@@ -0,0 +1,170 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "nifitemarena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+
+//! @file nifitemarena.cpp NifItemArena
+
+struct NifItemArena::Slab
+{
+	//! Owning arena, null once the arena is destroyed
+	NifItemArena * arena;
+	//! Singly linked list of released slots
+	void * freeList;
+	//! Number of slots handed out and not yet released
+	int live;
+	//! Number of slots taken from the untouched end of the slab
+	int used;
+	//! Whether the slab is in the arena's list of slabs with room
+	bool listed;
+};
+
+size_t NifItemArena::slotOffset()
+{
+	constexpr size_t align = alignof( std::max_align_t );
+	return ( sizeof( Slab ) + align - 1 ) / align * align;
+}
+
+NifItemArena::NifItemArena( size_t size )
+{
+	constexpr size_t align = alignof( std::max_align_t );
+
+	slotSize = std::max( ( size + align - 1 ) / align * align, sizeof( void * ) );
+	capacity = int( ( SlabSize - slotOffset() ) / slotSize );
+}
+
+NifItemArena::~NifItemArena()
+{
+	for ( Slab * slab : slabs ) {
+		if ( slab->live == 0 )
+			freeSlab( slab );
+		else
+			slab->arena = nullptr;
+	}
+}
+
+NifItemArena::Slab * NifItemArena::slabOf( const void * p )
+{
+	return reinterpret_cast<Slab *>( reinterpret_cast<std::uintptr_t>( p ) & ~std::uintptr_t( SlabSize - 1 ) );
+}
+
+NifItemArena * NifItemArena::owner( const void * p )
+{
+	return slabOf( p )->arena;
+}
+
+NifItemArena::Slab * NifItemArena::newSlab()
+{
+	Slab * slab = static_cast<Slab *>( ::operator new( SlabSize, std::align_val_t( SlabSize ) ) );
+	slab->arena = this;
+	slab->freeList = nullptr;
+	slab->live = 0;
+	slab->used = 0;
+	slab->listed = true;
+
+	slabs.append( slab );
+	partial.append( slab );
+	return slab;
+}
+
+void NifItemArena::freeSlab( Slab * slab )
+{
+	::operator delete( slab, std::align_val_t( SlabSize ) );
+}
+
+void * NifItemArena::allocate( size_t size )
+{
+	if ( size > slotSize )
+		throw std::bad_alloc();
+
+	while ( !partial.isEmpty() ) {
+		Slab * slab = partial.last();
+
+		if ( slab->freeList ) {
+			void * p = slab->freeList;
+			slab->freeList = *static_cast<void **>( p );
+			slab->live++;
+			return p;
+		}
+
+		if ( slab->used < capacity ) {
+			void * p = reinterpret_cast<char *>( slab ) + slotOffset() + size_t( slab->used++ ) * slotSize;
+			slab->live++;
+			return p;
+		}
+
+		slab->listed = false;
+		partial.removeLast();
+	}
+
+	Slab * slab = newSlab();
+	void * p = reinterpret_cast<char *>( slab ) + slotOffset();
+	slab->used = 1;
+	slab->live = 1;
+	return p;
+}
+
+void NifItemArena::release( void * p )
+{
+	if ( !p )
+		return;
+
+	Slab * slab = slabOf( p );
+	*static_cast<void **>( p ) = slab->freeList;
+	slab->freeList = p;
+	slab->live--;
+
+	NifItemArena * arena = slab->arena;
+	if ( !arena ) {
+		if ( slab->live == 0 )
+			freeSlab( slab );
+	} else if ( !slab->listed ) {
+		slab->listed = true;
+		arena->partial.append( slab );
+	}
+}
+
+void NifItemArena::trim()
+{
+	auto empty = []( Slab * slab ) { return slab->live == 0; };
+
+	partial.erase( std::remove_if( partial.begin(), partial.end(), empty ), partial.end() );
+
+	auto kept = std::stable_partition( slabs.begin(), slabs.end(), []( Slab * slab ) { return slab->live > 0; } );
+	std::for_each( kept, slabs.end(), freeSlab );
+	slabs.erase( kept, slabs.end() );
+}
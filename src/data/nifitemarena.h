@@ -0,0 +1,93 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef NIFITEMARENA_H
+#define NIFITEMARENA_H
+
+#include <QVector>
+
+#include <cstddef>
+
+
+//! @file nifitemarena.h NifItemArena
+
+/*! Slab allocator for the items of one model.
+ *
+ * Items are carved out of large aligned slabs, so loading a file costs one
+ * allocation per slab instead of one per item. Freed slots go on a free list
+ * in their slab and are reused by later edits. A slab that holds no items
+ * anymore can be handed back in bulk with trim().
+ *
+ * Items may outlive their arena when they are moved to another model; the
+ * remaining slabs are then orphaned and freed once their last item goes.
+ *
+ * Not thread-safe: an arena and its items belong to the thread of the model.
+ */
+class NifItemArena final
+{
+public:
+	//! Size of a slab; slabs are aligned to it so any slot finds its slab by masking
+	static constexpr size_t SlabSize = 64 * 1024;
+
+	explicit NifItemArena( size_t slotSize );
+	~NifItemArena();
+
+	NifItemArena( const NifItemArena & ) = delete;
+	NifItemArena & operator=( const NifItemArena & ) = delete;
+
+	//! Allocate one slot of at most the slot size
+	void * allocate( size_t size );
+	//! Return a slot to its slab
+	static void release( void * p );
+	//! The arena a slot was allocated from, or null if its arena is gone
+	static NifItemArena * owner( const void * p );
+	//! Free every slab that holds no items
+	void trim();
+
+private:
+	struct Slab;
+
+	static Slab * slabOf( const void * p );
+	static size_t slotOffset();
+	Slab * newSlab();
+	static void freeSlab( Slab * slab );
+
+	size_t slotSize;
+	int capacity;
+
+	//! Every slab owned by the arena
+	QVector<Slab *> slabs;
+	//! Slabs that have room left, most recent last
+	QVector<Slab *> partial;
+};
+
+#endif
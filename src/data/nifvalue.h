@@ -70,6 +70,7 @@ class NifValue
 	friend class NifIStream;
 	friend class NifOStream;
 	friend class NifSStream;
+	friend class UndoJournal;
 
 public:
 	/*! List of all types implemented internally by NifSkope.
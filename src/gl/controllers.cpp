@@ -39,6 +39,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/glscene.h"
 #include "model/nifmodel.h"
 
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
 
 // `NiControllerManager` blocks
 
@@ -258,6 +262,28 @@ void TransformController::updateTime( float time )
 	}
 }
 
+bool TransformController::update( const NifModel * nif, const QModelIndex & index )
+{
+	if ( Controller::update( nif, index ) ) {
+		if ( interpolator )
+			interpolator->update( nif, iInterpolator );
+
+		return true;
+	}
+
+	// B-spline control points are decompressed by the interpolator
+	if ( interpolator && index.isValid() && iInterpolator.isValid() ) {
+		int block = nif->getBlockNumber( index );
+
+		if ( block == nif->getLink( iInterpolator, "Spline Data" ) || block == nif->getLink( iInterpolator, "Basis Data" ) ) {
+			interpolator->update( nif, iInterpolator );
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void TransformController::setInterpolator( const QModelIndex & idx )
 {
 	const NifModel * nif = static_cast<const NifModel *>(idx.model());
@@ -421,7 +447,9 @@ void MorphController::updateTime( float time )
 	if ( target->verts.count() != morph[0]->verts.count() )
 		return;
 
-	target->verts = morph[0]->verts;
+	// Only morphs with weight contribute, most facegen morphs are idle at any time
+	QVector<QPair<MorphKey *, float>> weights;
+	int work = 0;
 
 	float x;
 
@@ -434,16 +462,59 @@ void MorphController::updateTime( float time )
 			if ( x > 1 )
 				x = 1;
 
-			if ( x != 0 && target->verts.count() == key->verts.count() ) {
-				for ( int v = 0; v < target->verts.count(); v++ )
-					target->verts[v] += key->verts[v] * x;
+			if ( x != 0 && target->verts.count() == key->count && !key->verts.isEmpty() ) {
+				weights.append( { key, x } );
+				work += key->verts.count();
 			}
 		}
 	}
 
+	target->verts = morph[0]->verts;
+
+	int count = target->verts.count();
+
+	// Split large blends into vertex ranges; each range only touches its own vertices
+	const int rangeSize = 16384;
+
+	if ( work > 4 * rangeSize && count > rangeSize ) {
+		QVector<QPair<int, int>> ranges;
+		for ( int v = 0; v < count; v += rangeSize )
+			ranges.append( { v, qMin( v + rangeSize, count ) } );
+
+		Vector3 * verts = target->verts.data();
+
+		QtConcurrent::blockingMap( ranges, [verts, &weights]( QPair<int, int> & range ) {
+			blend( verts, weights, range.first, range.second );
+		} );
+	} else if ( !weights.isEmpty() ) {
+		blend( target->verts.data(), weights, 0, count );
+	}
+
 	target->updateBounds = true;
 }
 
+void MorphController::blend( Vector3 * verts, const QVector<QPair<MorphKey *, float>> & weights, int first, int last )
+{
+	for ( const auto & w : weights ) {
+		const MorphKey * key = w.first;
+		const float x = w.second;
+		const Vector3 * deltas = key->verts.constData();
+
+		if ( key->indices.isEmpty() ) {
+			for ( int v = first; v < last; v++ )
+				verts[v] += deltas[v] * x;
+		} else {
+			// Indices are ascending, find the first one in range
+			const int * indices = key->indices.constData();
+			int n = key->indices.count();
+			int k = std::lower_bound( indices, indices + n, first ) - indices;
+
+			for ( ; k < n && indices[k] < last; k++ )
+				verts[indices[k]] += deltas[k] * x;
+		}
+	}
+}
+
 bool MorphController::update( const NifModel * nif, const QModelIndex & index )
 {
 	if ( Controller::update( nif, index ) ) {
@@ -476,6 +547,27 @@ bool MorphController::update( const NifModel * nif, const QModelIndex & index )
 			}
 
 			key->verts = nif->getArray<Vector3>( nif->getIndex( iKey, "Vectors" ) );
+			key->count = key->verts.count();
+
+			// Store the deltas of the other morphs sparsely when most vertices do not move
+			if ( r > 0 ) {
+				QVector<int> indices;
+				QVector<Vector3> deltas;
+
+				for ( int v = 0; v < key->count; v++ ) {
+					const Vector3 & d = key->verts[v];
+
+					if ( d[0] != 0.0f || d[1] != 0.0f || d[2] != 0.0f ) {
+						indices.append( v );
+						deltas.append( d );
+					}
+				}
+
+				if ( indices.count() < key->count / 2 ) {
+					key->indices = indices;
+					key->verts = deltas;
+				}
+			}
 
 			morph.append( key );
 		}
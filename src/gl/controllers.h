@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/glcontroller.h" // Inherited
 #include "data/niftypes.h"
 
+#include <QPair>
 #include <QPointer>
 
 
@@ -88,6 +89,8 @@ public:
 
 	void updateTime( float time ) override final;
 
+	bool update( const NifModel * nif, const QModelIndex & index ) override final;
+
 	void setInterpolator( const QModelIndex & idx ) override final;
 
 protected:
@@ -140,10 +143,18 @@ class MorphController final : public Controller
 	struct MorphKey
 	{
 		QPersistentModelIndex iFrames;
+		//! Vertices of the base morph, or deltas of the other morphs
 		QVector<Vector3> verts;
+		//! Vertices the deltas apply to; empty if the deltas are stored for every vertex
+		QVector<int> indices;
+		//! Number of vertices of the morph
+		int count = 0;
 		int index;
 	};
 
+	//! Add the weighted deltas of the morphs to the vertices [first, last)
+	static void blend( Vector3 * verts, const QVector<QPair<MorphKey *, float>> & weights, int first, int last );
+
 public:
 	MorphController( Shape * mesh, const QModelIndex & index );
 	~MorphController();
@@ -35,6 +35,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/glscene.h"
 #include "model/nifmodel.h"
 
+#include <algorithm>
+
 
 //! @file glcontroller.cpp Controllable management, Interpolation management
 
@@ -211,6 +213,20 @@ void Controller::setInterpolator( const QModelIndex & index )
 
 bool Controller::update( const NifModel * nif, const QModelIndex & index )
 {
+	// Drop decoded keys of the changed block
+	if ( !index.isValid() ) {
+		keyCache.clear();
+	} else if ( !keyCache.isEmpty() ) {
+		int block = nif->getBlockNumber( index );
+
+		for ( auto it = keyCache.begin(); it != keyCache.end(); ) {
+			if ( it.value().block == block || !it.key().isValid() )
+				it = keyCache.erase( it );
+			else
+				++it;
+		}
+	}
+
 	if ( iBlock.isValid() && iBlock == index ) {
 		start = nif->get<float>( index, "Start Time" );
 		stop  = nif->get<float>( index, "Stop Time" );
@@ -291,271 +307,336 @@ float Controller::ctrlTime( float time ) const
 	}
 }
 
-bool Controller::timeIndex( float time, const NifModel * nif, const QModelIndex & array, int & i, int & j, float & x )
+bool Controller::timeIndex( float time, const QVector<float> & times, int & i, int & j, float & x )
 {
-	int count;
+	int count = times.count();
 
-	if ( array.isValid() && ( count = nif->rowCount( array ) ) > 0 ) {
-		if ( time <= nif->get<float>( array.child( 0, 0 ), "Time" ) ) {
-			i = j = 0;
-			x = 0.0;
+	if ( count <= 0 )
+		return false;
 
-			return true;
-		}
+	if ( time <= times[0] ) {
+		i = j = 0;
+		x = 0.0;
 
-		if ( time >= nif->get<float>( array.child( count - 1, 0 ), "Time" ) ) {
-			i = j = count - 1;
-			x = 0.0;
+		return true;
+	}
 
-			return true;
-		}
+	if ( time >= times[count - 1] ) {
+		i = j = count - 1;
+		x = 0.0;
 
-		if ( i < 0 || i >= count )
-			i = 0;
+		return true;
+	}
 
-		float tI = nif->get<float>( array.child( i, 0 ), "Time" );
+	// Playback usually stays in the last interval or advances to the next one
+	if ( i < 0 || i >= count - 1 || time < times[i] || time >= times[i + 1] ) {
+		if ( i >= 0 && i < count - 2 && time >= times[i + 1] && time < times[i + 2] )
+			i++;
+		else
+			i = int( std::upper_bound( times.constBegin(), times.constEnd(), time ) - times.constBegin() ) - 1;
+	}
 
-		if ( time > tI ) {
-			j = i + 1;
-			float tJ;
+	j = i + 1;
 
-			while ( time >= ( tJ = nif->get<float>( array.child( j, 0 ), "Time" ) ) ) {
-				i  = j++;
-				tI = tJ;
-			}
+	float tI = times[i];
+	float tJ = times[j];
 
-			x = ( time - tI ) / ( tJ - tI );
+	x = ( tJ > tI ) ? ( time - tI ) / ( tJ - tI ) : 0.0f;
 
-			return true;
-		} else if ( time < tI ) {
-			j = i - 1;
-			float tJ;
+	return true;
+}
 
-			while ( time <= ( tJ = nif->get<float>( array.child( j, 0 ), "Time" ) ) ) {
-				i  = j--;
-				tI = tJ;
-			}
+template <typename T> static void storeKeyValue( KeyData & keys, const T & v )
+{
+	const float * vf = (const float *)&v; // assume value is a vector of floats
 
-			x = ( time - tI ) / ( tJ - tI );
+	for ( int c = 0; c < keys.stride; c++ )
+		keys.values.append( vf[c] );
+}
 
-			// Quadratic Bug Fix
+template <typename T> static T keyValue( const KeyData & keys, int i )
+{
+	T v;
+	float * vf = (float *)&v; // assume value is a vector of floats
+	const float * src = keys.values.constData() + i * keys.stride;
 
-			// Invert x
-			//	Previously, this branch was causing x to decrement from 1.0.
-			//	(This works fine for linear interpolation apparently)
-			x = 1.0 - x;
-			
-			// Swap I and J
-			//	With x inverted, we must swap I and J or the animation will reverse.
-			auto tmpI = i;
-			i = j;
-			j = tmpI;
+	for ( int c = 0; c < keys.stride; c++ )
+		vf[c] = src[c];
 
-			// End Bug Fix
+	return v;
+}
 
-			return true;
-		}
+template <typename T> KeyData Controller::decodeKeys( const NifModel * nif, const QModelIndex & array )
+{
+	KeyData keys;
+	QModelIndex frames = nif->getIndex( array, "Keys" );
+	int count = frames.isValid() ? nif->rowCount( frames ) : 0;
 
-		j = i;
-		x = 0.0;
+	keys.type = nif->get<int>( array, "Interpolation" );
+	keys.stride = sizeof(T) / sizeof(float);
+	keys.times.reserve( count );
+	keys.values.reserve( count * keys.stride );
 
-		return true;
+	for ( int r = 0; r < count; r++ ) {
+		QModelIndex iKey = frames.child( r, 0 );
+
+		keys.times.append( nif->get<float>( iKey, "Time" ) );
+		storeKeyValue( keys, nif->get<T>( iKey, "Value" ) );
+
+		if ( keys.type == 2 ) {
+			keys.forward.append( nif->get<float>( iKey, "Forward" ) );
+			keys.backward.append( nif->get<float>( iKey, "Backward" ) );
+		}
 	}
 
-	return false;
+	return keys;
 }
 
-template <typename T> bool interpolate( T & value, const QModelIndex & array, float time, int & last )
+template <> KeyData Controller::decodeKeys<bool>( const NifModel * nif, const QModelIndex & array )
 {
-	const NifModel * nif = static_cast<const NifModel *>( array.model() );
+	KeyData keys;
+	QModelIndex frames = nif->getIndex( array, "Keys" );
+	int count = frames.isValid() ? nif->rowCount( frames ) : 0;
 
-	if ( nif && array.isValid() ) {
-		QModelIndex frames = nif->getIndex( array, "Keys" );
-		int next;
-		float x;
-
-		if ( Controller::timeIndex( time, nif, frames, last, next, x ) ) {
-			T v1 = nif->get<T>( frames.child( last, 0 ), "Value" );
-			T v2 = nif->get<T>( frames.child( next, 0 ), "Value" );
-
-			switch ( nif->get<int>( array, "Interpolation" ) ) {
-			
-			case 2:
-			{
-				// Quadratic
-				/*
-					In general, for keyframe values v1 = 0, v2 = 1 it appears that
-					setting v1's corresponding "Backward" value to 1 and v2's
-					corresponding "Forward" to 1 results in a linear interpolation.
-				*/
-
-				// Tangent 1
-				float t1 = nif->get<float>( frames.child( last, 0 ), "Backward" );
-				// Tangent 2
-				float t2 = nif->get<float>( frames.child( next, 0 ), "Forward" );
-
-				float x2 = x * x;
-				float x3 = x2 * x;
-
-				// Cubic Hermite spline
-				//	x(t) = (2t^3 - 3t^2 + 1)P1  + (-2t^3 + 3t^2)P2 + (t^3 - 2t^2 + t)T1 + (t^3 - t^2)T2
-
-				value = v1 * (2.0f * x3 - 3.0f * x2 + 1.0f) + v2 * (-2.0f * x3 + 3.0f * x2) + t1 * (x3 - 2.0f * x2 + x) + t2 * (x3 - x2);
-
-			}	return true;
-			
-			case 5:
-				// Constant
-				if ( x < 0.5 )
-					value = v1;
-				else
-					value = v2;
+	keys.type = nif->get<int>( array, "Interpolation" );
+	keys.stride = 1;
+	keys.times.reserve( count );
+	keys.values.reserve( count );
 
-				return true;
-			default:
-				value = v1 + ( v2 - v1 ) * x;
-				return true;
-			}
-		}
+	for ( int r = 0; r < count; r++ ) {
+		QModelIndex iKey = frames.child( r, 0 );
+
+		keys.times.append( nif->get<float>( iKey, "Time" ) );
+		keys.values.append( nif->get<int>( iKey, "Value" ) );
 	}
 
-	return false;
+	return keys;
 }
 
-template <> bool Controller::interpolate( float & value, const QModelIndex & array, float time, int & last )
+template <> KeyData Controller::decodeKeys<Matrix>( const NifModel * nif, const QModelIndex & array )
 {
-	return ::interpolate( value, array, time, last );
-}
+	KeyData keys;
+	keys.type = nif->get<int>( array, "Rotation Type" );
+	keys.stride = 4;
 
-template <> bool Controller::interpolate( Vector3 & value, const QModelIndex & array, float time, int & last )
-{
-	return ::interpolate( value, array, time, last );
-}
+	// XYZ rotations are decoded as separate float key groups
+	if ( keys.type == 4 )
+		return keys;
 
-template <> bool Controller::interpolate( Color4 & value, const QModelIndex & array, float time, int & last )
-{
-	return ::interpolate( value, array, time, last );
+	QModelIndex frames = nif->getIndex( array, "Quaternion Keys" );
+	int count = frames.isValid() ? nif->rowCount( frames ) : 0;
+
+	keys.times.reserve( count );
+	keys.values.reserve( count * keys.stride );
+
+	for ( int r = 0; r < count; r++ ) {
+		QModelIndex iKey = frames.child( r, 0 );
+
+		keys.times.append( nif->get<float>( iKey, "Time" ) );
+		storeKeyValue( keys, nif->get<Quat>( iKey, "Value" ) );
+	}
+
+	return keys;
 }
 
-template <> bool Controller::interpolate( Color3 & value, const QModelIndex & array, float time, int & last )
+template <typename T> const KeyData * Controller::keys( const QModelIndex & array )
 {
-	return ::interpolate( value, array, time, last );
+	QPersistentModelIndex key( array );
+
+	auto it = keyCache.constFind( key );
+	if ( it != keyCache.constEnd() && key.isValid() )
+		return &it.value();
+
+	const NifModel * nif = static_cast<const NifModel *>( array.model() );
+
+	if ( !nif || !array.isValid() )
+		return nullptr;
+
+	KeyData k = decodeKeys<T>( nif, array );
+	k.block = nif->getBlockNumber( array );
+
+	return &keyCache.insert( key, k ).value();
 }
 
-template <> bool Controller::interpolate( bool & value, const QModelIndex & array, float time, int & last )
+template <typename T> bool Controller::interpolateKeys( T & value, const KeyData & keys, float time, int & last )
 {
 	int next;
 	float x;
-	const NifModel * nif = static_cast<const NifModel *>( array.model() );
 
-	if ( nif && array.isValid() ) {
-		QModelIndex frames = nif->getIndex( array, "Keys" );
+	if ( timeIndex( time, keys.times, last, next, x ) ) {
+		T v1 = keyValue<T>( keys, last );
+		T v2 = keyValue<T>( keys, next );
+
+		switch ( keys.type ) {
+
+		case 2:
+		{
+			// Quadratic
+			/*
+				In general, for keyframe values v1 = 0, v2 = 1 it appears that
+				setting v1's corresponding "Backward" value to 1 and v2's
+				corresponding "Forward" to 1 results in a linear interpolation.
+			*/
+
+			// Tangent 1
+			float t1 = keys.backward.value( last );
+			// Tangent 2
+			float t2 = keys.forward.value( next );
+
+			float x2 = x * x;
+			float x3 = x2 * x;
 
-		if ( timeIndex( time, nif, frames, last, next, x ) ) {
-			value = nif->get<int>( frames.child( last, 0 ), "Value" );
+			// Cubic Hermite spline
+			//	x(t) = (2t^3 - 3t^2 + 1)P1  + (-2t^3 + 3t^2)P2 + (t^3 - 2t^2 + t)T1 + (t^3 - t^2)T2
+
+			value = v1 * (2.0f * x3 - 3.0f * x2 + 1.0f) + v2 * (-2.0f * x3 + 3.0f * x2) + t1 * (x3 - 2.0f * x2 + x) + t2 * (x3 - x2);
+
+		}	return true;
+
+		case 5:
+			// Constant
+			if ( x < 0.5 )
+				value = v1;
+			else
+				value = v2;
 
 			return true;
+		default:
+			value = v1 + ( v2 - v1 ) * x;
+			return true;
 		}
 	}
 
 	return false;
 }
 
-template <> bool Controller::interpolate( Matrix & value, const QModelIndex & array, float time, int & last )
+template <> bool Controller::interpolateKeys<bool>( bool & value, const KeyData & keys, float time, int & last )
 {
 	int next;
 	float x;
-	const NifModel * nif = static_cast<const NifModel *>( array.model() );
 
-	if ( nif && array.isValid() ) {
-		switch ( nif->get<int>( array, "Rotation Type" ) ) {
-		case 4:
-			{
-				QModelIndex subkeys = nif->getIndex( array, "XYZ Rotations" );
+	if ( timeIndex( time, keys.times, last, next, x ) ) {
+		value = int( keys.values[last] );
+
+		return true;
+	}
+
+	return false;
+}
 
-				if ( subkeys.isValid() ) {
-					float r[3] = {};
+template <> bool Controller::interpolateKeys<Quat>( Quat & value, const KeyData & keys, float time, int & last )
+{
+	int next;
+	float x;
 
-					for ( int s = 0; s < 3 && s < nif->rowCount( subkeys ); s++ ) {
-						r[s] = 0;
-						interpolate( r[s], subkeys.child( s, 0 ), time, last );
-					}
+	if ( timeIndex( time, keys.times, last, next, x ) ) {
+		Quat v1 = keyValue<Quat>( keys, last );
+		Quat v2 = keyValue<Quat>( keys, next );
 
-					value = Matrix::euler( 0, 0, r[2] ) * Matrix::euler( 0, r[1], 0 ) * Matrix::euler( r[0], 0, 0 );
+		if ( Quat::dotproduct( v1, v2 ) < 0 )
+			v1.negate(); // don't take the long path
 
-					return true;
-				}
-			}
-			break;
-		default:
-			{
-				QModelIndex frames = nif->getIndex( array, "Quaternion Keys" );
-
-				if ( timeIndex( time, nif, frames, last, next, x ) ) {
-					Quat v1 = nif->get<Quat>( frames.child( last, 0 ), "Value" );
-					Quat v2 = nif->get<Quat>( frames.child( next, 0 ), "Value" );
-
-					if ( Quat::dotproduct( v1, v2 ) < 0 )
-						v1.negate(); // don't take the long path
-
-					Quat v3 = Quat::slerp( x, v1, v2 );
-					/*
-					Quat v4;
-					float a = acos( Quat::dotproduct( v1, v2 ) );
-					if ( fabs( a ) >= 0.00005 )
-					{
-					    float i = 1.0 / sin( a );
-					    v4 = v1 * sin( ( 1.0 - x ) * a ) * i + v2 * sin( x * a ) * i;
-					}
-					*/
-					value.fromQuat( v3 );
-
-					return true;
-				}
-			}
-			break;
+		value = Quat::slerp( x, v1, v2 );
+		/*
+		Quat v4;
+		float a = acos( Quat::dotproduct( v1, v2 ) );
+		if ( fabs( a ) >= 0.00005 )
+		{
+		    float i = 1.0 / sin( a );
+		    v4 = v1 * sin( ( 1.0 - x ) * a ) * i + v2 * sin( x * a ) * i;
 		}
+		*/
+
+		return true;
 	}
 
 	return false;
 }
 
-/*********************************************************************
-Simple b-spline curve algorithm
+// Decoding and interpolation are also used to sample keys outside of controllers
+template KeyData Controller::decodeKeys<float>( const NifModel *, const QModelIndex & );
+template KeyData Controller::decodeKeys<Vector3>( const NifModel *, const QModelIndex & );
+template KeyData Controller::decodeKeys<Color3>( const NifModel *, const QModelIndex & );
+template KeyData Controller::decodeKeys<Color4>( const NifModel *, const QModelIndex & );
+template bool Controller::interpolateKeys<float>( float &, const KeyData &, float, int & );
+template bool Controller::interpolateKeys<Vector3>( Vector3 &, const KeyData &, float, int & );
+template bool Controller::interpolateKeys<Color3>( Color3 &, const KeyData &, float, int & );
+template bool Controller::interpolateKeys<Color4>( Color4 &, const KeyData &, float, int & );
 
-Copyright 1994 by Keith Vertanen (vertankd@cda.mrs.umn.edu)
+template <> bool Controller::interpolate( float & value, const QModelIndex & array, float time, int & last )
+{
+	const KeyData * k = keys<float>( array );
+	return k && interpolateKeys( value, *k, time, last );
+}
 
-Released to the public domain (your mileage may vary)
+template <> bool Controller::interpolate( Vector3 & value, const QModelIndex & array, float time, int & last )
+{
+	const KeyData * k = keys<Vector3>( array );
+	return k && interpolateKeys( value, *k, time, last );
+}
 
-Found at: Programmers Heaven (www.programmersheaven.com/zone3/cat415/6660.htm)
-Modified by: Theo
-- reformat and convert doubles to floats
-- removed point structure in favor of arbitrary sized float array
-**********************************************************************/
+template <> bool Controller::interpolate( Color4 & value, const QModelIndex & array, float time, int & last )
+{
+	const KeyData * k = keys<Color4>( array );
+	return k && interpolateKeys( value, *k, time, last );
+}
 
-/*! Used to enable static arrays to be members of vectors */
-template <typename T>
-struct qarray
+template <> bool Controller::interpolate( Color3 & value, const QModelIndex & array, float time, int & last )
 {
-	qarray( const QModelIndex & array, uint off = 0 )
-		: array_( array ), off_( off )
-	{
-		nif_ = static_cast<const NifModel *>( array_.model() );
-	}
-	qarray( const qarray & other, uint off = 0 )
-		: nif_( other.nif_ ), array_( other.array_ ), off_( other.off_ + off )
-	{
-	}
+	const KeyData * k = keys<Color3>( array );
+	return k && interpolateKeys( value, *k, time, last );
+}
 
-	T operator[]( uint index ) const
-	{
-		return nif_->get<T>( array_.child( index + off_, 0 ) );
+template <> bool Controller::interpolate( bool & value, const QModelIndex & array, float time, int & last )
+{
+	const KeyData * k = keys<bool>( array );
+	return k && interpolateKeys( value, *k, time, last );
+}
+
+template <> bool Controller::interpolate( Matrix & value, const QModelIndex & array, float time, int & last )
+{
+	const KeyData * k = keys<Matrix>( array );
+
+	if ( !k )
+		return false;
+
+	switch ( k->type ) {
+	case 4:
+		{
+			const NifModel * nif = static_cast<const NifModel *>( array.model() );
+			QModelIndex subkeys = nif->getIndex( array, "XYZ Rotations" );
+
+			if ( subkeys.isValid() ) {
+				float r[3] = {};
+
+				for ( int s = 0; s < 3 && s < nif->rowCount( subkeys ); s++ ) {
+					r[s] = 0;
+					interpolate( r[s], subkeys.child( s, 0 ), time, last );
+				}
+
+				value = Matrix::euler( 0, 0, r[2] ) * Matrix::euler( 0, r[1], 0 ) * Matrix::euler( r[0], 0, 0 );
+
+				return true;
+			}
+		}
+		break;
+	default:
+		{
+			Quat q;
+
+			if ( interpolateKeys( q, *k, time, last ) ) {
+				value.fromQuat( q );
+
+				return true;
+			}
+		}
+		break;
 	}
-	const NifModel * nif_;
-	const QModelIndex & array_;
-	uint off_;
-};
 
+	return false;
+}
+
+/*! Traits for evaluating B-spline values from decompressed control points */
 template <typename T>
 struct SplineTraits
 {
@@ -572,13 +653,13 @@ struct SplineTraits
 		return ( sizeof(T) / sizeof(float) );
 	}
 
-	// Compute point from short array and mult/bias
-	static T & Compute( T & v, qarray<short> & c, float mult )
+	// Add weighted control point
+	static T & Compute( T & v, const float * c, float mult )
 	{
 		float * vf = (float *)&v; // assume default data is a vector of floats. specialize if necessary.
 
 		for ( int i = 0; i < CountOf(); ++i )
-			vf[i] = vf[i] + ( float(c[i]) / float(SHRT_MAX) ) * mult;
+			vf[i] = vf[i] + c[i] * mult;
 
 		return v;
 	}
@@ -600,10 +681,10 @@ template <> struct SplineTraits<Quat>
 		v = Quat(); v[0] = 0.0f; return v;
 	}
 	static int CountOf() { return 4; }
-	static Quat & Compute( Quat & v, qarray<short> & c, float mult )
+	static Quat & Compute( Quat & v, const float * c, float mult )
 	{
 		for ( int i = 0; i < CountOf(); ++i )
-			v[i] = v[i] + ( float(c[i]) / float(SHRT_MAX) ) * mult;
+			v[i] = v[i] + c[i] * mult;
 
 		return v;
 	}
@@ -616,80 +697,99 @@ template <> struct SplineTraits<Quat>
 	}
 };
 
-// calculate the blending value
-static float blend( int k, int t, int * u, float v )
-{
-	float value;
-
-	if ( t == 1 ) {
-		// base case for the recursion
-		value = ( ( u[k] <= v ) && ( v < u[k + 1] ) ) ? 1.0f : 0.0f;
-	} else {
-		if ( ( u[k + t - 1] == u[k] ) && ( u[k + t] == u[k + 1] ) ) // check for divide by zero
-			value = 0;
-		else if ( u[k + t - 1] == u[k] )                            // if a term's denominator is zero,use just the other
-			value = ( u[k + t] - v) / ( u[k + t] - u[k + 1] ) * blend( k + 1, t - 1, u, v );
-		else if ( u[k + t] == u[k + 1] )
-			value = (v - u[k]) / (u[k + t - 1] - u[k]) * blend( k, t - 1, u, v );
-		else
-			value = ( v - u[k] ) / ( u[k + t - 1] - u[k] ) * blend( k, t - 1, u, v )
-			        + ( u[k + t] - v ) / ( u[k + t] - u[k + 1] ) * blend( k + 1, t - 1, u, v );
-	}
+/*! Evaluate the nonzero basis functions of an open uniform B-spline
+ *
+ * Only the degree + 1 functions of the knot span containing v are nonzero, so
+ * they are computed iteratively (Cox-de Boor) instead of recursing over every
+ * control point.
+ *
+ * @param[in]  degree	The degree of the spline
+ * @param[in]  nctrl	The number of control points
+ * @param[in]  v		The position on the spline, in knot intervals
+ * @param[out] basis	The degree + 1 basis function values
+ * @return				The first control point the basis applies to, or -1 if v is outside the knots
+ */
+static int bsplineBasis( int degree, int nctrl, float v, float * basis )
+{
+	int n = nctrl - 1;
+	int p = degree;
 
-	return value;
-}
+	if ( n < p || !( v >= 0.0f && v < float( n - p + 1 ) ) )
+		return -1;
 
-// figure out the knots
-static void compute_intervals( int * u, int n, int t )
-{
-	for ( int j = 0; j <= n + t; j++ ) {
-		if ( j < t )
-			u[j] = 0;
-		else if ( ( t <= j ) && ( j <= n ) )
-			u[j] = j - t + 1;
-		else if ( j > n )
-			u[j] = n - t + 2;  // if n-t=-2 then we're screwed, everything goes to 0
+	// Knots are 0 (p + 1 times), 1, 2, ..., n - p + 1 (p + 1 times)
+	auto knot = [n, p]( int j ) {
+		return float( qBound( 0, j - p, n - p + 1 ) );
+	};
+
+	int span = p + int( floor( v ) );
+
+	float left[BSplineTransformInterpolator::MaxDegree + 1];
+	float right[BSplineTransformInterpolator::MaxDegree + 1];
+
+	basis[0] = 1.0f;
+
+	for ( int j = 1; j <= p; j++ ) {
+		left[j] = v - knot( span + 1 - j );
+		right[j] = knot( span + j ) - v;
+
+		float saved = 0.0f;
+
+		for ( int r = 0; r < j; r++ ) {
+			float temp = basis[r] / ( right[r + 1] + left[j - r] );
+			basis[r] = saved + right[r + 1] * temp;
+			saved = left[j - r] * temp;
+		}
+
+		basis[j] = saved;
 	}
+
+	return span - p;
 }
 
-template <typename T>
-static void compute_point( int * u, int n, int t, float v, qarray<short> & control, T & output, float mult, float bias )
+/*! Decompress the control points of one channel of the compact control points
+ *
+ * @param[in] compact	The compact control points of the NiBSplineData
+ * @param[in] off		The offset of the channel (handle)
+ * @param[in] count		The number of shorts in the channel
+ * @return				The control points scaled to [-1, 1], empty if the channel is unused
+ */
+static QVector<float> bsplineDecompress( const QVector<short> & compact, uint off, uint count )
 {
-	// initialize the variables that will hold our output
-	int l = SplineTraits<T>::CountOf();
-	SplineTraits<T>::Init( output );
+	QVector<float> points;
 
-	for ( int k = 0; k <= n; k++ ) {
-		qarray<short> qa( control, k * l );
-		SplineTraits<T>::Compute( output, qa, blend( k, t, u, v ) );
+	if ( off == USHRT_MAX )
+		return points;
+
+	points.resize( count );
+
+	for ( uint i = 0; i < count; i++ ) {
+		uint c = off + i;
+		points[i] = ( c < uint( compact.count() ) ) ? float( compact[c] ) / float( SHRT_MAX ) : 0.0f;
 	}
 
-	SplineTraits<T>::Adjust( output, mult, bias );
+	return points;
 }
 
 template <typename T>
-bool bsplineinterpolate( T & value, int degree, float interval, uint nctrl, const QModelIndex & array, uint off, float mult, float bias )
+static bool bsplineinterpolate( T & value, const float * basis, int first, int degree, const QVector<float> & points, float mult, float bias )
 {
-	if ( off == USHRT_MAX )
+	if ( points.isEmpty() )
 		return false;
 
-	qarray<short> subArray( array, off );
-	int t = degree + 1;
-	int n = nctrl - 1;
 	int l = SplineTraits<T>::CountOf();
+	int count = points.count() / l;
+	const float * control = points.constData();
+
+	SplineTraits<T>::Init( value );
 
-	if ( interval >= float(nctrl - degree) ) {
-		SplineTraits<T>::Init( value );
-		qarray<short> sa( subArray, n * l );
-		SplineTraits<T>::Compute( value, sa, 1.0f );
-		SplineTraits<T>::Adjust( value, mult, bias );
-	} else {
-		int * u = new int[ n + t + 1 ];
-		compute_intervals( u, n, t );
-		compute_point( u, n, t, interval, subArray, value, mult, bias );
-		delete [] u;
+	if ( first >= 0 ) {
+		for ( int k = 0; k <= degree && first + k < count; k++ )
+			SplineTraits<T>::Compute( value, control + ( first + k ) * l, basis[k] );
 	}
 
+	SplineTraits<T>::Adjust( value, mult, bias );
+
 	return true;
 }
 
@@ -732,9 +832,9 @@ bool TransformInterpolator::update( const NifModel * nif, const QModelIndex & in
 
 bool TransformInterpolator::updateTransform( Transform & tm, float time )
 {
-	Controller::interpolate( tm.rotation, iRotations, time, lRotate );
-	Controller::interpolate( tm.translation, iTranslations, time, lTrans );
-	Controller::interpolate( tm.scale, iScales, time, lScale );
+	parent->interpolate( tm.rotation, iRotations, time, lRotate );
+	parent->interpolate( tm.translation, iTranslations, time, lTrans );
+	parent->interpolate( tm.scale, iScales, time, lScale );
 
 	return true;
 }
@@ -775,22 +875,57 @@ bool BSplineTransformInterpolator::update( const NifModel * nif, const QModelInd
 		lRotateBias = nif->get<float>( index, "Rotation Offset" );
 		lScaleBias  = nif->get<float>( index, "Scale Offset" );
 
+		// Decompress the control points once instead of reading them through the model every frame
+		QVector<short> compact = nif->getArray<short>( iControl );
+
+		transControl  = bsplineDecompress( compact, lTransOff, nCtrl * SplineTraits<Vector3>::CountOf() );
+		rotateControl = bsplineDecompress( compact, lRotateOff, nCtrl * SplineTraits<Quat>::CountOf() );
+		scaleControl  = bsplineDecompress( compact, lScaleOff, nCtrl * SplineTraits<float>::CountOf() );
+
 		return true;
 	}
 
 	return false;
 }
 
+int BSplineTransformInterpolator::basis( int degree, int nctrl, float v, float * basis )
+{
+	if ( degree > MaxDegree || nctrl <= 0 )
+		return -1;
+
+	if ( v >= float(nctrl - degree) ) {
+		// Past the end, use the last control point
+		int first = qMax( nctrl - 1 - degree, 0 );
+
+		for ( int k = 0; k <= degree; k++ )
+			basis[k] = 0.0f;
+
+		basis[nctrl - 1 - first] = 1.0f;
+
+		return first;
+	}
+
+	return bsplineBasis( degree, nctrl, v, basis );
+}
+
 bool BSplineTransformInterpolator::updateTransform( Transform & transform, float time )
 {
+	if ( nCtrl == 0 || degree > MaxDegree )
+		return false;
+
 	float interval = ( ( time - start ) / ( stop - start ) ) * float(nCtrl - degree);
+
+	// The basis is shared by all channels
+	float basis[MaxDegree + 1] = {};
+	int first = BSplineTransformInterpolator::basis( degree, nCtrl, interval, basis );
+
 	Quat q = transform.rotation.toQuat();
 
-	if ( ::bsplineinterpolate<Quat>( q, degree, interval, nCtrl, iControl, lRotateOff, lRotateMult, lRotateBias ) )
+	if ( ::bsplineinterpolate<Quat>( q, basis, first, degree, rotateControl, lRotateMult, lRotateBias ) )
 		transform.rotation.fromQuat( q );
 
-	::bsplineinterpolate<Vector3>( transform.translation, degree, interval, nCtrl, iControl, lTransOff, lTransMult, lTransBias );
-	::bsplineinterpolate<float>( transform.scale, degree, interval, nCtrl, iControl, lScaleOff, lScaleMult, lScaleBias );
+	::bsplineinterpolate<Vector3>( transform.translation, basis, first, degree, transControl, lTransMult, lTransBias );
+	::bsplineinterpolate<float>( transform.scale, basis, first, degree, scaleControl, lScaleMult, lScaleBias );
 
 	return true;
 }
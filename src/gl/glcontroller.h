@@ -36,14 +36,36 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 
 #include <QObject> // Inherited
+#include <QHash>
 #include <QPersistentModelIndex>
 #include <QString>
+#include <QVector>
 
 
 //! @file glcontroller.h Controller, Interpolator, TransformInterpolator, BSplineTransformInterpolator
 
 class Transform;
 
+//! A key group decoded from the model into flat arrays
+struct KeyData
+{
+	//! Block number the keys were read from
+	int block = -1;
+	//! Interpolation type of the keys, or rotation type for rotation keys
+	int type = 0;
+	//! Number of floats per value
+	int stride = 0;
+
+	//! Key times
+	QVector<float> times;
+	//! Key values, stride floats per key
+	QVector<float> values;
+	//! Forward tangents of quadratic keys
+	QVector<float> forward;
+	//! Backward tangents of quadratic keys
+	QVector<float> backward;
+};
+
 //! Something which can be attached to anything Controllable
 class Controller
 {
@@ -94,7 +116,7 @@ public:
 	 * @param[in]  time			The scene time
 	 * @param[out] lastIndex	The last index
 	 */
-	template <typename T> static bool interpolate( T & value, const QModelIndex & array, float time, int & lastIndex );
+	template <typename T> bool interpolate( T & value, const QModelIndex & array, float time, int & lastIndex );
 
 	/*! Interpolate given an index and the array name
 	 *
@@ -104,20 +126,50 @@ public:
 	 * @param[in]  time			The scene time
 	 * @param[out] lastIndex	The last index
 	 */
-	template <typename T> static bool interpolate( T & value, const QModelIndex & data, const QString & arrayid, float time, int & lastindex );
+	template <typename T> bool interpolate( T & value, const QModelIndex & data, const QString & arrayid, float time, int & lastindex );
 	
 	/*! Returns the fraction of the way between two keyframes based on the scene time
+	 *
+	 * The previous frame is used as a hint; if the time is not within or right
+	 * after the hinted interval the keys are binary searched.
 	 *
 	 * @param[in]  inTime		The scene time
-	 * @param[in]  nif			The NIF
-	 * @param[in]  keysArray	The Keys array in the interpolator
-	 * @param[out] prevFrame	The previous row in the Keys array
+	 * @param[in]  times		The decoded key times
+	 * @param[in,out] prevFrame	The previous row in the Keys array
 	 * @param[out] nextFrame	The next row in the Keys array
 	 * @param[out] fraction		The current distance between the prev and next frame, as a fraction
 	 */
-	static bool timeIndex( float inTime, const NifModel * nif, const QModelIndex & keysArray, int & prevFrame, int & nextFrame, float & fraction );
+	static bool timeIndex( float inTime, const QVector<float> & times, int & prevFrame, int & nextFrame, float & fraction );
+
+	/*! Decode the keys of a key group into flat arrays
+	 *
+	 * @param[in]  nif			The NIF
+	 * @param[in]  array		The key group index
+	 */
+	template <typename T> static KeyData decodeKeys( const NifModel * nif, const QModelIndex & array );
+
+	/*! Interpolate decoded keys
+	 *
+	 * Does not access the model, so it may be used from any thread.
+	 *
+	 * @param[out] value		The value being interpolated
+	 * @param[in]  keys			The decoded keys
+	 * @param[in]  time			The scene time
+	 * @param[in,out] lastIndex	The last index
+	 */
+	template <typename T> static bool interpolateKeys( T & value, const KeyData & keys, float time, int & lastIndex );
 
 protected:
+	/*! Get the decoded keys of a key group, decoding them on first use
+	 *
+	 * @param[in]  array		The key group index
+	 * @return					The decoded keys, or nullptr if the index is invalid
+	 */
+	template <typename T> const KeyData * keys( const QModelIndex & array );
+
+	//! Decoded key groups, invalidated per block in update()
+	//!	Keyed by persistent index so a removed array can never alias a newly allocated one
+	QHash<QPersistentModelIndex, KeyData> keyCache;
 
 	QPersistentModelIndex iBlock;
 	QPersistentModelIndex iInterpolator;
@@ -136,6 +188,11 @@ template <typename T> bool Controller::interpolate( T & value, const QModelIndex
 	return false;
 }
 
+template <> KeyData Controller::decodeKeys<bool>( const NifModel * nif, const QModelIndex & array );
+template <> KeyData Controller::decodeKeys<Matrix>( const NifModel * nif, const QModelIndex & array );
+template <> bool Controller::interpolateKeys<bool>( bool & value, const KeyData & keys, float time, int & lastIndex );
+template <> bool Controller::interpolateKeys<Quat>( Quat & value, const KeyData & keys, float time, int & lastIndex );
+
 class Interpolator : public QObject
 {
 public:
@@ -169,6 +226,19 @@ public:
 	bool update( const NifModel * nif, const QModelIndex & index ) override;
 	bool updateTransform( Transform & tm, float time ) override;
 
+	//! Highest supported spline degree
+	static const int MaxDegree = 3;
+
+	/*! Evaluate the nonzero basis functions of the spline at a time
+	 *
+	 * @param[in]  degree	The degree of the spline
+	 * @param[in]  nctrl	The number of control points
+	 * @param[in]  v		The position on the spline in knot intervals, 0 to nctrl - degree
+	 * @param[out] basis	The degree + 1 basis function values
+	 * @return				The first control point the basis applies to, or -1 if there is none
+	 */
+	static int basis( int degree, int nctrl, float v, float * basis );
+
 protected:
 	float start = 0, stop = 0;
 	QPersistentModelIndex iControl, iSpline, iBasis;
@@ -178,6 +248,9 @@ protected:
 	float lTransBias = 0, lRotateBias = 0, lScaleBias = 0;
 	uint nCtrl = 0;
 	int degree = 3;
+
+	//! Decompressed control points of each channel
+	QVector<float> transControl, rotateControl, scaleControl;
 };
 
 
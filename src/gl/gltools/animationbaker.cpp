@@ -0,0 +1,859 @@
+#include "animationbaker.h"
+#include "gl/glcontroller.h"
+#include "model/nifmodel.h"
+
+#include <QBuffer>
+#include <QPair>
+#include <QThread>
+#include <QStringList>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <cfloat>
+#include <climits>
+
+
+//! The decoded keys of a track
+struct AnimationBaker::Source
+{
+	//! Pose used for channels without keys
+	Vector3 translation;
+	Quat rotation;
+	float scale = 1.0f;
+	float value[4] = {};
+
+	KeyData rotationKeys;
+	KeyData xyzKeys[3];
+	KeyData translationKeys;
+	KeyData scaleKeys;
+	KeyData keys;
+
+	//! Evaluates B-spline interpolators; does not access the model once updated
+	std::shared_ptr<BSplineTransformInterpolator> spline;
+
+	//! Output of bake(), set before sampling
+	float * out = nullptr;
+};
+
+AnimationBaker::AnimationBaker( const NifModel * nif, const QModelIndex & iSequence )
+{
+	start = nif->get<float>( iSequence, "Start Time" );
+	stop  = nif->get<float>( iSequence, "Stop Time" );
+
+	QModelIndex iBlocks = nif->getIndex( iSequence, "Controlled Blocks" );
+
+	for ( int r = 0; iBlocks.isValid() && r < nif->rowCount( iBlocks ); r++ ) {
+		QModelIndex iCB = iBlocks.child( r, 0 );
+		QModelIndex iInterp = nif->getBlock( nif->getLink( iCB, "Interpolator" ), "NiInterpolator" );
+
+		if ( !iInterp.isValid() )
+			continue;
+
+		Track track;
+		track.iInterpolator = iInterp;
+		track.name = nif->get<QString>( iCB, "Node Name" );
+
+		if ( track.name.isEmpty() )
+			track.name = nif->get<QString>( iCB, "Target Name" );
+
+		auto src = std::make_shared<Source>();
+		QModelIndex iData = nif->getBlock( nif->getLink( iInterp, "Data" ) );
+
+		if ( nif->isNiBlock( iInterp, QStringList{ "NiTransformInterpolator", "NiBSplineCompTransformInterpolator" } ) ) {
+			track.type = TransformTrack;
+			track.stride = 8;
+
+			// Unused transform values are stored as -FLT_MAX
+			QModelIndex iTransform = nif->getIndex( iInterp, "Transform" );
+			Vector3 t = nif->get<Vector3>( iTransform, "Translation" );
+			Quat q = nif->get<Quat>( iTransform, "Rotation" );
+			float s = nif->get<float>( iTransform, "Scale" );
+
+			if ( t[0] > -FLT_MAX )
+				src->translation = t;
+			if ( q[0] > -FLT_MAX )
+				src->rotation = q;
+			if ( s > -FLT_MAX )
+				src->scale = s;
+
+			if ( nif->isNiBlock( iInterp, "NiBSplineCompTransformInterpolator" ) ) {
+				src->spline = std::make_shared<BSplineTransformInterpolator>( nullptr );
+				src->spline->update( nif, iInterp );
+			} else if ( iData.isValid() ) {
+				src->rotationKeys = Controller::decodeKeys<Matrix>( nif, iData );
+
+				if ( src->rotationKeys.type == 4 ) {
+					QModelIndex iXYZ = nif->getIndex( iData, "XYZ Rotations" );
+
+					for ( int i = 0; iXYZ.isValid() && i < 3 && i < nif->rowCount( iXYZ ); i++ )
+						src->xyzKeys[i] = Controller::decodeKeys<float>( nif, iXYZ.child( i, 0 ) );
+				}
+
+				src->translationKeys = Controller::decodeKeys<Vector3>( nif, nif->getIndex( iData, "Translations" ) );
+				src->scaleKeys = Controller::decodeKeys<float>( nif, nif->getIndex( iData, "Scales" ) );
+			}
+		} else if ( nif->isNiBlock( iInterp, "NiFloatInterpolator" ) ) {
+			track.type = FloatTrack;
+			track.stride = 1;
+			src->value[0] = nif->get<float>( iInterp, "Value" );
+			src->keys = Controller::decodeKeys<float>( nif, nif->getIndex( iData, "Data" ) );
+		} else if ( nif->isNiBlock( iInterp, "NiPoint3Interpolator" ) ) {
+			track.type = Point3Track;
+			track.stride = 3;
+			Vector3 v = nif->get<Vector3>( iInterp, "Value" );
+			for ( int c = 0; c < 3; c++ )
+				src->value[c] = v[c];
+			src->keys = Controller::decodeKeys<Vector3>( nif, nif->getIndex( iData, "Data" ) );
+		} else if ( nif->isNiBlock( iInterp, "NiColorInterpolator" ) ) {
+			track.type = ColorTrack;
+			track.stride = 4;
+			Color4 v = nif->get<Color4>( iInterp, "Value" );
+			for ( int c = 0; c < 4; c++ )
+				src->value[c] = v[c];
+			src->keys = Controller::decodeKeys<Color4>( nif, nif->getIndex( iData, "Data" ) );
+		} else if ( nif->isNiBlock( iInterp, "NiBoolInterpolator" ) ) {
+			track.type = BoolTrack;
+			track.stride = 1;
+			src->value[0] = nif->get<int>( iInterp, "Value" ) ? 1.0f : 0.0f;
+			src->keys = Controller::decodeKeys<bool>( nif, nif->getIndex( iData, "Data" ) );
+		} else {
+			// Blend and lookup interpolators are evaluated through other interpolators
+			continue;
+		}
+
+		trackList.append( track );
+		sources.append( src );
+	}
+}
+
+AnimationBaker::~AnimationBaker()
+{
+}
+
+void AnimationBaker::bake( float fps )
+{
+	frames = ( fps > 0 && stop > start ) ? int( ceil( ( stop - start ) * fps - 0.001f ) ) + 1 : 1;
+	step = ( frames > 1 ) ? ( stop - start ) / float( frames - 1 ) : 0.0f;
+
+	for ( int t = 0; t < trackList.count(); t++ ) {
+		trackList[t].samples.fill( 0.0f, frames * trackList[t].stride );
+		sources[t]->out = trackList[t].samples.data();
+	}
+
+	// Each slice keeps its own key hints, so slices should not be too small
+	int sliceSize = qMax( 64, frames / ( QThread::idealThreadCount() * 4 ) );
+
+	QVector<QPair<int, int>> slices;
+	for ( int f = 0; f < frames; f += sliceSize )
+		slices.append( { f, qMin( f + sliceSize, frames ) } );
+
+	QtConcurrent::blockingMap( slices, [this]( QPair<int, int> & slice ) {
+		sample( slice.first, slice.second );
+	} );
+}
+
+void AnimationBaker::sample( int first, int last )
+{
+	for ( int t = 0; t < sources.count(); t++ ) {
+		const Source & src = *sources[t];
+		const Track & track = trackList[t];
+
+		// Last key of each channel, see Controller::timeIndex()
+		int hint[6] = {};
+
+		for ( int f = first; f < last; f++ ) {
+			float time = frameTime( f );
+			float * out = src.out + f * track.stride;
+
+			switch ( track.type ) {
+			case TransformTrack:
+				{
+					Vector3 translation = src.translation;
+					Quat rotation = src.rotation;
+					float scale = src.scale;
+
+					if ( src.spline ) {
+						Transform tm;
+						tm.translation = translation;
+						tm.rotation.fromQuat( rotation );
+						tm.scale = scale;
+
+						src.spline->updateTransform( tm, time );
+
+						translation = tm.translation;
+						rotation = tm.rotation.toQuat();
+						scale = tm.scale;
+					} else {
+						if ( src.rotationKeys.type == 4 ) {
+							float r[3] = {};
+
+							for ( int i = 0; i < 3; i++ )
+								Controller::interpolateKeys( r[i], src.xyzKeys[i], time, hint[3 + i] );
+
+							Matrix m = Matrix::euler( 0, 0, r[2] ) * Matrix::euler( 0, r[1], 0 ) * Matrix::euler( r[0], 0, 0 );
+							rotation = m.toQuat();
+						} else {
+							Controller::interpolateKeys( rotation, src.rotationKeys, time, hint[0] );
+						}
+
+						Controller::interpolateKeys( translation, src.translationKeys, time, hint[1] );
+						Controller::interpolateKeys( scale, src.scaleKeys, time, hint[2] );
+					}
+
+					for ( int c = 0; c < 3; c++ )
+						out[c] = translation[c];
+					for ( int c = 0; c < 4; c++ )
+						out[3 + c] = rotation[c];
+					out[7] = scale;
+				}
+				break;
+			case FloatTrack:
+				{
+					float v = src.value[0];
+					Controller::interpolateKeys( v, src.keys, time, hint[0] );
+					out[0] = v;
+				}
+				break;
+			case Point3Track:
+				{
+					Vector3 v( src.value[0], src.value[1], src.value[2] );
+					Controller::interpolateKeys( v, src.keys, time, hint[0] );
+					for ( int c = 0; c < 3; c++ )
+						out[c] = v[c];
+				}
+				break;
+			case ColorTrack:
+				{
+					Color4 v( src.value[0], src.value[1], src.value[2], src.value[3] );
+					Controller::interpolateKeys( v, src.keys, time, hint[0] );
+					for ( int c = 0; c < 4; c++ )
+						out[c] = v[c];
+				}
+				break;
+			case BoolTrack:
+				{
+					bool v = src.value[0] != 0.0f;
+					Controller::interpolateKeys( v, src.keys, time, hint[0] );
+					out[0] = v ? 1.0f : 0.0f;
+				}
+				break;
+			}
+		}
+	}
+}
+
+//! Error of the sample at i when interpolating between the samples at a and b
+static float sampleError( const QVector<float> & times, const float * values, int stride, int a, int b, int i, bool rotation )
+{
+	float span = times[b] - times[a];
+	float x = ( span > 0 ) ? ( times[i] - times[a] ) / span : 0.0f;
+
+	const float * va = values + a * stride;
+	const float * vb = values + b * stride;
+	const float * vi = values + i * stride;
+
+	if ( rotation ) {
+		Quat qa( va[0], va[1], va[2], va[3] );
+		Quat qb( vb[0], vb[1], vb[2], vb[3] );
+		Quat qi( vi[0], vi[1], vi[2], vi[3] );
+
+		if ( Quat::dotproduct( qa, qb ) < 0 )
+			qa.negate(); // don't take the long path
+
+		float d = qAbs( Quat::dotproduct( Quat::slerp( x, qa, qb ), qi ) );
+
+		return 2.0f * acos( qMin( d, 1.0f ) );
+	}
+
+	float error = 0;
+
+	for ( int c = 0; c < stride; c++ )
+		error = qMax( error, qAbs( va[c] + ( vb[c] - va[c] ) * x - vi[c] ) );
+
+	return error;
+}
+
+QVector<int> AnimationBaker::linearKeys( const QVector<float> & times, const float * values, int stride, float tolerance, bool rotation )
+{
+	QVector<int> keep;
+	int count = times.count();
+
+	if ( count == 0 )
+		return keep;
+
+	keep.append( 0 );
+
+	if ( tolerance <= 0 ) {
+		for ( int i = 1; i < count; i++ )
+			keep.append( i );
+
+		return keep;
+	}
+
+	if ( count == 1 )
+		return keep;
+
+	// Split each segment at its worst inner sample until every sample is within the tolerance
+	//	(Douglas-Peucker), so long runs that fit are tested once instead of once per extension
+	QVector<bool> kept( count, false );
+	QVector<QPair<int, int>> segments;
+	segments.append( { 0, count - 1 } );
+
+	while ( !segments.isEmpty() ) {
+		QPair<int, int> seg = segments.takeLast();
+
+		int worst = -1;
+		float worstError = tolerance;
+
+		for ( int i = seg.first + 1; i < seg.second; i++ ) {
+			float error = sampleError( times, values, stride, seg.first, seg.second, i, rotation );
+
+			if ( error > worstError ) {
+				worst = i;
+				worstError = error;
+			}
+		}
+
+		if ( worst < 0 )
+			continue;
+
+		kept[worst] = true;
+		segments.append( { seg.first, worst } );
+		segments.append( { worst, seg.second } );
+	}
+
+	for ( int i = 1; i < count - 1; i++ ) {
+		if ( kept[i] )
+			keep.append( i );
+	}
+
+	keep.append( count - 1 );
+
+	return keep;
+}
+
+//! Write one channel of sampled values as linear keys to a key group
+template <typename T>
+static void writeKeys( NifModel * nif, const QModelIndex & iGroup, const QVector<float> & times, const QVector<float> & values, float tolerance )
+{
+	const int stride = sizeof(T) / sizeof(float);
+
+	QVector<int> keep = AnimationBaker::linearKeys( times, values.constData(), stride, tolerance );
+
+	nif->set<int>( iGroup, "Num Keys", keep.count() );
+	nif->set<int>( iGroup, "Interpolation", 1 );
+
+	QModelIndex iKeys = nif->getIndex( iGroup, "Keys" );
+	nif->updateArray( iKeys );
+
+	for ( int k = 0; k < keep.count(); k++ ) {
+		QModelIndex iKey = iKeys.child( k, 0 );
+
+		T v;
+		float * vf = (float *)&v; // assume value is a vector of floats
+		for ( int c = 0; c < stride; c++ )
+			vf[c] = values[keep[k] * stride + c];
+
+		nif->set<float>( iKey, "Time", times[keep[k]] );
+		nif->set<T>( iKey, "Value", v );
+	}
+}
+
+//! Write sampled booleans to a key group, keeping only the changes
+static void writeBoolKeys( NifModel * nif, const QModelIndex & iGroup, const QVector<float> & times, const QVector<float> & values )
+{
+	QVector<int> keep;
+
+	for ( int i = 0; i < values.count(); i++ ) {
+		if ( i == 0 || values[i] != values[keep.last()] )
+			keep.append( i );
+	}
+
+	nif->set<int>( iGroup, "Num Keys", keep.count() );
+
+	QModelIndex iKeys = nif->getIndex( iGroup, "Keys" );
+	nif->updateArray( iKeys );
+
+	for ( int k = 0; k < keep.count(); k++ ) {
+		QModelIndex iKey = iKeys.child( k, 0 );
+
+		nif->set<float>( iKey, "Time", times[keep[k]] );
+		nif->set<int>( iKey, "Value", values[keep[k]] != 0.0f );
+	}
+}
+
+//! The data block of an interpolator, first cloned for it if other blocks also link to the data
+static QModelIndex ownData( NifModel * nif, const QModelIndex & iInterpolator )
+{
+	int data = nif->getLink( iInterpolator, "Data" );
+	QModelIndex iData = nif->getBlock( data );
+
+	if ( !iData.isValid() || nif->getReferrers( data ).count() <= 1 )
+		return iData;
+
+	QByteArray bytes;
+	QBuffer buffer( &bytes );
+
+	if ( !( buffer.open( QIODevice::WriteOnly ) && nif->saveIndex( buffer, iData ) ) )
+		return QModelIndex();
+
+	buffer.close();
+
+	if ( !buffer.open( QIODevice::ReadOnly ) )
+		return QModelIndex();
+
+	QModelIndex iCopy = nif->insertNiBlock( nif->getBlockName( iData ), nif->getBlockCount() );
+
+	if ( !nif->loadIndex( buffer, iCopy ) ) {
+		nif->removeNiBlock( nif->getBlockNumber( iCopy ) );
+		return QModelIndex();
+	}
+
+	nif->setLink( iInterpolator, "Data", nif->getBlockNumber( iCopy ) );
+
+	return iCopy;
+}
+
+int AnimationBaker::writeBack( NifModel * nif, float tolerance ) const
+{
+	if ( frames == 0 )
+		return 0;
+
+	QVector<float> times( frames );
+	for ( int f = 0; f < frames; f++ )
+		times[f] = frameTime( f );
+
+	int written = 0;
+
+	for ( int t = 0; t < trackList.count(); t++ ) {
+		const Track & track = trackList[t];
+		const Source & src = *sources[t];
+
+		if ( !track.iInterpolator.isValid() || src.spline )
+			continue;
+
+		// Key data shared with interpolators of other sequences is cloned, those keep the old keys
+		QModelIndex iData = ownData( nif, track.iInterpolator );
+
+		if ( !iData.isValid() )
+			continue;
+
+		const float * samples = track.samples.constData();
+
+		switch ( track.type ) {
+		case TransformTrack:
+			{
+				QVector<float> translations( frames * 3 ), rotations( frames * 4 ), scales( frames );
+
+				for ( int f = 0; f < frames; f++ ) {
+					const float * s = samples + f * 8;
+
+					for ( int c = 0; c < 3; c++ )
+						translations[f * 3 + c] = s[c];
+					for ( int c = 0; c < 4; c++ )
+						rotations[f * 4 + c] = s[3 + c];
+					scales[f] = s[7];
+				}
+
+				bool hasRotations = !src.rotationKeys.times.isEmpty();
+				for ( const KeyData & k : src.xyzKeys )
+					hasRotations |= !k.times.isEmpty();
+
+				if ( hasRotations ) {
+					QVector<int> keep = linearKeys( times, rotations.constData(), 4, tolerance, true );
+
+					nif->set<int>( iData, "Num Rotation Keys", keep.count() );
+					nif->set<int>( iData, "Rotation Type", 1 );
+
+					QModelIndex iKeys = nif->getIndex( iData, "Quaternion Keys" );
+					nif->updateArray( iKeys );
+
+					for ( int k = 0; k < keep.count(); k++ ) {
+						QModelIndex iKey = iKeys.child( k, 0 );
+						const float * q = rotations.constData() + keep[k] * 4;
+
+						nif->set<float>( iKey, "Time", times[keep[k]] );
+						nif->set<Quat>( iKey, "Value", Quat( q[0], q[1], q[2], q[3] ) );
+					}
+				}
+
+				if ( !src.translationKeys.times.isEmpty() )
+					writeKeys<Vector3>( nif, nif->getIndex( iData, "Translations" ), times, translations, tolerance );
+
+				if ( !src.scaleKeys.times.isEmpty() )
+					writeKeys<float>( nif, nif->getIndex( iData, "Scales" ), times, scales, tolerance );
+			}
+			break;
+		case FloatTrack:
+			if ( !src.keys.times.isEmpty() )
+				writeKeys<float>( nif, nif->getIndex( iData, "Data" ), times, track.samples, tolerance );
+			break;
+		case Point3Track:
+			if ( !src.keys.times.isEmpty() )
+				writeKeys<Vector3>( nif, nif->getIndex( iData, "Data" ), times, track.samples, tolerance );
+			break;
+		case ColorTrack:
+			if ( !src.keys.times.isEmpty() )
+				writeKeys<Color4>( nif, nif->getIndex( iData, "Data" ), times, track.samples, tolerance );
+			break;
+		case BoolTrack:
+			if ( !src.keys.times.isEmpty() )
+				writeBoolKeys( nif, nif->getIndex( iData, "Data" ), times, track.samples );
+			break;
+		}
+
+		written++;
+	}
+
+	return written;
+}
+
+
+//! Degree of the fitted splines, the only degree the games use
+static const int SplineDegree = 3;
+
+//! One channel of a transform track fitted with a compressed B-spline
+struct SplineChannel
+{
+	//! Number of floats per value
+	int dim = 1;
+	//! Rotations use angular error
+	bool rotation = false;
+	//! The channel changes over time and needs control points
+	bool animated = false;
+	//! Baked values, frames * dim floats
+	QVector<float> values;
+
+	//! Quantized control points, nCtrl * dim shorts
+	QVector<short> compact;
+	float offset = 0;
+	float halfRange = 0;
+};
+
+//! Error between a value and a baked value of a channel
+static float channelError( const SplineChannel & ch, const float * v, const float * ref )
+{
+	if ( ch.rotation ) {
+		Quat q( v[0], v[1], v[2], v[3] );
+		q.normalize();
+
+		float d = qAbs( Quat::dotproduct( q, Quat( ref[0], ref[1], ref[2], ref[3] ) ) );
+
+		return 2.0f * acos( qMin( d, 1.0f ) );
+	}
+
+	float error = 0;
+
+	for ( int c = 0; c < ch.dim; c++ )
+		error = qMax( error, qAbs( v[c] - ref[c] ) );
+
+	return error;
+}
+
+/*! Solve the banded least squares problem of a spline fit with Cholesky
+ *
+ * @param n		Number of control points
+ * @param band	Upper band of the normal matrix, n * (degree + 1); overwritten
+ * @param rhs	Right hand side, n * dim; receives the control points
+ */
+static void splineSolve( int n, int dim, QVector<float> & band, QVector<float> & rhs )
+{
+	const int w = SplineDegree + 1;
+
+	// Keep the system positive definite if a control point is not covered by any sample
+	float ridge = 0;
+	for ( int i = 0; i < n; i++ )
+		ridge = qMax( ridge, band[i * w] );
+
+	ridge *= 1e-6f;
+
+	// L is stored in place of the band, L(i, j) at i * w + (i - j)
+	QVector<float> lower( n * w, 0.0f );
+
+	for ( int i = 0; i < n; i++ ) {
+		for ( int j = qMax( 0, i - SplineDegree ); j <= i; j++ ) {
+			float s = band[j * w + ( i - j )];
+
+			if ( i == j )
+				s += ridge;
+
+			for ( int k = qMax( 0, i - SplineDegree ); k < j; k++ )
+				s -= lower[i * w + ( i - k )] * lower[j * w + ( j - k )];
+
+			if ( i == j )
+				lower[i * w] = sqrt( qMax( s, 1e-12f ) );
+			else
+				lower[i * w + ( i - j )] = s / lower[j * w];
+		}
+	}
+
+	for ( int c = 0; c < dim; c++ ) {
+		// L y = b
+		for ( int i = 0; i < n; i++ ) {
+			float s = rhs[i * dim + c];
+
+			for ( int k = qMax( 0, i - SplineDegree ); k < i; k++ )
+				s -= lower[i * w + ( i - k )] * rhs[k * dim + c];
+
+			rhs[i * dim + c] = s / lower[i * w];
+		}
+
+		// L^T x = y
+		for ( int i = n - 1; i >= 0; i-- ) {
+			float s = rhs[i * dim + c];
+
+			for ( int k = i + 1; k < qMin( n, i + SplineDegree + 1 ); k++ )
+				s -= lower[k * w + ( k - i )] * rhs[k * dim + c];
+
+			rhs[i * dim + c] = s / lower[i * w];
+		}
+	}
+}
+
+/*! Fit the animated channels with n control points
+ *
+ * @return Whether every channel stays within its tolerance at every frame
+ */
+static bool splineFit( QVector<SplineChannel> & channels, int frames, int n, float tolerance, float angularTolerance )
+{
+	const int w = SplineDegree + 1;
+
+	// Basis of every frame, shared by all channels
+	QVector<int> first( frames );
+	QVector<float> basis( frames * w, 0.0f );
+
+	for ( int f = 0; f < frames; f++ ) {
+		float v = ( frames > 1 ) ? float( f ) / float( frames - 1 ) * float( n - SplineDegree ) : 0.0f;
+		first[f] = BSplineTransformInterpolator::basis( SplineDegree, n, v, basis.data() + f * w );
+	}
+
+	bool fits = true;
+
+	for ( SplineChannel & ch : channels ) {
+		if ( !ch.animated )
+			continue;
+
+		const int dim = ch.dim;
+
+		QVector<float> band( n * w, 0.0f );
+		QVector<float> control( n * dim, 0.0f );
+
+		for ( int f = 0; f < frames; f++ ) {
+			const float * b = basis.constData() + f * w;
+			const float * y = ch.values.constData() + f * dim;
+
+			for ( int i = 0; i < w && first[f] + i < n; i++ ) {
+				int r = first[f] + i;
+
+				for ( int j = i; j < w && first[f] + j < n; j++ )
+					band[r * w + ( j - i )] += b[i] * b[j];
+
+				for ( int c = 0; c < dim; c++ )
+					control[r * dim + c] += b[i] * y[c];
+			}
+		}
+
+		splineSolve( n, dim, band, control );
+
+		// Quantize to shorts around the center of the range
+		float lo = FLT_MAX, hi = -FLT_MAX;
+		for ( float c : control ) {
+			lo = qMin( lo, c );
+			hi = qMax( hi, c );
+		}
+
+		ch.offset = ( hi + lo ) / 2.0f;
+		ch.halfRange = ( hi - lo ) / 2.0f;
+		ch.compact.resize( n * dim );
+
+		for ( int i = 0; i < n * dim; i++ ) {
+			float x = ( ch.halfRange > 0 ) ? ( control[i] - ch.offset ) / ch.halfRange : 0.0f;
+			ch.compact[i] = short( qBound( -SHRT_MAX, qRound( x * SHRT_MAX ), int(SHRT_MAX) ) );
+		}
+
+		// Check the quantized spline the way it will be evaluated
+		float limit = ch.rotation ? angularTolerance : tolerance;
+
+		for ( int f = 0; f < frames && fits; f++ ) {
+			const float * b = basis.constData() + f * w;
+			float v[4] = {};
+
+			for ( int i = 0; i < w && first[f] >= 0 && first[f] + i < n; i++ ) {
+				for ( int c = 0; c < dim; c++ )
+					v[c] += b[i] * float( ch.compact[( first[f] + i ) * dim + c] ) / float( SHRT_MAX );
+			}
+
+			for ( int c = 0; c < dim; c++ )
+				v[c] = v[c] * ch.halfRange + ch.offset;
+
+			fits = channelError( ch, v, ch.values.constData() + f * dim ) <= limit;
+		}
+	}
+
+	return fits;
+}
+
+//! The fitted spline of one track
+struct SplineResult
+{
+	int track = -1;
+	int nCtrl = 0;
+	//! The quantized spline stays within the tolerances
+	bool fitted = false;
+	//! Translation, rotation and scale
+	QVector<SplineChannel> channels;
+};
+
+int AnimationBaker::writeSplines( NifModel * nif, float tolerance, float angularTolerance, QList<int> * unused ) const
+{
+	if ( frames <= SplineDegree )
+		return 0;
+
+	QVector<SplineResult> results;
+
+	for ( int t = 0; t < trackList.count(); t++ ) {
+		const Track & track = trackList[t];
+
+		if ( track.type != TransformTrack || sources[t]->spline || !nif->isNiBlock( track.iInterpolator, "NiTransformInterpolator" ) )
+			continue;
+
+		SplineResult r;
+		r.track = t;
+		results.append( r );
+	}
+
+	// Fit the tracks in parallel, the model is not touched
+	QtConcurrent::blockingMap( results, [this, tolerance, angularTolerance]( SplineResult & r ) {
+		const float * samples = trackList[r.track].samples.constData();
+
+		r.channels.resize( 3 );
+		r.channels[0].dim = 3;
+		r.channels[1].dim = 4;
+		r.channels[1].rotation = true;
+		r.channels[2].dim = 1;
+
+		const int offsets[3] = { 0, 3, 7 };
+
+		for ( int i = 0; i < 3; i++ ) {
+			SplineChannel & ch = r.channels[i];
+			ch.values.resize( frames * ch.dim );
+
+			for ( int f = 0; f < frames; f++ ) {
+				for ( int c = 0; c < ch.dim; c++ )
+					ch.values[f * ch.dim + c] = samples[f * 8 + offsets[i] + c];
+			}
+
+			if ( ch.rotation ) {
+				// Keep consecutive quaternions in the same hemisphere so the spline does not take the long path
+				for ( int f = 1; f < frames; f++ ) {
+					float * q = ch.values.data() + f * 4;
+					const float * p = q - 4;
+
+					if ( p[0] * q[0] + p[1] * q[1] + p[2] * q[2] + p[3] * q[3] < 0 ) {
+						for ( int c = 0; c < 4; c++ )
+							q[c] = -q[c];
+					}
+				}
+			}
+
+			float limit = ch.rotation ? angularTolerance : tolerance;
+
+			for ( int f = 1; f < frames && !ch.animated; f++ )
+				ch.animated = channelError( ch, ch.values.constData() + f * ch.dim, ch.values.constData() ) > limit;
+		}
+
+		// Double the control points until the fit holds, then bisect down
+		int good = SplineDegree + 1;
+		int bad = 0;
+		bool fits = splineFit( r.channels, frames, good, tolerance, angularTolerance );
+
+		while ( !fits && good < frames ) {
+			bad = good;
+			good = qMin( frames, good * 2 );
+			fits = splineFit( r.channels, frames, good, tolerance, angularTolerance );
+		}
+
+		// Quantization can keep even a control point per frame out of tolerance
+		if ( !fits )
+			return;
+
+		while ( bad > 0 && good - bad > 1 ) {
+			int mid = ( good + bad ) / 2;
+
+			if ( splineFit( r.channels, frames, mid, tolerance, angularTolerance ) )
+				good = mid;
+			else
+				bad = mid;
+		}
+
+		if ( bad > 0 )
+			splineFit( r.channels, frames, good, tolerance, angularTolerance );
+
+		r.nCtrl = good;
+		r.fitted = true;
+	} );
+
+	int converted = 0;
+
+	for ( const SplineResult & r : results ) {
+		// Tracks no spline fits keep their linear keys
+		if ( !r.fitted )
+			continue;
+
+		converted++;
+
+		const Track & track = trackList[r.track];
+		QModelIndex iInterp = track.iInterpolator;
+
+		int iData = nif->getLink( iInterp, "Data" );
+
+		if ( unused && iData >= 0 && !unused->contains( iData ) )
+			unused->append( iData );
+
+		// Channels without animation keep their first value
+		const float * pose = track.samples.constData();
+
+		// The two interpolators are only related through NiInterpolator
+		nif->convertNiBlock( "NiInterpolator", iInterp );
+		nif->convertNiBlock( "NiBSplineCompTransformInterpolator", iInterp );
+
+		QModelIndex iSpline = nif->insertNiBlock( "NiBSplineData" );
+		QModelIndex iBasis = nif->insertNiBlock( "NiBSplineBasisData" );
+
+		nif->set<float>( iInterp, "Start Time", start );
+		nif->set<float>( iInterp, "Stop Time", stop );
+		nif->setLink( iInterp, "Spline Data", nif->getBlockNumber( iSpline ) );
+		nif->setLink( iInterp, "Basis Data", nif->getBlockNumber( iBasis ) );
+		nif->set<uint>( iBasis, "Num Control Points", r.nCtrl );
+
+		QModelIndex iTransform = nif->getIndex( iInterp, "Transform" );
+		nif->set<Vector3>( iTransform, "Translation", Vector3( pose[0], pose[1], pose[2] ) );
+		nif->set<Quat>( iTransform, "Rotation", Quat( pose[3], pose[4], pose[5], pose[6] ) );
+		nif->set<float>( iTransform, "Scale", pose[7] );
+
+		static const char * const handles[3] = { "Translation Handle", "Rotation Handle", "Scale Handle" };
+		static const char * const offsets[3] = { "Translation Offset", "Rotation Offset", "Scale Offset" };
+		static const char * const ranges[3] = { "Translation Half Range", "Rotation Half Range", "Scale Half Range" };
+
+		QVector<short> compact;
+
+		for ( int i = 0; i < 3; i++ ) {
+			const SplineChannel & ch = r.channels[i];
+
+			if ( ch.animated ) {
+				nif->set<uint>( iInterp, handles[i], compact.count() );
+				nif->set<float>( iInterp, offsets[i], ch.offset );
+				nif->set<float>( iInterp, ranges[i], ch.halfRange );
+				compact += ch.compact;
+			} else {
+				nif->set<uint>( iInterp, handles[i], USHRT_MAX );
+			}
+		}
+
+		nif->set<uint>( iSpline, "Num Compact Control Points", compact.count() );
+		QModelIndex iCompact = nif->getIndex( iSpline, "Compact Control Points" );
+		nif->updateArray( iCompact );
+		nif->setArray<short>( iCompact, compact );
+	}
+
+	return converted;
+}
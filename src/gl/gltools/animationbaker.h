@@ -0,0 +1,155 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef ANIMATIONBAKER_H
+#define ANIMATIONBAKER_H
+
+#include "data/niftypes.h"
+
+#include <QList>
+#include <QPersistentModelIndex>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+
+//! @file animationbaker.h AnimationBaker
+
+class NifModel;
+
+/*! Samples the interpolators of a NiControllerSequence on a fixed timestep
+ *
+ * The key data of every controlled block is decoded once, then all tracks are
+ * sampled in parallel over slices of the time range. Sampling does not touch
+ * the model, only decoding and writeBack() do.
+ */
+class AnimationBaker final
+{
+public:
+	//! The kind of values a track holds
+	enum TrackType
+	{
+		TransformTrack, //!< Translation (3), rotation quaternion (4) and scale (1)
+		FloatTrack,
+		Point3Track,
+		ColorTrack,
+		BoolTrack
+	};
+
+	//! The sampled values of one interpolator
+	struct Track
+	{
+		//! The sampled interpolator
+		QPersistentModelIndex iInterpolator;
+		//! The name of the controlled object
+		QString name;
+		TrackType type = FloatTrack;
+		//! Number of floats per sample
+		int stride = 1;
+		//! Sampled values, frameCount() * stride floats
+		QVector<float> samples;
+	};
+
+	AnimationBaker( const NifModel * nif, const QModelIndex & iSequence );
+	~AnimationBaker();
+
+	//! Sample all tracks at the given rate
+	void bake( float fps );
+
+	//! Start time of the sequence
+	float startTime() const { return start; }
+	//! Stop time of the sequence
+	float stopTime() const { return stop; }
+	//! Number of frames sampled by bake()
+	int frameCount() const { return frames; }
+	//! Time of a sampled frame
+	float frameTime( int frame ) const { return start + frame * step; }
+
+	//! The baked tracks
+	const QVector<Track> & tracks() const { return trackList; }
+
+	/*! Replace the key data of the interpolators with linear keys of the baked tracks
+	 *
+	 * Only channels that had keys are written. Interpolators without key data
+	 * (e.g. B-spline interpolators) are left untouched. Key data also linked
+	 * from other blocks is cloned first, so other sequences keep their keys.
+	 *
+	 * @param nif		The NIF to write to; must be the NIF the sequence was read from
+	 * @param tolerance	Keys are dropped while linear interpolation stays within this
+	 *					distance, or angle in radians for rotations; 0 keeps every frame
+	 * @return			The number of interpolators written
+	 */
+	int writeBack( NifModel * nif, float tolerance ) const;
+
+	/*! Replace transform interpolators by compressed B-spline interpolators fitted to the baked tracks
+	 *
+	 * The number of control points is raised until the quantized spline stays
+	 * within the tolerances at every baked frame. Channels that do not change
+	 * are stored in the transform of the interpolator instead of the spline.
+	 * Interpolators no spline fits, even with a control point per frame, are left untouched.
+	 *
+	 * @param nif				The NIF to write to; must be the NIF the sequence was read from
+	 * @param tolerance			Maximum translation and scale error
+	 * @param angularTolerance	Maximum rotation error in radians
+	 * @param unused			Receives the key data blocks the converted interpolators used
+	 * @return					The number of interpolators converted
+	 */
+	int writeSplines( NifModel * nif, float tolerance, float angularTolerance, QList<int> * unused = nullptr ) const;
+
+	/*! Select the samples needed to reproduce a channel with linear interpolation
+	 *
+	 * @param times		The sample times
+	 * @param values	times.count() * stride floats
+	 * @param stride	Number of floats per value
+	 * @param tolerance	The maximum allowed error
+	 * @param rotation	Values are quaternions; use slerp and angular error
+	 * @return			The indices of the kept samples, including the first and last
+	 */
+	static QVector<int> linearKeys( const QVector<float> & times, const float * values, int stride, float tolerance, bool rotation = false );
+
+private:
+	struct Source;
+
+	//! Sample frames [first, last) of all tracks
+	void sample( int first, int last );
+
+	float start = 0;
+	float stop = 0;
+	float step = 0;
+	int frames = 0;
+
+	QVector<Track> trackList;
+	QVector<std::shared_ptr<Source>> sources;
+};
+
+#endif
@@ -1,6 +1,58 @@
 #include "boundsphere.h"
 #include "model/nifmodel.h"
 
+#include <algorithm>
+#include <cfloat>
+
+
+BoundingBox::BoundingBox()
+	: lower( FLT_MAX, FLT_MAX, FLT_MAX ), upper( -FLT_MAX, -FLT_MAX, -FLT_MAX )
+{
+}
+
+BoundingBox::BoundingBox( const Vector3 * points, int count ) : BoundingBox()
+{
+	// Plain float min/max over contiguous data so the loop can be vectorized
+	float lx = lower[0], ly = lower[1], lz = lower[2];
+	float ux = upper[0], uy = upper[1], uz = upper[2];
+
+	for ( int i = 0; i < count; i++ ) {
+		const float * p = points[i].data();
+		lx = std::min( lx, p[0] );
+		ly = std::min( ly, p[1] );
+		lz = std::min( lz, p[2] );
+		ux = std::max( ux, p[0] );
+		uy = std::max( uy, p[1] );
+		uz = std::max( uz, p[2] );
+	}
+
+	lower = Vector3( lx, ly, lz );
+	upper = Vector3( ux, uy, uz );
+}
+
+BoundingBox::BoundingBox( const QVector<Vector3> & points ) : BoundingBox( points.constData(), points.count() )
+{
+}
+
+BoundingBox & BoundingBox::operator|=( const Vector3 & p )
+{
+	for ( int a = 0; a < 3; a++ ) {
+		lower[a] = std::min( lower[a], p[a] );
+		upper[a] = std::max( upper[a], p[a] );
+	}
+	return *this;
+}
+
+BoundingBox & BoundingBox::operator|=( const BoundingBox & o )
+{
+	if ( o.isEmpty() )
+		return *this;
+
+	*this |= o.lower;
+	*this |= o.upper;
+	return *this;
+}
+
 BoundSphere::BoundSphere()
 {
 	radius = -1;
@@ -28,27 +80,74 @@ BoundSphere::BoundSphere( const NifModel * nif, const QModelIndex & index )
 	radius = nif->get<float>( idx, "Radius" );
 }
 
-BoundSphere::BoundSphere( const QVector<Vector3> & verts )
+BoundSphere::BoundSphere( const Vector3 * points, int count )
 {
-	if ( verts.isEmpty() ) {
-		center = Vector3();
-		radius = -1;
-	} else {
-		center = Vector3();
-		for ( const Vector3 & v : verts ) {
-			center += v;
+	center = Vector3();
+	radius = -1;
+
+	if ( count <= 0 )
+		return;
+
+	// Find the extreme points along each axis
+	int lo[3] = { 0, 0, 0 };
+	int hi[3] = { 0, 0, 0 };
+
+	for ( int i = 1; i < count; i++ ) {
+		const Vector3 & p = points[i];
+		for ( int a = 0; a < 3; a++ ) {
+			if ( p[a] < points[lo[a]][a] )
+				lo[a] = i;
+			if ( p[a] > points[hi[a]][a] )
+				hi[a] = i;
 		}
-		center /= verts.count();
+	}
 
-		radius = 0;
-		for ( const Vector3 & v : verts ) {
-			float d = ( center - v ).squaredLength();
+	// Start with the sphere through the most distant pair
+	int axis = 0;
+	float span = -1;
+	for ( int a = 0; a < 3; a++ ) {
+		float d = ( points[hi[a]] - points[lo[a]] ).squaredLength();
+		if ( d > span ) {
+			span = d;
+			axis = a;
+		}
+	}
 
-			if ( d > radius )
-				radius = d;
+	center = ( points[lo[axis]] + points[hi[axis]] ) / 2;
+	float r = sqrt( span ) / 2;
+	float r2 = r * r;
+
+	// Grow it to enclose the remaining points
+	for ( int i = 0; i < count; i++ ) {
+		Vector3 v = points[i] - center;
+		float d2 = v.squaredLength();
+
+		if ( d2 > r2 ) {
+			float d = sqrt( d2 );
+			float grown = ( r + d ) / 2;
+			center += v * ( ( grown - r ) / d );
+			r = grown;
+			r2 = r * r;
 		}
-		radius = sqrt( radius );
 	}
+
+	radius = r;
+}
+
+BoundSphere::BoundSphere( const QVector<Vector3> & verts ) : BoundSphere( verts.constData(), verts.count() )
+{
+}
+
+BoundSphere BoundSphere::around( const Vector3 & center, const Vector3 * points, int count )
+{
+	if ( count <= 0 )
+		return BoundSphere( center, -1 );
+
+	float r2 = 0;
+	for ( int i = 0; i < count; i++ )
+		r2 = std::max( r2, ( points[i] - center ).squaredLength() );
+
+	return BoundSphere( center, sqrt( r2 ) );
 }
 
 void BoundSphere::update( NifModel * nif, const QModelIndex & index )
@@ -35,6 +35,29 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "data/niftypes.h"
 
+//! An axis-aligned bounding box
+class BoundingBox final
+{
+public:
+	//! Creates an empty box
+	BoundingBox();
+	//! Creates the box enclosing \a count points in a single pass
+	BoundingBox( const Vector3 * points, int count );
+	BoundingBox( const QVector<Vector3> & points );
+
+	Vector3 lower;
+	Vector3 upper;
+
+	bool isEmpty() const { return lower[0] > upper[0]; }
+
+	Vector3 center() const { return ( lower + upper ) / 2; }
+	//! Half the size of the box along each axis
+	Vector3 extents() const { return ( upper - lower ) / 2; }
+
+	BoundingBox & operator|=( const Vector3 & );
+	BoundingBox & operator|=( const BoundingBox & );
+};
+
 //! A bounding sphere for an object, typically a Mesh
 class BoundSphere final
 {
@@ -45,8 +68,17 @@ public:
 	BoundSphere( const BoundSphere & );
 	BoundSphere( const NifModel * nif, const QModelIndex & );
 	BoundSphere( const Vector3 & center, float radius );
+	//! Creates a tight sphere around \a count points using Ritter's algorithm
+	/*!
+	 * This is used for both the viewport and the bounds written by the
+	 * spells, so that the two always agree.
+	 */
+	BoundSphere( const Vector3 * points, int count );
 	BoundSphere( const QVector<Vector3> & vertices );
 
+	//! Creates the smallest sphere with the given center enclosing \a count points
+	static BoundSphere around( const Vector3 & center, const Vector3 * points, int count );
+
 	Vector3 center;
 	float radius;
 
@@ -0,0 +1,446 @@
+#include "meshoptimizer.h"
+
+#include <QHash>
+#include <QPair>
+
+#include <algorithm> // std::swap, std::stable_sort, std::count_if
+#include <climits>
+#include <cmath>
+
+
+namespace
+{
+	// Size of the simulated LRU cache and the scoring constants from Forsyth's paper
+	const int CacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float vertexScore( int cachePos, int remaining )
+	{
+		// No triangles left to use this vertex
+		if ( remaining == 0 )
+			return -1.0f;
+
+		float score = 0.0f;
+
+		if ( cachePos >= 0 ) {
+			// The vertices of the last triangle get a fixed score so that
+			// the next triangle does not simply reuse the same edge
+			if ( cachePos < 3 )
+				score = LastTriScore;
+			else
+				score = std::pow( 1.0f - float( cachePos - 3 ) / float( CacheSize - 3 ), CacheDecayPower );
+		}
+
+		// Boost vertices with few triangles left, to get rid of lone triangles early
+		score += ValenceBoostScale * std::pow( float( remaining ), -ValenceBoostPower );
+
+		return score;
+	}
+}
+
+QVector<Triangle> MeshOptimizer::optimizeVertexCache( const QVector<Triangle> & triangles, int numVerts )
+{
+	int numTris = triangles.count();
+
+	if ( numVerts < 0 ) {
+		numVerts = 0;
+		for ( const Triangle & tri : triangles )
+			numVerts = qMax( numVerts, qMax( int( tri[0] ), qMax( int( tri[1] ), int( tri[2] ) ) ) + 1 );
+	}
+
+	if ( numTris < 2 || numVerts <= 0 )
+		return triangles;
+
+	// Triangles of each vertex; the first remaining[v] entries from offsets[v] are still to be emitted
+	QVector<int> offsets( numVerts + 1, 0 );
+	for ( const Triangle & tri : triangles ) {
+		for ( int c = 0; c < 3; c++ ) {
+			if ( tri[c] >= numVerts )
+				return triangles;
+
+			offsets[tri[c] + 1]++;
+		}
+	}
+
+	for ( int v = 0; v < numVerts; v++ )
+		offsets[v + 1] += offsets[v];
+
+	QVector<int> remaining( numVerts, 0 );
+	QVector<int> adjacency( numTris * 3 );
+	for ( int t = 0; t < numTris; t++ ) {
+		for ( int c = 0; c < 3; c++ ) {
+			int v = triangles[t][c];
+			adjacency[offsets[v] + remaining[v]++] = t;
+		}
+	}
+
+	QVector<int> cachePos( numVerts, -1 );
+	QVector<float> vscore( numVerts );
+	for ( int v = 0; v < numVerts; v++ )
+		vscore[v] = vertexScore( -1, remaining[v] );
+
+	QVector<float> tscore( numTris );
+	QVector<bool> emitted( numTris, false );
+	int best = 0;
+
+	for ( int t = 0; t < numTris; t++ ) {
+		const Triangle & tri = triangles[t];
+		tscore[t] = vscore[tri[0]] + vscore[tri[1]] + vscore[tri[2]];
+
+		if ( tscore[t] > tscore[best] )
+			best = t;
+	}
+
+	// The cache holds CacheSize entries plus room for the 3 vertices pushed in by a triangle
+	int cache[CacheSize + 3];
+	int cacheCount = 0;
+	int next = 0;
+
+	QVector<Triangle> result;
+	result.reserve( numTris );
+
+	while ( result.count() < numTris ) {
+		if ( best < 0 ) {
+			// Nothing in the cache is used any more, continue with the next triangle in the input
+			while ( emitted[next] )
+				next++;
+
+			best = next;
+		}
+
+		const Triangle & tri = triangles[best];
+		emitted[best] = true;
+		result.append( tri );
+
+		int newCache[CacheSize + 3];
+		int newCount = 0;
+
+		for ( int c = 0; c < 3; c++ ) {
+			int v = tri[c];
+
+			// Remove the triangle from the vertex' remaining triangles
+			int * first = adjacency.data() + offsets[v];
+			int * last = first + --remaining[v];
+			for ( int * it = first; it <= last; it++ ) {
+				if ( *it == best ) {
+					std::swap( *it, *last );
+					break;
+				}
+			}
+
+			bool dup = false;
+			for ( int i = 0; i < newCount; i++ )
+				dup |= ( newCache[i] == v );
+
+			if ( !dup )
+				newCache[newCount++] = v;
+		}
+
+		for ( int i = 0; i < cacheCount; i++ ) {
+			int v = cache[i];
+
+			if ( v != tri[0] && v != tri[1] && v != tri[2] )
+				newCache[newCount++] = v;
+		}
+
+		// Rescore the vertices in the cache and those pushed out of it
+		for ( int i = 0; i < newCount; i++ ) {
+			int v = newCache[i];
+			cachePos[v] = ( i < CacheSize ) ? i : -1;
+			vscore[v] = vertexScore( cachePos[v], remaining[v] );
+		}
+
+		// Rescore the remaining triangles touching those vertices and pick the best one
+		best = -1;
+		float bestScore = -1.0f;
+
+		for ( int i = 0; i < newCount; i++ ) {
+			int v = newCache[i];
+
+			for ( int j = offsets[v]; j < offsets[v] + remaining[v]; j++ ) {
+				int t = adjacency[j];
+				const Triangle & adj = triangles[t];
+				tscore[t] = vscore[adj[0]] + vscore[adj[1]] + vscore[adj[2]];
+
+				if ( i < CacheSize && tscore[t] > bestScore ) {
+					bestScore = tscore[t];
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = qMin( newCount, CacheSize );
+		for ( int i = 0; i < cacheCount; i++ )
+			cache[i] = newCache[i];
+	}
+
+	return result;
+}
+
+QVector<Triangle> MeshOptimizer::optimizeOverdraw( const QVector<Triangle> & triangles, const QVector<Vector3> & verts, int cacheSize )
+{
+	int numTris = triangles.count();
+
+	for ( const Triangle & tri : triangles ) {
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			return triangles;
+	}
+
+	// Split into clusters where the cache is cold
+	QVector<int> clusters;
+	QVector<int> stamp( verts.count(), -cacheSize );
+	int time = 0;
+
+	for ( int t = 0; t < numTris; t++ ) {
+		int misses = 0;
+
+		for ( int c = 0; c < 3; c++ ) {
+			int v = triangles[t][c];
+
+			if ( time - stamp[v] >= cacheSize ) {
+				stamp[v] = ++time;
+				misses++;
+			}
+		}
+
+		if ( misses == 3 || t == 0 )
+			clusters.append( t );
+	}
+
+	if ( clusters.count() < 2 )
+		return triangles;
+
+	clusters.append( numTris );
+
+	// Area weighted centroid and normal of each cluster
+	QVector<Vector3> centroids( clusters.count() - 1 );
+	QVector<Vector3> normals( clusters.count() - 1 );
+	Vector3 center;
+	float totalArea = 0;
+
+	for ( int i = 0; i < clusters.count() - 1; i++ ) {
+		float area = 0;
+
+		for ( int t = clusters[i]; t < clusters[i + 1]; t++ ) {
+			const Vector3 & a = verts[triangles[t][0]];
+			const Vector3 & b = verts[triangles[t][1]];
+			const Vector3 & c = verts[triangles[t][2]];
+
+			Vector3 n = Vector3::crossProduct( b - a, c - a );
+			float w = n.length();
+
+			centroids[i] += ( a + b + c ) * ( w / 3.0f );
+			normals[i] += n;
+			area += w;
+		}
+
+		center += centroids[i];
+		totalArea += area;
+
+		if ( area > 0 )
+			centroids[i] /= area;
+
+		normals[i].normalize();
+	}
+
+	if ( totalArea > 0 )
+		center /= totalArea;
+
+	QVector<QPair<float, int> > order( clusters.count() - 1 );
+
+	for ( int i = 0; i < order.count(); i++ )
+		order[i] = { -Vector3::dotProduct( centroids[i] - center, normals[i] ), i };
+
+	std::stable_sort( order.begin(), order.end() );
+
+	QVector<Triangle> result;
+	result.reserve( numTris );
+
+	for ( const auto & o : order ) {
+		for ( int t = clusters[o.second]; t < clusters[o.second + 1]; t++ )
+			result.append( triangles[t] );
+	}
+
+	return result;
+}
+
+QVector<QVector<quint16> > MeshOptimizer::stripify( const QVector<Triangle> & input, bool stitch )
+{
+	QVector<Triangle> triangles;
+	triangles.reserve( input.count() );
+
+	for ( const Triangle & tri : input ) {
+		if ( tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0] )
+			triangles.append( tri );
+	}
+
+	int numTris = triangles.count();
+
+	// Triangles by directed edge
+	auto edgeKey = []( quint16 a, quint16 b ) { return ( quint32( a ) << 16 ) | b; };
+
+	QMultiHash<quint32, int> edges;
+	edges.reserve( numTris * 3 );
+
+	for ( int t = 0; t < numTris; t++ ) {
+		for ( int c = 0; c < 3; c++ )
+			edges.insert( edgeKey( triangles[t][c], triangles[t][( c + 1 ) % 3] ), t );
+	}
+
+	QVector<bool> emitted( numTris, false );
+
+	// Find an unused triangle with the directed edge a -> b
+	auto findNext = [&]( quint16 a, quint16 b ) {
+		quint32 key = edgeKey( a, b );
+
+		for ( auto it = edges.constFind( key ); it != edges.constEnd() && it.key() == key; ++it ) {
+			if ( !emitted[it.value()] )
+				return it.value();
+		}
+
+		return -1;
+	};
+
+	QVector<QVector<quint16> > strips;
+
+	for ( int s = 0; s < numTris; s++ ) {
+		if ( emitted[s] )
+			continue;
+
+		emitted[s] = true;
+
+		// Start with the rotation that can be continued
+		const Triangle & tri = triangles[s];
+		int r = 0;
+
+		while ( r < 2 && findNext( tri[( r + 2 ) % 3], tri[( r + 1 ) % 3] ) < 0 )
+			r++;
+
+		QVector<quint16> strip { tri[r], tri[( r + 1 ) % 3], tri[( r + 2 ) % 3] };
+
+		while ( true ) {
+			int k = strip.count();
+			quint16 a = strip[k - 2];
+			quint16 b = strip[k - 1];
+
+			// Every other triangle in a strip has reversed winding
+			int t = ( ( k - 2 ) & 1 ) ? findNext( b, a ) : findNext( a, b );
+
+			if ( t < 0 )
+				break;
+
+			emitted[t] = true;
+
+			const Triangle & next = triangles[t];
+			for ( int c = 0; c < 3; c++ ) {
+				if ( next[c] != a && next[c] != b ) {
+					strip.append( next[c] );
+					break;
+				}
+			}
+		}
+
+		strips.append( strip );
+	}
+
+	if ( !stitch || strips.count() < 2 )
+		return strips;
+
+	QVector<QVector<quint16> > stitched;
+	QVector<quint16> strip = strips.first();
+
+	for ( int i = 1; i < strips.count(); i++ ) {
+		const QVector<quint16> & s = strips[i];
+		int joint = ( strip.count() & 1 ) ? 3 : 2;
+
+		if ( strip.count() + joint + s.count() > USHRT_MAX ) {
+			stitched.append( strip );
+			strip = s;
+			continue;
+		}
+
+		// Keep the winding of the next strip with degenerate triangles
+		if ( strip.count() & 1 )
+			strip << strip.last() << s.first() << s.first() << s;
+		else
+			strip << strip.last() << s.first() << s;
+	}
+
+	stitched.append( strip );
+
+	return stitched;
+}
+
+namespace
+{
+	//! Count the vertex cache misses of an index stream
+	int cacheMisses( const QVector<quint16> & indices, int cacheSize, QVector<int> & stamp, int & time )
+	{
+		int misses = 0;
+
+		for ( const auto v : indices ) {
+			if ( v >= stamp.count() )
+				stamp.resize( v + 1 );
+
+			// stamp[v] is 0 for vertices never seen
+			if ( stamp[v] == 0 || time - stamp[v] >= cacheSize ) {
+				stamp[v] = ++time;
+				misses++;
+			}
+		}
+
+		return misses;
+	}
+
+	MeshOptimizer::CacheStats cacheStats( int misses, int numTris, const QVector<int> & stamp )
+	{
+		MeshOptimizer::CacheStats stats;
+		stats.misses = misses;
+
+		int used = std::count_if( stamp.cbegin(), stamp.cend(), []( int s ) { return s > 0; } );
+
+		if ( numTris > 0 )
+			stats.acmr = float( misses ) / float( numTris );
+		if ( used > 0 )
+			stats.atvr = float( misses ) / float( used );
+
+		return stats;
+	}
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache( const QVector<Triangle> & triangles, int cacheSize )
+{
+	QVector<quint16> indices;
+	indices.reserve( triangles.count() * 3 );
+
+	for ( const Triangle & tri : triangles )
+		indices << tri[0] << tri[1] << tri[2];
+
+	QVector<int> stamp;
+	int time = 0;
+	int misses = cacheMisses( indices, cacheSize, stamp, time );
+
+	return cacheStats( misses, triangles.count(), stamp );
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache( const QVector<QVector<quint16> > & strips, int cacheSize )
+{
+	QVector<int> stamp;
+	int time = 0;
+	int misses = 0;
+	int numTris = 0;
+
+	for ( const QVector<quint16> & strip : strips ) {
+		misses += cacheMisses( strip, cacheSize, stamp, time );
+
+		for ( int i = 2; i < strip.count(); i++ ) {
+			if ( strip[i - 2] != strip[i - 1] && strip[i - 1] != strip[i] && strip[i] != strip[i - 2] )
+				numTris++;
+		}
+	}
+
+	return cacheStats( misses, numTris, stamp );
+}
@@ -0,0 +1,100 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! @file meshoptimizer.h MeshOptimizer
+
+//! Triangle reordering for the GPU vertex caches and triangle strip generation
+namespace MeshOptimizer
+{
+	//! Efficiency of a triangle order for a FIFO post-transform vertex cache
+	struct CacheStats
+	{
+		//! Number of vertices transformed
+		int misses = 0;
+		//! Average cache miss ratio: vertices transformed per triangle, 0.5 at best, 3 at worst
+		float acmr = 0;
+		//! Average transform to vertex ratio: vertices transformed per vertex used, 1 at best
+		float atvr = 0;
+	};
+
+	/*! Reorder triangles for the post-transform vertex cache
+	 *
+	 * Greedy linear-time ordering after Tom Forsyth's "Linear-Speed Vertex Cache
+	 * Optimisation": every vertex is scored by its position in a simulated LRU cache
+	 * and by the number of triangles still using it, and the triangle with the best
+	 * score among those touching the cache is emitted next.
+	 *
+	 * @param triangles	The triangles to reorder
+	 * @param numVerts	The number of vertices, or -1 to derive it from the triangles
+	 * @return			The same triangles in cache friendly order
+	 */
+	QVector<Triangle> optimizeVertexCache( const QVector<Triangle> & triangles, int numVerts = -1 );
+
+	/*! Reorder clusters of triangles to reduce overdraw
+	 *
+	 * The triangles, best already ordered for the vertex cache, are split into clusters
+	 * wherever all three vertices of a triangle miss the cache. The clusters facing away
+	 * from the center of the mesh are drawn first, as they are most likely to occlude
+	 * the others. The vertex cache efficiency is kept as the order within clusters stays.
+	 *
+	 * @param triangles	The triangles to reorder
+	 * @param verts		The vertex positions
+	 * @param cacheSize	The size of the simulated FIFO cache
+	 */
+	QVector<Triangle> optimizeOverdraw( const QVector<Triangle> & triangles, const QVector<Vector3> & verts, int cacheSize = 16 );
+
+	/*! Build triangle strips
+	 *
+	 * Each strip is grown from the first triangle not yet used, in the order
+	 * of the triangles, along the shared edges with matching winding.
+	 * Degenerate triangles are dropped.
+	 *
+	 * @param triangles	The triangles, best already ordered for the vertex cache
+	 * @param stitch	Join the strips with degenerate triangles; a strip is never longer than 65535 indices
+	 */
+	QVector<QVector<quint16> > stripify( const QVector<Triangle> & triangles, bool stitch = true );
+
+	//! Simulate a FIFO vertex cache on a triangle list
+	CacheStats analyzeVertexCache( const QVector<Triangle> & triangles, int cacheSize = 16 );
+	//! Simulate a FIFO vertex cache on triangle strips
+	CacheStats analyzeVertexCache( const QVector<QVector<quint16> > & strips, int cacheSize = 16 );
+}
+
+#endif
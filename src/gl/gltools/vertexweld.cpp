@@ -0,0 +1,105 @@
+#include "vertexweld.h"
+
+#include "xxhash.h"
+
+#include <cmath>
+#include <cstring>
+
+
+VertexWeld::VertexWeld( int count ) : count( count )
+{
+}
+
+void VertexWeld::addAttribute( const float * data, int dim, float epsilon )
+{
+	for ( int c = 0; c < dim; c++ ) {
+		QVector<quint32> key( count );
+
+		for ( int v = 0; v < count; v++ ) {
+			float f = data[v * dim + c];
+
+			if ( epsilon > 0 ) {
+				key[v] = quint32( qint32( std::floor( f / epsilon + 0.5f ) ) );
+			} else {
+				// -0 and 0 are equal
+				if ( f == 0.0f )
+					f = 0.0f;
+
+				std::memcpy( &key[v], &f, sizeof(quint32) );
+			}
+		}
+
+		keys.append( key );
+		words++;
+	}
+}
+
+QVector<int> VertexWeld::weld() const
+{
+	QVector<int> welded( count );
+
+	// Gather the words of each vertex to hash and compare them as one block
+	QVector<quint32> rows( count * words );
+
+	for ( int w = 0; w < words; w++ ) {
+		const quint32 * key = keys[w].constData();
+
+		for ( int v = 0; v < count; v++ )
+			rows[v * words + w] = key[v];
+	}
+
+	// Load factor of at most a half
+	int size = 16;
+	while ( size < count * 2 )
+		size *= 2;
+
+	const int mask = size - 1;
+
+	QVector<int> table( size, -1 );
+	QVector<quint64> hashes( count );
+
+	for ( int v = 0; v < count; v++ ) {
+		const quint32 * row = rows.constData() + v * words;
+
+		quint64 hash = XXH64( row, words * sizeof(quint32), 0 );
+		hashes[v] = hash;
+
+		int slot = int( hash & mask );
+
+		welded[v] = v;
+
+		// Linear probing until an empty slot or an equal vertex
+		while ( table[slot] >= 0 ) {
+			int other = table[slot];
+
+			if ( hashes[other] == hash && std::memcmp( rows.constData() + other * words, row, words * sizeof(quint32) ) == 0 ) {
+				welded[v] = other;
+				break;
+			}
+
+			slot = ( slot + 1 ) & mask;
+		}
+
+		if ( welded[v] == v )
+			table[slot] = v;
+	}
+
+	return welded;
+}
+
+int VertexWeld::compact( const QVector<int> & welded, QVector<int> & remap )
+{
+	int distinct = 0;
+
+	remap.resize( welded.count() );
+
+	for ( int v = 0; v < welded.count(); v++ ) {
+		// The first vertex of a group always comes before its duplicates
+		if ( welded[v] == v )
+			remap[v] = distinct++;
+		else
+			remap[v] = remap[welded[v]];
+	}
+
+	return distinct;
+}
@@ -0,0 +1,91 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef VERTEXWELD_H
+#define VERTEXWELD_H
+
+#include <QVector>
+
+
+//! @file vertexweld.h VertexWeld
+
+/*! Finds vertices with equal attributes in linear time
+ *
+ * Every attribute of a vertex is quantized to a 32-bit word, the words are
+ * hashed and equal vertices are found through an open addressing table.
+ * Attributes compared with an epsilon are snapped to a grid of that size, so
+ * two values closer than epsilon can still fall into neighbouring cells.
+ */
+class VertexWeld final
+{
+public:
+	//! @param count The number of vertices
+	VertexWeld( int count );
+
+	/*! Add an attribute of every vertex
+	 *
+	 * @param data		count * dim floats
+	 * @param dim		Number of floats per vertex
+	 * @param epsilon	Size of the quantization grid; 0 compares exactly
+	 */
+	void addAttribute( const float * data, int dim, float epsilon = 0 );
+
+	//! Add an attribute stored as a vector of floats per vertex; ignored if the size differs
+	template <typename T> void addAttribute( const QVector<T> & data, float epsilon = 0 )
+	{
+		if ( data.count() == count )
+			addAttribute( reinterpret_cast<const float *>( data.constData() ), sizeof(T) / sizeof(float), epsilon );
+	}
+
+	/*! Find the duplicates
+	 *
+	 * @return For each vertex the index of the first vertex equal to it
+	 */
+	QVector<int> weld() const;
+
+	/*! Number the distinct vertices of a weld
+	 *
+	 * @param[in]  welded	The result of weld()
+	 * @param[out] remap	For each vertex the index of its distinct vertex in the compacted arrays
+	 * @return				The number of distinct vertices
+	 */
+	static int compact( const QVector<int> & welded, QVector<int> & remap );
+
+private:
+	int count;
+	int words = 0;
+
+	//! Quantized attributes, words per vertex
+	QVector<QVector<quint32>> keys;
+};
+
+#endif
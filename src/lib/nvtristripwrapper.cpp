@@ -1,7 +1,7 @@
 #include "nvtristripwrapper.h"
 #include "data/niftypes.h"
 
-#include <NvTriStrip.h>
+#include "gl/gltools/meshoptimizer.h"
 
 
 QVector<QVector<quint16> > stripify( QVector<Triangle> triangles, bool stitch )
@@ -9,44 +9,7 @@ QVector<QVector<quint16> > stripify( QVector<Triangle> triangles, bool stitch )
 	if ( triangles.count() <= 0 )
 		return QVector<QVector<quint16> >();
 
-	unsigned short * data = (unsigned short *)malloc( triangles.count() * 3 * sizeof( unsigned short ) );
-	if ( !data )
-		return QVector<QVector<quint16> >();
-
-	for ( int t = 0; t < triangles.count(); t++ ) {
-		data[ t * 3 + 0 ] = triangles[t][0];
-		data[ t * 3 + 1 ] = triangles[t][1];
-		data[ t * 3 + 2 ] = triangles[t][2];
-	}
-
-	PrimitiveGroup * groups  = 0;
-	unsigned short numGroups = 0;
-
-	SetStitchStrips( stitch );
-	//SetCacheSize( 64 );
-	GenerateStrips( data, triangles.count() * 3, &groups, &numGroups );
-	free( data );
-
-	QVector<QVector<quint16> > strips;
-
-	if ( !groups )
-		return strips;
-
-	for ( int g = 0; g < numGroups; g++ ) {
-		if ( groups[g].type == PT_STRIP ) {
-			QVector<quint16> strip( groups[g].numIndices, 0 );
-
-			for ( quint32 s = 0; s < groups[g].numIndices; s++ ) {
-				strip[s] = groups[g].indices[s];
-			}
-
-			strips.append( strip );
-		}
-	}
-
-	delete [] groups;
-
-	return strips;
+	return MeshOptimizer::stripify( MeshOptimizer::optimizeVertexCache( triangles ), stitch );
 }
 
 QVector<Triangle> triangulate( QVector<quint16> strip )
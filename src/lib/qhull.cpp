@@ -36,6 +36,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QDebug>
 #include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -90,6 +92,9 @@ extern "C"
 
 // TODO: investigate the C++ interfaces to Qhull; the Qt interface requires GCC 4.3
 
+//! Guards the global state of the non-reentrant libqhull
+static QMutex qhullMutex;
+
 //! An interface to <a href="http://www.qhull.org">Qhull</a> for generating Havok-compatible convex shapes
 QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<Vector4> & hullVerts, QVector<Vector4> & hullNorms, float roundError )
 {
@@ -141,6 +146,9 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 		points[i * 3 + 2] = verts[i][2];
 	}
 
+	// libqhull keeps its state in the global qh_qh, so only one hull may be built at a time
+	QMutexLocker lock( &qhullMutex );
+
 	/* initialize dim, numpoints, points[], ismalloc here */
 	exitcode = qh_new_qhull( dim, numpoints, points, ismalloc,
 		flags, outfile, errfile );
@@ -36,9 +36,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QByteArray>
 #include <QColor>
-#include <QBuffer>
 #include <QFile>
 #include <QFileInfo>
+#include <QSaveFile>
 #include <QTime>
 
 
@@ -48,9 +48,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *  BaseModel
  */
 
-BaseModel::BaseModel( QObject * p ) : QAbstractItemModel( p )
+BaseModel::BaseModel( QObject * p ) : QAbstractItemModel( p ), itemArena( sizeof( NifItem ) )
 {
-	root = new NifItem( 0 );
+	root = new ( itemArena ) NifItem( 0 );
 	parentWindow = qobject_cast<QWidget *>(p);
 	msgMode = MSG_TEST;
 }
@@ -101,6 +101,17 @@ void BaseModel::testMsg( const QString & m ) const
 
 void BaseModel::beginInsertRows( const QModelIndex & parent, int first, int last )
 {
+	if ( state != Loading )
+		itemModified( static_cast<NifItem *>( parent.internalPointer() ) );
+
+	if ( trackChanges && !parent.isValid() && !changedRows.isEmpty() ) {
+		// Keep the changed top-level rows pointing at the same items
+		QSet<int> rows;
+		for ( int r : changedRows )
+			rows.insert( r >= first ? r + last - first + 1 : r );
+		changedRows = rows;
+	}
+
 	setState( Inserting );
 	QAbstractItemModel::beginInsertRows( parent, first, last );
 }
@@ -113,6 +124,21 @@ void BaseModel::endInsertRows()
 
 void BaseModel::beginRemoveRows( const QModelIndex & parent, int first, int last )
 {
+	if ( state != Loading )
+		itemModified( static_cast<NifItem *>( parent.internalPointer() ) );
+
+	if ( trackChanges && !parent.isValid() && !changedRows.isEmpty() ) {
+		// Removed rows need no signal, the rows after them move up
+		QSet<int> rows;
+		for ( int r : changedRows ) {
+			if ( r < first )
+				rows.insert( r );
+			else if ( r > last )
+				rows.insert( r - ( last - first + 1 ) );
+		}
+		changedRows = rows;
+	}
+
 	setState( Removing );
 	QAbstractItemModel::beginRemoveRows( parent, first, last );
 }
@@ -123,6 +149,29 @@ void BaseModel::endRemoveRows()
 	restoreState();
 }
 
+void BaseModel::itemChanged( NifItem * first, NifItem * last )
+{
+	if ( !last )
+		last = first;
+
+	if ( state != Loading )
+		itemModified( first );
+
+	if ( state != Processing ) {
+		emit dataChanged( createIndex( first->row(), ValueCol, first ), createIndex( last->row(), ValueCol, last ) );
+		return;
+	}
+
+	changedWhileProcessing = true;
+
+	if ( trackChanges ) {
+		while ( first->parent() && first->parent() != root )
+			first = first->parent();
+
+		changedRows.insert( first->row() );
+	}
+}
+
 bool BaseModel::getProcessingResult()
 {
 	bool result = changedWhileProcessing;
@@ -531,6 +580,8 @@ bool BaseModel::setData( const QModelIndex & index, const QVariant & value, int
 	if ( !( index.isValid() && role == Qt::EditRole && index.model() == this && item ) )
 		return false;
 
+	itemModified( item );
+
 	switch ( index.column() ) {
 	case BaseModel::NameCol:
 		item->setName( value.toString() );
@@ -670,13 +721,18 @@ bool BaseModel::loadFromFile( const QString & file )
 
 bool BaseModel::saveToFile( const QString & str ) const
 {
-	QFile f( str );
-	QBuffer buf;
-	bool success = false;
-	if ( buf.open( QIODevice::WriteOnly ) && save( buf ) )
-		success = f.open( QIODevice::WriteOnly ) && f.write( buf.data() ) > 0;
+	// Stream straight to a temporary file that only replaces the target once complete
+	QSaveFile f( str );
+	if ( f.open( QIODevice::WriteOnly ) && save( f ) ) {
+		if ( !f.commit() )
+			return false;
 
-	return success;
+		fileSaved( str );
+		return true;
+	}
+
+	f.cancelWriting();
+	return false;
 }
 
 void BaseModel::refreshFileInfo( const QString & f )
@@ -39,6 +39,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QAbstractItemModel> // Inherited
 #include <QFileInfo>
 #include <QIODevice>
+#include <QSet>
 #include <QStack>
 #include <QString>
 #include <QVariant>
@@ -319,6 +320,12 @@ protected:
 	virtual NifItem * getItem( NifItem * parent, const QString & name ) const;
 	//! Set an item value
 	virtual bool setItemValue( NifItem * item, const NifValue & v ) = 0;
+	//! Emit dataChanged for an item (or a range of siblings), or defer it while processing
+	void itemChanged( NifItem * first, NifItem * last = nullptr );
+	//! Called when the value or the rows of an item are about to change, except while loading
+	virtual void itemModified( NifItem * /*item*/ ) {}
+	//! Called when a save has replaced \a file
+	virtual void fileSaved( const QString & /*file*/ ) const {}
 
 	//! Update an array item
 	virtual bool updateArrayItem( NifItem * array ) = 0;
@@ -369,6 +376,8 @@ protected:
 	//! NifSkope window the model belongs to
 	QWidget * parentWindow;
 
+	//! Slabs that every item of the model is allocated from
+	NifItemArena itemArena;
 	//! The root item
 	NifItem * root;
 
@@ -395,6 +404,10 @@ protected:
 
 	//! Has any data changed while processing
 	bool changedWhileProcessing = false;
+	//! Collect the top-level items changed while processing
+	bool trackChanges = false;
+	//! Rows of the top-level items changed while trackChanges was set, kept in step with top-level row insertions and removals
+	QSet<int> changedRows;
 };
 
 
@@ -484,11 +497,7 @@ template <typename T> inline T BaseModel::get( const QModelIndex & index ) const
 template <typename T> inline bool BaseModel::set( NifItem * item, const T & d )
 {
 	if ( item->value().set( d ) ) {
-		if ( state != Processing )
-			emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
-		else
-			changedWhileProcessing = true;
-
+		itemChanged( item );
 		return true;
 	}
 
@@ -529,7 +538,7 @@ template <typename T> inline void BaseModel::setArray( const QModelIndex & iArra
 		int x = item->childCount() - 1;
 
 		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+			itemChanged( item->child( 0 ), item->child( x ) );
 	}
 }
 
@@ -542,7 +551,7 @@ template <typename T> inline void BaseModel::setArray( const QModelIndex & iArra
 		int x = item->childCount() - 1;
 
 		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+			itemChanged( item->child( 0 ), item->child( x ) );
 	}
 }
 
@@ -38,11 +38,16 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/niftypes.h"
 #include "io/nifstream.h"
 
+#include <QBuffer>
 #include <QByteArray>
 #include <QColor>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QSettings>
+#include <QtEndian>
+
+#include <algorithm>
 
 QHash<QString, QString> arrayPseudonyms;
 QHash<QString, QString> multiArrayPseudonyms1;
@@ -399,7 +404,14 @@ void NifModel::clear()
 	fileinfo = QFileInfo();
 	filename = QString();
 	folder = QString();
+	lazyBlocks.clear();
+	rawBlocks.clear();
+	savedBlocks.clear();
+	rawSource.clear();
 	root->killChildren();
+	itemArena.trim();
+	elementData.clear();
+	templatedData.clear();
 
 	NifData headerData = NifData( "NiHeader", "Header" );
 	NifData footerData = NifData( "NiFooter", "Footer" );
@@ -586,7 +598,8 @@ void NifModel::updateHeader()
 			blocktypeindices.append( bTypeIdx );
 
 			if ( version >= 0x14020000 && idxBlockSize ) {
-				updateArrays( block );
+				if ( !isRawBlock( block ) )
+					updateArrays( block );
 				blocksizes.append( blockSize( block ) );
 			}
 
@@ -649,6 +662,15 @@ NifItem * NifModel::getItem( NifItem * item, const QString & name ) const
 	if ( !item || item == root )
 		return nullptr;
 
+	if ( !lazyBlocks.isEmpty() && lazyBlocks.contains( item ) ) {
+		// Unbuilt blocks are only built for a field their type has
+		QString field = name.section( QLatin1String("\\"), 0, 0 );
+		if ( field != ".." && !lazyBlockHasField( item, field ) )
+			return nullptr;
+
+		materializeBlock( item );
+	}
+
 	//if ( item->isArray() || item->parent()->isArray() ) {
 		int slash = name.indexOf( QLatin1String("\\") );
 		if ( slash > 0 ) {
@@ -747,15 +769,17 @@ bool NifModel::updateArrayItem( NifItem * array )
 	if ( !isArray( array ) )
 		return false;
 
-	// New row count
-	int rows = getArraySize( array );
-
 	// Binary array handling
 	if ( array->isBinary() ) {
 		if ( updateByteArrayItem( array ) )
 			return true;
 	}
 
+	return resizeArrayItem( array, getArraySize( array ) );
+}
+
+bool NifModel::resizeArrayItem( NifItem * array, int rows )
+{
 	// Error handling
 	if ( rows > 1024 * 1024 * 8 ) {
 		auto m = tr( "[%1] Array %2 much too large. %3 bytes requested." ).arg( getBlockNumber( array ) )
@@ -775,18 +799,7 @@ bool NifModel::updateArrayItem( NifItem * array )
 
 	// Add item children
 	if ( rows > itemRows ) {
-		NifData data( array->name(),
-					  array->type(),
-					  array->temp(),
-					  NifValue( NifValue::type( array->type() ) ),
-					  parentPrefix( array->arg() ),
-					  parentPrefix( array->arr2() ) // arr1 in children is parent arr2
-		);
-
-		// Fill data flags
-		data.setIsConditionless( true );
-		data.setIsCompound( array->isCompound() );
-		data.setIsArray( array->isMultiArray() );
+		NifData data = arrayElementData( array );
 
 		beginInsertRows( createIndex( array->row(), 0, array ), itemRows, rows - 1 );
 
@@ -813,16 +826,36 @@ bool NifModel::updateArrayItem( NifItem * array )
 		while ( parent->parent() && parent->parent() != root )
 			parent = parent->parent();
 
-		if ( parent != getFooterItem() ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
+		if ( parent != getFooterItem() )
+			linkChanged( array );
 	}
 
 	return true;
 }
 
+NifData NifModel::arrayElementData( NifItem * array )
+{
+	auto it = elementData.constFind( array->data().key() );
+	if ( it != elementData.constEnd() )
+		return it->second;
+
+	NifData data( array->name(),
+				  array->type(),
+				  array->temp(),
+				  NifValue( NifValue::type( array->type() ) ),
+				  parentPrefix( array->arg() ),
+				  parentPrefix( array->arr2() ) // arr1 in children is parent arr2
+	);
+
+	// Fill data flags
+	data.setIsConditionless( true );
+	data.setIsCompound( array->isCompound() );
+	data.setIsArray( array->isMultiArray() );
+
+	elementData.insert( array->data().key(), { array->data(), data } );
+	return data;
+}
+
 bool NifModel::updateArrays( NifItem * parent )
 {
 	if ( !parent )
@@ -852,16 +885,20 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 	NifBlockPtr block = blocks.value( identifier );
 
 	if ( block ) {
-		if ( at < 0 || at > getBlockCount() )
+		int count = getBlockCount();
+		if ( at < 0 || at > count )
 			at = -1;
 
-		if ( at >= 0 )
-			adjustLinks( root, at, 1 );
+		// Every block from the insertion point on moves up by one
+		int num = ( at >= 0 ) ? at : count;
+		QVector<qint32> map( count );
+		for ( int b = 0; b < count; b++ )
+			map[b] = ( b < num ) ? b : b + 1;
 
 		if ( at >= 0 )
-			at++;
-		else
-			at = getBlockCount() + 1;
+			remapBlockLinks( map, at );
+
+		at = num + 1;
 
 		beginInsertRows( QModelIndex(), at, at );
 
@@ -870,24 +907,16 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 
 		endInsertRows();
 
-		if ( !block->ancestor.isEmpty() )
-			insertAncestor( branch, block->ancestor );
-
-		branch->prepareInsert( block->types.count() );
-
-		if ( getUserVersion2() >= 151 && identifier.startsWith( "BSLighting" ) ) {
-			for ( const NifData& data : block->types ) {
-				insertType( branch, data );
-			}
-		} else {
-			for ( const NifData& data : block->types ) {
-				insertType( branch, data );
-			}
-		}
+		insertBlockTypes( branch, block );
 
 		if ( state != Loading ) {
 			updateHeader();
-			updateLinks();
+			if ( isLinkGraphCurrent( count ) ) {
+				remapLinkGraph( map, count + 1 );
+				updateLinks( num );
+			} else {
+				updateLinks();
+			}
 			updateFooter();
 			emit linksChanged();
 		}
@@ -900,53 +929,366 @@ QModelIndex NifModel::insertNiBlock( const QString & identifier, int at )
 	return QModelIndex();
 }
 
-void NifModel::removeNiBlock( int blocknum )
+void NifModel::insertBlockTypes( NifItem * branch, const NifBlockPtr & block )
 {
-	if ( blocknum < 0 || blocknum >= getBlockCount() )
+	if ( !block->ancestor.isEmpty() )
+		insertAncestor( branch, block->ancestor );
+
+	branch->prepareInsert( block->types.count() );
+
+	for ( const NifData& data : block->types ) {
+		insertType( branch, data );
+	}
+}
+
+bool NifModel::materializeBlock( NifItem * block ) const
+{
+	if ( !lazyBlocks.contains( block ) )
+		return true;
+
+	// The bytes are read again from the source file, they are not kept around
+	QFile source( rawSource );
+	QByteArray data;
+	if ( isRawSourceUnchanged() && source.open( QIODevice::ReadOnly ) )
+		data = readRawBlock( source, block );
+
+	if ( data.size() != rawBlocks.value( block ).second ) {
+		logWarning( tr( "failed to read block number %1 (%2) from %3, it changed since it was opened" ).arg( getBlockNumber( block ) ).arg( block->name() ).arg( rawSource ) );
+		return false;
+	}
+
+	lazyBlocks.remove( block );
+
+	NifModel * self = const_cast<NifModel *>( this );
+	NifBlockPtr type = blocks.value( block->name() );
+	if ( !type )
+		return false;
+
+	// Views have only seen the block without rows so far, count them on a detached item to announce them
+	NifItem rows( block->data(), nullptr );
+	self->insertBlockTypes( &rows, type );
+
+	if ( rows.childCount() > 0 )
+		self->QAbstractItemModel::beginInsertRows( createIndex( block->row(), 0, block ), 0, rows.childCount() - 1 );
+
+	setState( Loading );
+	self->insertBlockTypes( block, type );
+
+	QBuffer buffer( &data );
+	buffer.open( QIODevice::ReadOnly );
+	NifIStream stream( self, &buffer );
+	bool ok = self->loadItem( block, stream );
+	restoreState();
+
+	if ( rows.childCount() > 0 )
+		self->QAbstractItemModel::endInsertRows();
+
+	if ( !ok )
+		logWarning( tr( "failed to load block number %1 (%2)" ).arg( getBlockNumber( block ) ).arg( block->name() ) );
+
+	return ok;
+}
+
+bool NifModel::holdsLinks( const QString & type )
+{
+	if ( NifValue::isLink( NifValue::type( type ) ) )
+		return true;
+
+	NifBlockPtr compound = compounds.value( type );
+	if ( !compound )
+		return false;
+
+	auto cached = linkTypes.constFind( type );
+	if ( cached != linkTypes.constEnd() )
+		return cached.value();
+
+	// Compounds that contain themselves hold links only through another field
+	linkTypes.insert( type, false );
+
+	bool links = false;
+	for ( const NifData & d : compound->types ) {
+		// A template that is passed on could be filled with a link
+		if ( holdsLinks( d.type() ) || d.temp() == XMLTMPL || ( !d.temp().isEmpty() && holdsLinks( d.temp() ) ) ) {
+			links = true;
+			break;
+		}
+	}
+
+	linkTypes.insert( type, links );
+	return links;
+}
+
+NifModel::LazyBlock NifModel::scanLazyBlock( NifItem * block, NifIStream & stream )
+{
+	LazyBlock lazy;
+
+	NifBlockPtr type = blocks.value( block->name() );
+	auto last = lazyLinkRows.constFind( block->name() );
+	if ( !type || ( last != lazyLinkRows.constEnd() && last.value() < 0 ) )
+		return lazy;
+
+	insertBlockTypes( block, type );
+
+	if ( last == lazyLinkRows.constEnd() ) {
+		int row = block->childCount() - 1;
+		while ( row >= 0 ) {
+			NifItem * child = block->child( row );
+			if ( holdsLinks( child->type() ) || ( !child->temp().isEmpty() && holdsLinks( child->temp() ) ) )
+				break;
+
+			row--;
+		}
+
+		last = lazyLinkRows.insert( block->name(), row );
+	}
+
+	// Nothing after the last link is read
+	int rows = last.value() + 1;
+	if ( rows > 0 )
+		block->removeChildren( rows, block->childCount() - rows );
+
+	if ( rows > 0 && loadItem( block, stream ) ) {
+		NifSStream sizes( this );
+		quint32 ofs = 0;
+		scanLinks( block, sizes, ofs, lazy.links );
+	}
+
+	block->removeChildren( 0, block->childCount() );
+	block->clearLinkRows();
+
+	return lazy;
+}
+
+void NifModel::scanLinks( NifItem * parent, NifSStream & stream, quint32 & ofs, QVector<LazyLink> & links ) const
+{
+	for ( auto child : parent->children() ) {
+		if ( child->isAbstract() || !evalCondition( child ) )
+			continue;
+
+		if ( isArray( child ) || !child->arr2().isEmpty() || child->childCount() > 0 ) {
+			scanLinks( child, stream, ofs, links );
+		} else {
+			const NifValue & value = child->value();
+			if ( value.isLink() )
+				links.append( { ofs, value.toLink(), value.toLink(), value.type() == NifValue::tUpLink } );
+
+			ofs += stream.size( value );
+		}
+	}
+}
+
+bool NifModel::lazyBlockHasField( const NifItem * block, const QString & name ) const
+{
+	auto fields = lazyFieldNames.constFind( block->name() );
+
+	if ( fields == lazyFieldNames.constEnd() ) {
+		QSet<QString> names;
+
+		NifBlockPtr type = blocks.value( block->name() );
+		if ( type ) {
+			NifItem rows( block->data(), nullptr );
+			const_cast<NifModel *>( this )->insertBlockTypes( &rows, type );
+
+			for ( auto child : rows.children() )
+				names.insert( child->name() );
+		}
+
+		fields = lazyFieldNames.insert( block->name(), names );
+	}
+
+	return fields.value().contains( name );
+}
+
+QByteArray NifModel::readRawBlock( QFile & source, const NifItem * block ) const
+{
+	auto raw = rawBlocks.value( block );
+
+	QByteArray data;
+	if ( source.seek( raw.first ) )
+		data = source.read( raw.second );
+
+	auto lazy = lazyBlocks.constFind( block );
+	if ( lazy == lazyBlocks.constEnd() || data.size() != raw.second )
+		return data;
+
+	for ( const auto & link : lazy->links ) {
+		if ( link.value != link.read && link.offset + sizeof( qint32 ) <= quint32( data.size() ) )
+			qToLittleEndian<qint32>( link.value, data.data() + link.offset );
+	}
+
+	return data;
+}
+
+bool NifModel::isRawSourceUnchanged() const
+{
+	if ( rawSource.isEmpty() )
+		return false;
+
+	QFileInfo info( rawSource );
+	return info.exists() && info.size() == rawSourceSize && info.lastModified() == rawSourceModified;
+}
+
+bool NifModel::isRawBlock( const NifItem * block ) const
+{
+	if ( !rawBlocks.contains( block ) )
+		return false;
+
+	// Unbuilt blocks have no other form
+	if ( lazyBlocks.contains( block ) )
+		return true;
+
+	return getUserVersion() == rawUserVersion && getUserVersion2() == rawUserVersion2;
+}
+
+void NifModel::versionChanging( NifItem * item )
+{
+	if ( lazyBlocks.isEmpty() )
 		return;
 
-	adjustLinks( root, blocknum, 0 );
-	adjustLinks( root, blocknum, -1 );
-	beginRemoveRows( QModelIndex(), blocknum + 1, blocknum + 1 );
-	root->removeChild( blocknum + 1 );
-	endRemoveRows();
+	// Unbuilt blocks have to be parsed with the versions they were written for
+	NifItem * parent = item->parent();
+	if ( parent == getHeaderItem() ) {
+		static const QStringList versions = { "Version", "User Version", "User Version 2" };
+		if ( versions.contains( item->name() ) )
+			materializeAll();
+	} else if ( parent && parent->parent() == getHeaderItem() && parent->name() == "BS Header" ) {
+		if ( item->name() == "BS Version" )
+			materializeAll();
+	}
+}
+
+void NifModel::itemModified( NifItem * item )
+{
+	if ( rawBlocks.isEmpty() || !item )
+		return;
+
+	while ( item->parent() && item->parent() != root )
+		item = item->parent();
+
+	rawBlocks.remove( item );
+}
+
+void NifModel::materializeAll()
+{
+	if ( lazyBlocks.isEmpty() )
+		return;
+
+	for ( int b = 0; b < getBlockCount(); b++ )
+		materializeBlock( getBlockItem( b ) );
+
 	updateLinks();
 	updateFooter();
 	emit linksChanged();
 }
 
-void NifModel::moveNiBlock( int src, int dst )
+void NifModel::removeNiBlock( int blocknum )
 {
-	if ( src < 0 || src >= getBlockCount() )
+	if ( blocknum < 0 || blocknum >= getBlockCount() )
 		return;
 
-	beginRemoveRows( QModelIndex(), src + 1, src + 1 );
-	NifItem * block = root->takeChild( src + 1 );
-	endRemoveRows();
+	removeNiBlocks( { blocknum } );
+}
 
-	if ( dst >= 0 )
-		dst++;
+void NifModel::removeNiBlocks( const QList<int> & blocknums )
+{
+	int count = getBlockCount();
+	QVector<bool> removed( count, false );
 
-	beginInsertRows( QModelIndex(), dst, dst );
-	dst = root->insertChild( block, dst ) - 1;
-	endInsertRows();
+	for ( const auto b : blocknums ) {
+		if ( b >= 0 && b < count )
+			removed[b] = true;
+	}
 
-	QMap<qint32, qint32> map;
+	// Links to removed blocks are cleared, every other block is renumbered once
+	QVector<qint32> map( count );
+	int first = count, next = 0;
+
+	for ( int b = 0; b < count; b++ ) {
+		if ( removed[b] ) {
+			map[b] = -1;
+			first = std::min( first, b );
+			rawBlocks.remove( getBlockItem( b ) );
+			lazyBlocks.remove( getBlockItem( b ) );
+		} else {
+			map[b] = next++;
+		}
+	}
+
+	if ( first == count )
+		return;
+
+	bool current = isLinkGraphCurrent( count );
+
+	remapBlockLinks( map, first );
+
+	// Remove contiguous runs of blocks, last to first
+	for ( int last = count - 1; last >= first; ) {
+		if ( !removed[last] ) {
+			last--;
+			continue;
+		}
+
+		int b = last;
+		while ( b > first && removed[b - 1] )
+			b--;
+
+		beginRemoveRows( QModelIndex(), b + 1, last + 1 );
+		root->removeChildren( b + 1, last - b + 1 );
+		endRemoveRows();
+
+		last = b - 1;
+	}
+
+	if ( current )
+		remapLinkGraph( map, next );
+	else
+		updateLinks();
+
+	updateFooter();
+	emit linksChanged();
+}
+
+void NifModel::moveNiBlock( int src, int dst )
+{
+	int count = getBlockCount();
+
+	if ( src < 0 || src >= count )
+		return;
+
+	if ( dst < 0 || dst >= count )
+		dst = count - 1;
+
+	QVector<qint32> map( count );
+	for ( int l = 0; l < count; l++ )
+		map[l] = l;
 
 	if ( src < dst ) {
 		for ( int l = src; l <= dst; l++ )
-			map.insert( l, l - 1 );
+			map[l] = l - 1;
 	} else {
 		for ( int l = dst; l <= src; l++ )
-			map.insert( l, l + 1 );
+			map[l] = l + 1;
 	}
 
+	map[src] = dst;
 
-	map.insert( src, dst );
+	bool current = isLinkGraphCurrent( count );
 
-	mapLinks( root, map );
+	remapBlockLinks( map, std::min( src, dst ) );
+
+	beginRemoveRows( QModelIndex(), src + 1, src + 1 );
+	NifItem * block = root->takeChild( src + 1 );
+	endRemoveRows();
+
+	beginInsertRows( QModelIndex(), dst + 1, dst + 1 );
+	root->insertChild( block, dst + 1 );
+	endInsertRows();
+
+	if ( current )
+		remapLinkGraph( map, count );
+	else
+		updateLinks();
 
-	updateLinks();
 	updateHeader();
 	updateFooter();
 	emit linksChanged();
@@ -971,6 +1313,12 @@ void NifModel::updateStrings( NifModel * src, NifModel * tgt, NifItem * item )
 
 QMap<qint32, qint32> NifModel::moveAllNiBlocks( NifModel * targetnif, bool update )
 {
+	materializeAll();
+	targetnif->materializeAll();
+
+	// The blocks leave with their items; the target writes them out from those
+	rawBlocks.clear();
+
 	int bcnt = getBlockCount();
 
 	bool doStringUpdate = (  this->getVersionNumber() >= 0x14010003 || targetnif->getVersionNumber() >= 0x14010003 );
@@ -1022,8 +1370,8 @@ void NifModel::reorderBlocks( const QVector<qint32> & order )
 		return;
 	}
 
-	QMap<qint32, qint32> linkMap;
 	QMap<qint32, qint32> blockMap;
+	int first = -1;
 
 	for ( qint32 n = 0; n < order.count(); n++ ) {
 		if ( blockMap.contains( order[n] ) || order[n] < 0 || order[n] >= getBlockCount() ) {
@@ -1033,13 +1381,17 @@ void NifModel::reorderBlocks( const QVector<qint32> & order )
 
 		blockMap.insert( order[n], n );
 
-		if ( order[n] != n )
-			linkMap.insert( n, order[n] );
+		if ( order[n] != n && first < 0 )
+			first = n;
 	}
 
-	if ( linkMap.isEmpty() )
+	if ( first < 0 )
 		return;
 
+	bool current = isLinkGraphCurrent( order.count() );
+
+	remapBlockLinks( order, first );
+
 	// take all the blocks
 	beginRemoveRows( QModelIndex(), 1, root->childCount() - 2 );
 	QList<NifItem *> temp;
@@ -1056,8 +1408,11 @@ void NifModel::reorderBlocks( const QVector<qint32> & order )
 	}
 	endInsertRows();
 
-	mapLinks( root, linkMap );
-	updateLinks();
+	if ( current )
+		remapLinkGraph( order, order.count() );
+	else
+		updateLinks();
+
 	emit linksChanged();
 
 	updateHeader();
@@ -1074,6 +1429,17 @@ void NifModel::mapLinks( const QMap<qint32, qint32> & map )
 	updateFooter();
 }
 
+void NifModel::mapLinks( const QModelIndex & iBlock, const QMap<qint32, qint32> & map )
+{
+	int b = getBlockNumber( iBlock );
+
+	if ( b < 0 )
+		return;
+
+	mapLinks( getBlockItem( b ), map );
+	updateLinks( b );
+}
+
 QString NifModel::getBlockName( const QModelIndex & idx ) const
 {
 	const NifItem * block = static_cast<NifItem *>( idx.internalPointer() );
@@ -1314,19 +1680,7 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 			tmp = tItem->temp();
 		}
 
-		NifData d( data );
-
-		if ( d.type() == XMLTMPL ) {
-			d.value.changeType( NifValue::type( tmp ) );
-			d.setType( tmp );
-			// The templates are now filled
-			d.setTemplated( false );
-		}
-
-		if ( d.temp() == XMLTMPL )
-			d.setTemp( tmp );
-
-		insertType( parent, d, at );
+		insertType( parent, templateData( data, tmp ), at );
 	} else {
 		NifItem * item = parent->insertChild( data, at );
 
@@ -1347,21 +1701,12 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 
 bool NifModel::setItemValue( NifItem * item, const NifValue & val )
 {
+	versionChanging( item );
 	item->value() = val;
-	emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+	itemChanged( item );
 
-	if ( itemIsLink( item ) ) {
-		NifItem * parent = item;
-
-		while ( parent->parent() && parent->parent() != root )
-			parent = parent->parent();
-
-		if ( parent != getFooterItem() ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
-	}
+	if ( itemIsLink( item ) )
+		linkChanged( item );
 
 	return true;
 }
@@ -1370,6 +1715,27 @@ bool NifModel::setItemValue( NifItem * item, const NifValue & val )
  *  QAbstractModel interface
  */
 
+bool NifModel::hasChildren( const QModelIndex & parent ) const
+{
+	// Unbuilt blocks stay unbuilt until they are expanded
+	if ( canFetchMore( parent ) )
+		return true;
+
+	return BaseModel::hasChildren( parent );
+}
+
+bool NifModel::canFetchMore( const QModelIndex & parent ) const
+{
+	return !lazyBlocks.isEmpty() && parent.isValid() && parent.model() == this
+		&& lazyBlocks.contains( static_cast<const NifItem *>( parent.internalPointer() ) );
+}
+
+void NifModel::fetchMore( const QModelIndex & parent )
+{
+	if ( canFetchMore( parent ) )
+		materializeBlock( static_cast<NifItem *>( parent.internalPointer() ) );
+}
+
 QVariant NifModel::data( const QModelIndex & idx, int role ) const
 {
 	QModelIndex index = buddy( idx );
@@ -1501,7 +1867,10 @@ QVariant NifModel::data( const QModelIndex & idx, int role ) const
 							if ( !block.isValid() )
 								return tr( "%1 <invalid>" ).arg( lnk );
 
-							QModelIndex block_name = getIndex( block, "Name" );
+							// Unbuilt blocks are only built when something needs their contents, not to paint a link
+							QModelIndex block_name;
+							if ( !lazyBlocks.contains( static_cast<const NifItem *>( block.internalPointer() ) ) )
+								block_name = getIndex( block, "Name" );
 
 							if ( block_name.isValid() && !get<QString>( block_name ).isEmpty() )
 								return QString( "%1 (%2)" ).arg( lnk ).arg( get<QString>( block_name ) );
@@ -1763,6 +2132,9 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 	if ( index != idx )
 		return setData( idx, value, role );
 
+	versionChanging( item );
+	itemModified( item );
+
 	switch ( index.column() ) {
 	case NifModel::NameCol:
 		item->setName( value.toString() );
@@ -1784,11 +2156,8 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 			} else {
 				item->value().setFromVariant( value );
 
-				if ( isLink( index ) && getBlockOrHeader( index ) != getFooter() ) {
-					updateLinks();
-					updateFooter();
-					emit linksChanged();
-				}
+				if ( isLink( index ) )
+					linkChanged( item );
 			}
 		}
 		break;
@@ -1870,11 +2239,8 @@ bool NifModel::removeRows( int row, int count, const QModelIndex & parent )
 		item->removeChildren( row, count );
 		endRemoveRows();
 
-		if ( link ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
+		if ( link )
+			linkChanged( item );
 
 		return true;
 	}
@@ -1892,10 +2258,8 @@ void NifModel::ShiftRow( const QModelIndex & arrIndex, int pos, int delta ) {
 	arrItem->insertChild( temp, pos+delta );
 	endInsertRows();
 
-	updateLinks();
 	updateHeader();
-	updateFooter();
-	emit linksChanged();
+	linkChanged( arrItem );
 }
 
 QModelIndex NifModel::buddy( const QModelIndex & index ) const
@@ -2002,6 +2366,16 @@ bool NifModel::load( QIODevice & device )
 
 	clear();
 
+	// Unchanged blocks are copied back from the file on save, remember which file that is
+	if ( auto file = qobject_cast<QFile *>( &device ) ) {
+		QFileInfo info( *file );
+		if ( info.isFile() ) {
+			rawSource = info.absoluteFilePath();
+			rawSourceSize = info.size();
+			rawSourceModified = info.lastModified();
+		}
+	}
+
 	NifIStream stream( this, &device );
 
 	if ( state != Loading )
@@ -2021,6 +2395,14 @@ bool NifModel::load( QIODevice & device )
 	numblocks = get<int>( header, "Num Blocks" );
 	//qDebug( "numblocks %i", numblocks );
 
+	rawUserVersion = getUserVersion();
+	rawUserVersion2 = getUserVersion2();
+
+	// Large files with a block size table only find the links of each block, its items are read from the file when it is first accessed
+	bool lazyLoad = settings.value( "Lazy Block Loading", true ).toBool()
+		&& device.size() >= settings.value( "Lazy Block Loading Size", 64 * 1024 * 1024 ).toLongLong()
+		&& version >= 0x14020000 && getItem( header, "Block Size" ) && !rawSource.isEmpty();
+
 	emit sigProgress( 0, numblocks );
 	//QTime t = QTime::currentTime();
 
@@ -2041,6 +2423,8 @@ bool NifModel::load( QIODevice & device )
 
 				QString blktyp;
 				quint32 size = UINT_MAX;
+				NifItem * rawItem = nullptr;
+				qint64 rawStart = 0;
 				try
 				{
 					if ( version >= 0x0a000000 ) {
@@ -2075,7 +2459,7 @@ bool NifModel::load( QIODevice & device )
 						}
 
 						// for version 20.2.0.? and above the block size is stored in the header
-						if ( !ignoreSize && version >= 0x14020000 )
+						if ( ( !ignoreSize || lazyLoad ) && version >= 0x14020000 )
 							size = get<quint32>( index( c, 0, getIndex( createIndex( header->row(), 0, header ), "Block Size" ) ) );
 					} else {
 						int len;
@@ -2093,14 +2477,28 @@ bool NifModel::load( QIODevice & device )
 					if ( blktyp.startsWith( "NiDataStream\x01" ) )
 						blktyp = extractRTTIArgs( blktyp, metadata );
 
-					if ( isNiBlock( blktyp ) ) {
+					if ( lazyLoad && size != UINT_MAX && isNiBlock( blktyp ) && blktyp != "NiDataStream" ) {
+						rawStart = device.pos();
+						if ( rawStart + size > device.size() )
+							throw tr( "unexpected EOF during load" );
+
+						NifItem * branch = insertBranch( root, NifData( blktyp, "NiBlock", blocks.value( blktyp )->text ), c + 1 );
+						branch->setCondition( true );
+						lazyBlocks.insert( branch, scanLazyBlock( branch, stream ) );
+						rawItem = branch;
+
+						if ( !device.seek( rawStart + size ) )
+							throw tr( "unexpected EOF during load" );
+					} else if ( isNiBlock( blktyp ) ) {
 						//qDebug() << "loading block" << c << ":" << blktyp );
 						QModelIndex newBlock = insertNiBlock( blktyp, -1 );
 
+						rawStart = device.pos();
 						if ( !loadItem( root->child( c + 1 ), stream ) ) {
 							NifItem * child = root->child( c );
 							throw tr( "failed to load block number %1 (%2) previous block was %3" ).arg( c ).arg( blktyp ).arg( child ? child->name() : prevblktyp );
 						}
+						rawItem = root->child( c + 1 );
 
 						// NiMesh hack
 						if ( blktyp == "NiDataStream" ) {
@@ -2147,6 +2545,9 @@ bool NifModel::load( QIODevice & device )
 					}
 				}
 
+				if ( rawItem )
+					rawBlocks.insert( rawItem, { rawStart, device.pos() - rawStart } );
+
 				prevblktyp = blktyp;
 			}
 
@@ -2232,6 +2633,22 @@ bool NifModel::save( QIODevice & device ) const
 {
 	NifOStream stream( this, &device );
 
+	// Unchanged and unbuilt blocks are copied from the file they were loaded from, unless it changed on disk since
+	QFile source( rawSource );
+	if ( !rawBlocks.isEmpty() && !( isRawSourceUnchanged() && source.open( QIODevice::ReadOnly ) ) ) {
+		if ( !lazyBlocks.isEmpty() ) {
+			Message::critical( nullptr, tr( "%1 changed since it was opened, the blocks that were not read yet cannot be written." ).arg( rawSource ) );
+			return false;
+		}
+
+		rawBlocks.clear();
+	}
+
+	// A save over the source file replaces it, the blocks are found at their new offsets from then on
+	auto target = qobject_cast<QFileDevice *>( &device );
+	bool rebase = target && !rawSource.isEmpty() && QFileInfo( target->fileName() ).absoluteFilePath() == rawSource;
+	savedBlocks.clear();
+
 	setState( Saving );
 
 	// Force update header and footer prior to save
@@ -2274,11 +2691,23 @@ bool NifModel::save( QIODevice & device ) const
 			}
 		}
 
-		if ( !saveItem( root->child( c ), stream ) ) {
+		NifItem * block = root->child( c );
+		qint64 start = device.pos();
+		QByteArray raw;
+		if ( isRawBlock( block ) )
+			raw = readRawBlock( source, block );
+
+		if ( isRawBlock( block ) && raw.size() == rawBlocks.value( block ).second ) {
+			device.write( raw );
+		} else if ( lazyBlocks.contains( block ) || !saveItem( block, stream ) ) {
 			Message::critical( nullptr, tr( "Failed to write block %1 (%2)." ).arg( itemName( index( c, 0 ) ) ).arg( c - 1 ) );
+			savedBlocks.clear();
 			resetState();
 			return false;
 		}
+
+		if ( rebase && itemType( index( c, 0 ) ) == "NiBlock" )
+			savedBlocks.insert( block, { start, device.pos() - start } );
 	}
 
 	if ( version < 0x0303000d ) {
@@ -2292,16 +2721,38 @@ bool NifModel::save( QIODevice & device ) const
 	return true;
 }
 
+void NifModel::fileSaved( const QString & file ) const
+{
+	if ( savedBlocks.isEmpty() || QFileInfo( file ).absoluteFilePath() != rawSource ) {
+		savedBlocks.clear();
+		return;
+	}
+
+	// Every block now is unchanged against the file that was just written
+	QFileInfo info( rawSource );
+	rawSourceSize = info.size();
+	rawSourceModified = info.lastModified();
+	rawUserVersion = getUserVersion();
+	rawUserVersion2 = getUserVersion2();
+	rawBlocks = savedBlocks;
+	savedBlocks.clear();
+
+	for ( auto & lazy : lazyBlocks ) {
+		for ( auto & link : lazy.links )
+			link.read = link.value;
+	}
+}
+
 bool NifModel::loadIndex( QIODevice & device, const QModelIndex & index )
 {
 	NifItem * item = static_cast<NifItem *>( index.internalPointer() );
 
 	if ( item && index.isValid() && index.model() == this ) {
+		materializeBlock( item );
+		itemModified( item );
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
-		updateLinks();
-		updateFooter();
-		emit linksChanged();
+		linkChanged( item );
 		return ok;
 	}
 
@@ -2314,12 +2765,12 @@ bool NifModel::loadAndMapLinks( QIODevice & device, const QModelIndex & index, c
 	NifItem * item = static_cast<NifItem *>( index.internalPointer() );
 
 	if ( item && index.isValid() && index.model() == this ) {
+		materializeBlock( item );
+		itemModified( item );
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
 		mapLinks( item, map );
-		updateLinks();
-		updateFooter();
-		emit linksChanged();
+		linkChanged( item );
 		return ok;
 	}
 
@@ -2389,7 +2840,11 @@ bool NifModel::saveIndex( QIODevice & device, const QModelIndex & index ) const
 {
 	NifOStream stream( this, &device );
 	NifItem * item = static_cast<NifItem *>( index.internalPointer() );
-	return ( item && index.isValid() && index.model() == this && saveItem( item, stream ) );
+	if ( !( item && index.isValid() && index.model() == this ) )
+		return false;
+
+	materializeBlock( item );
+	return saveItem( item, stream );
 }
 
 int NifModel::fileOffset( const QModelIndex & index ) const
@@ -2450,6 +2905,9 @@ int NifModel::blockSize( NifItem * parent, NifSStream & stream ) const
 	if ( !parent )
 		return 0;
 
+	if ( isRawBlock( parent ) )
+		return int( rawBlocks.value( parent ).second );
+
 	for ( int row = 0; row < parent->childCount(); row++ ) {
 		NifItem * child = parent->child( row );
 
@@ -2586,6 +3044,17 @@ bool NifModel::fileOffset( NifItem * parent, NifItem * target, NifSStream & stre
 	if ( parent == target )
 		return true;
 
+	if ( isRawBlock( parent ) ) {
+		NifItem * item = target;
+		while ( item && item != parent )
+			item = item->parent();
+
+		if ( !item ) {
+			ofs += int( rawBlocks.value( parent ).second );
+			return false;
+		}
+	}
+
 	for ( auto child : parent->children() ) {
 		if ( child == target )
 			return true;
@@ -2603,6 +3072,29 @@ bool NifModel::fileOffset( NifItem * parent, NifItem * target, NifSStream & stre
 	return false;
 }
 
+NifData NifModel::templateData( const NifData & data, const QString & tmp )
+{
+	auto key = qMakePair( data.key(), tmp );
+	auto it = templatedData.constFind( key );
+	if ( it != templatedData.constEnd() )
+		return it->second;
+
+	NifData d( data );
+
+	if ( d.type() == XMLTMPL ) {
+		d.value.changeType( NifValue::type( tmp ) );
+		d.setType( tmp );
+		// The templates are now filled
+		d.setTemplated( false );
+	}
+
+	if ( d.temp() == XMLTMPL )
+		d.setTemp( tmp );
+
+	templatedData.insert( key, { data, d } );
+	return d;
+}
+
 NifItem * NifModel::insertBranch( NifItem * parentItem, const NifData & data, int at )
 {
 	NifItem * item = parentItem->insertChild( data, at );
@@ -2719,53 +3211,96 @@ void NifModel::invalidateDependentConditions( const QModelIndex & index )
 
 void NifModel::updateLinks( int block )
 {
-	if ( lockUpdates ) {
-		needUpdates = UpdateType( needUpdates | utLinks );
-		return;
-	}
-
 	if ( block >= 0 ) {
-		childLinks[ block ].clear();
-		parentLinks[ block ].clear();
-		updateLinks( block, getBlockItem( block ) );
-	} else {
-		rootLinks.clear();
-		childLinks.clear();
-		parentLinks.clear();
+		// Rescan a single block and patch the graph around it
+		if ( block >= getBlockCount() )
+			return;
+
+		if ( childLinks.count() != getBlockCount() ) {
+			updateLinks();
+			return;
+		}
 
-		// Run updateLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ )
-			updateLinks( c );
+		QList<int> children, parents;
+		int maxLink = -1;
+		updateLinks( block, getBlockItem( block ), children, parents, maxLink );
 
-		// Run checkLinks() for each block
-		for ( int c = 0; c < getBlockCount(); c++ ) {
-			QStack<int> stack;
-			checkLinks( c, stack );
+		for ( const auto c : childLinks[block] ) {
+			if ( !children.contains( c ) && c >= 0 && c < referrers.count() )
+				referrers[c].removeOne( block );
 		}
 
+		QList<int> old = childLinks[block];
+		childLinks[block].clear();
 
-		int n = getBlockCount();
-		QByteArray hasrefs( n, 0 );
+		for ( const auto c : children ) {
+			if ( !old.contains( c ) && c < getBlockCount() ) {
+				if ( reachesBlock( c, block ) ) {
+					logWarning( tr( "Infinite recursive link detected (%1 -> %2 -> %1)" ).arg( block ).arg( c ) );
+					continue;
+				}
 
-		for ( int c = 0; c < n; c++ ) {
-			for ( const auto d : childLinks.value( c ) ) {
-				if ( d >= 0 && d < n )
-					hasrefs[d] = 1;
+				QList<int> & refs = referrers[c];
+				refs.insert( std::lower_bound( refs.begin(), refs.end(), block ), block );
 			}
+
+			childLinks[block].append( c );
 		}
 
-		for ( int c = 0; c < n; c++ ) {
-			if ( !hasrefs[c] )
-				rootLinks.append( c );
+		parentLinks[block] = parents;
+		maxLinks[block] = maxLink;
+
+		updateRootLinks();
+		return;
+	}
+
+	if ( lockUpdates ) {
+		needUpdates = UpdateType( needUpdates | utLinks );
+		return;
+	}
+
+	int n = getBlockCount();
+
+	childLinks = QVector<QList<int>>( n );
+	parentLinks = QVector<QList<int>>( n );
+	maxLinks = QVector<int>( n, -1 );
+
+	for ( int c = 0; c < n; c++ )
+		updateLinks( c, getBlockItem( c ), childLinks[c], parentLinks[c], maxLinks[c] );
+
+	checkLinks();
+
+	referrers = QVector<QList<int>>( n );
+	for ( int c = 0; c < n; c++ ) {
+		for ( const auto d : childLinks[c] ) {
+			if ( d >= 0 && d < n )
+				referrers[d].append( c );
 		}
 	}
+
+	updateRootLinks();
 }
 
-void NifModel::updateLinks( int block, NifItem * parent )
+void NifModel::updateLinks( int block, NifItem * parent, QList<int> & children, QList<int> & parents, int & maxLink )
 {
 	if ( !parent )
 		return;
 
+	auto lazy = lazyBlocks.constFind( parent );
+	if ( lazy != lazyBlocks.constEnd() ) {
+		for ( const auto & link : lazy->links ) {
+			if ( link.value < 0 )
+				continue;
+
+			maxLink = std::max( maxLink, int( link.value ) );
+
+			QList<int> & links = link.up ? parents : children;
+			if ( !links.contains( link.value ) )
+				links.append( link.value );
+		}
+		return;
+	}
+
 	auto links = parent->getLinkRows();
 	for ( int l : links ) {
 		NifItem * c = parent->child( l );
@@ -2773,18 +3308,20 @@ void NifModel::updateLinks( int block, NifItem * parent )
 			continue;
 	
 		if ( c->childCount() > 0 ) {
-			updateLinks( block, c );
+			updateLinks( block, c, children, parents, maxLink );
 			continue;
 		}
 	
 		int i = c->value().toLink();
 		if ( i >= 0 ) {
+			maxLink = std::max( maxLink, i );
+
 			if ( c->value().type() == NifValue::tUpLink ) {
-				if ( !parentLinks[block].contains( i ) )
-					parentLinks[block].append( i );
+				if ( !parents.contains( i ) )
+					parents.append( i );
 			} else {
-				if ( !childLinks[block].contains( i ) )
-					childLinks[block].append( i );
+				if ( !children.contains( i ) )
+					children.append( i );
 			}
 		}
 	}
@@ -2793,61 +3330,212 @@ void NifModel::updateLinks( int block, NifItem * parent )
 	for ( int p : linkparents ) {
 		NifItem * c = parent->child( p );
 		if ( c && c->childCount() > 0 )
-			updateLinks( block, c );
+			updateLinks( block, c, children, parents, maxLink );
 	}
 }
 
-void NifModel::checkLinks( int block, QStack<int> & parents )
+void NifModel::checkLinks()
 {
-	parents.push( block );
-	foreach ( const auto child, childLinks.value( block ) ) {
-		if ( parents.contains( child ) ) {
-			logWarning(tr("Infinite recursive link detected (%1 -> %2 -> %1)").arg(block).arg(child));
+	// One depth-first pass over the whole graph, dropping every link back to a block still on the stack
+	enum { White, Grey, Black };
 
-			childLinks[block].removeAll( child );
-		} else {
-			checkLinks( child, parents );
+	int n = childLinks.count();
+	QVector<char> color( n, White );
+	QStack<QPair<int, int>> stack;
+
+	for ( int root = 0; root < n; root++ ) {
+		if ( color[root] != White )
+			continue;
+
+		color[root] = Grey;
+		stack.push( { root, 0 } );
+
+		while ( !stack.isEmpty() ) {
+			int block = stack.top().first;
+			int & next = stack.top().second;
+			QList<int> & children = childLinks[block];
+
+			if ( next >= children.count() ) {
+				color[block] = Black;
+				stack.pop();
+				continue;
+			}
+
+			int child = children.at( next );
+			if ( child < 0 || child >= n ) {
+				next++;
+			} else if ( color[child] == Grey ) {
+				logWarning( tr( "Infinite recursive link detected (%1 -> %2 -> %1)" ).arg( block ).arg( child ) );
+				children.removeAt( next );
+			} else {
+				next++;
+				if ( color[child] == White ) {
+					color[child] = Grey;
+					stack.push( { child, 0 } );
+				}
+			}
 		}
 	}
-	parents.pop();
 }
 
-void NifModel::adjustLinks( NifItem * parent, int block, int delta )
+bool NifModel::reachesBlock( int from, int to ) const
+{
+	if ( from == to )
+		return true;
+
+	QVector<bool> visited( childLinks.count(), false );
+	QStack<int> stack;
+	stack.push( from );
+
+	while ( !stack.isEmpty() ) {
+		int block = stack.pop();
+		if ( block < 0 || block >= childLinks.count() || visited[block] )
+			continue;
+
+		visited[block] = true;
+
+		for ( const auto c : childLinks[block] ) {
+			if ( c == to )
+				return true;
+
+			stack.push( c );
+		}
+	}
+
+	return false;
+}
+
+void NifModel::updateRootLinks()
+{
+	rootLinks.clear();
+
+	for ( int c = 0; c < referrers.count(); c++ ) {
+		if ( referrers[c].isEmpty() )
+			rootLinks.append( c );
+	}
+}
+
+void NifModel::mapLinks( NifItem * parent, const QMap<qint32, qint32> & map )
 {
 	if ( !parent )
 		return;
 
+	auto lazy = lazyBlocks.find( parent );
+	if ( lazy != lazyBlocks.end() ) {
+		// Unbuilt blocks are renumbered in place and patched when they are read
+		for ( auto & link : lazy->links ) {
+			if ( link.value >= 0 && map.contains( link.value ) )
+				link.value = map[link.value];
+		}
+		return;
+	}
+
 	if ( parent->childCount() > 0 ) {
 		for ( auto child : parent->children() )
-			adjustLinks( child, block, delta );
+			mapLinks( child, map );
 	} else {
 		int l = parent->value().toLink();
 
-		if ( l >= 0 && ( ( delta != 0 && l >= block ) || l == block ) ) {
-			if ( delta == 0 )
-				parent->value().setLink( -1 );
-			else
-				parent->value().setLink( l + delta );
+		if ( l >= 0 ) {
+			if ( map.contains( l ) ) {
+				itemModified( parent );
+				parent->value().setLink( map[ l ] );
+			}
 		}
 	}
 }
 
-void NifModel::mapLinks( NifItem * parent, const QMap<qint32, qint32> & map )
+void NifModel::mapLinks( NifItem * parent, const QVector<qint32> & map )
 {
 	if ( !parent )
 		return;
 
+	auto lazy = lazyBlocks.find( parent );
+	if ( lazy != lazyBlocks.end() ) {
+		for ( auto & link : lazy->links ) {
+			if ( link.value >= 0 && link.value < map.count() )
+				link.value = map[link.value];
+		}
+		return;
+	}
+
 	if ( parent->childCount() > 0 ) {
 		for ( auto child : parent->children() )
 			mapLinks( child, map );
 	} else {
 		int l = parent->value().toLink();
 
-		if ( l >= 0 ) {
-			if ( map.contains( l ) )
-				parent->value().setLink( map[ l ] );
+		if ( l >= 0 && l < map.count() && map[l] != l ) {
+			itemModified( parent );
+			parent->value().setLink( map[l] );
+		}
+	}
+}
+
+void NifModel::remapLinkGraph( const QVector<qint32> & map, int count )
+{
+	auto remap = [&map]( const QList<int> & links ) {
+		QList<int> mapped;
+		mapped.reserve( links.count() );
+		for ( const auto l : links ) {
+			int m = ( l >= 0 && l < map.count() ) ? map[l] : l;
+			if ( m >= 0 )
+				mapped.append( m );
+		}
+		return mapped;
+	};
+
+	// The highest new number among the first i blocks bounds the remapped links
+	QVector<int> prefixMax( map.count() );
+	int highest = -1;
+	for ( int b = 0; b < map.count(); b++ )
+		prefixMax[b] = highest = std::max( highest, int( map[b] ) );
+
+	QVector<QList<int>> children( count ), parents( count );
+	QVector<int> maxes( count, -1 );
+
+	for ( int b = 0; b < map.count() && b < childLinks.count(); b++ ) {
+		int m = map[b];
+		if ( m < 0 || m >= count )
+			continue;
+
+		children[m] = remap( childLinks[b] );
+		parents[m] = remap( parentLinks[b] );
+
+		// Links past the end are left as they were
+		int x = maxLinks.value( b, -1 );
+		maxes[m] = ( x >= 0 && x < map.count() ) ? prefixMax[x] : x;
+	}
+
+	childLinks = children;
+	parentLinks = parents;
+	maxLinks = maxes;
+
+	referrers = QVector<QList<int>>( count );
+	for ( int c = 0; c < count; c++ ) {
+		for ( const auto d : childLinks[c] ) {
+			if ( d >= 0 && d < count )
+				referrers[d].append( c );
 		}
 	}
+
+	updateRootLinks();
+}
+
+bool NifModel::isLinkGraphCurrent( int count ) const
+{
+	return state != Loading && !( needUpdates & utLinks ) && maxLinks.count() == count && childLinks.count() == count;
+}
+
+void NifModel::remapBlockLinks( const QVector<qint32> & map, int first )
+{
+	// Without a current graph every block has to be visited
+	bool current = isLinkGraphCurrent( map.count() );
+
+	for ( int b = 0; b < map.count() && b < getBlockCount(); b++ ) {
+		if ( !current || maxLinks[b] >= first )
+			mapLinks( getBlockItem( b ), map );
+	}
 }
 
 qint32 NifModel::getLink( const QModelIndex & index ) const
@@ -2899,6 +3587,32 @@ QVector<qint32> NifModel::getLinkArray( const QModelIndex & parent, const QStrin
 	return getLinkArray( getIndex( parent, name ) );
 }
 
+void NifModel::linkChanged( NifItem * item )
+{
+	NifItem * parent = item;
+
+	while ( parent->parent() && parent->parent() != root )
+		parent = parent->parent();
+
+	if ( parent == getFooterItem() )
+		return;
+
+	// Only the block that changed is rescanned; anything else waits for a full rebuild
+	int block = getBlockNumber( parent );
+	if ( block >= 0 && isLinkGraphCurrent( getBlockCount() ) )
+		updateLinks( block );
+	else
+		updateLinks();
+
+	if ( lockUpdates ) {
+		needUpdates = UpdateType( needUpdates | utFooter | utLinkSignal );
+		return;
+	}
+
+	updateFooter();
+	emit linksChanged();
+}
+
 bool NifModel::setLink( const QModelIndex & parent, const QString & name, qint32 l )
 {
 	NifItem * parentItem = static_cast<NifItem *>( parent.internalPointer() );
@@ -2909,17 +3623,8 @@ bool NifModel::setLink( const QModelIndex & parent, const QString & name, qint32
 	NifItem * item = getItem( parentItem, name );
 
 	if ( item && item->value().setLink( l ) ) {
-		emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
-		NifItem * parent = item;
-
-		while ( parent->parent() && parent->parent() != root )
-			parent = parent->parent();
-
-		if ( parent != getFooterItem() ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
+		itemChanged( item );
+		linkChanged( item );
 
 		return true;
 	}
@@ -2935,17 +3640,8 @@ bool NifModel::setLink( const QModelIndex & index, qint32 l )
 		return false;
 
 	if ( item && item->value().setLink( l ) ) {
-		emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
-		NifItem * parent = item;
-
-		while ( parent->parent() && parent->parent() != root )
-			parent = parent->parent();
-
-		if ( parent != getFooterItem() ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
+		itemChanged( item );
+		linkChanged( item );
 
 		return true;
 	}
@@ -2968,18 +3664,9 @@ bool NifModel::setLinkArray( const QModelIndex & iArray, const QVector<qint32> &
 		int x = item->childCount() - 1;
 
 		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
-
-		NifItem * parent = item;
-
-		while ( parent->parent() && parent->parent() != root )
-			parent = parent->parent();
+			itemChanged( item->child( 0 ), item->child( x ) );
 
-		if ( parent != getFooterItem() ) {
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
-		}
+		linkChanged( item );
 
 		return ret;
 	}
@@ -3004,16 +3691,8 @@ bool NifModel::isLink( const QModelIndex & index, bool * isChildLink ) const
 
 int NifModel::getParent( int block ) const
 {
-	int parent = -1;
-
-	for ( int b = 0; b < getBlockCount(); b++ ) {
-		if ( childLinks.value( b ).contains( block ) ) {
-			parent = b;
-			break;
-		}
-	}
-
-	return parent;
+	// Referrers are kept sorted, the first one is the lowest numbered parent
+	return referrers.value( block ).value( 0, -1 );
 }
 
 int NifModel::getParent( const QModelIndex & index ) const
@@ -3182,6 +3861,7 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 	NifBlockPtr dstBlock = blocks.value( identifier );
 
 	if ( srcBlock && dstBlock && branch ) {
+		itemModified( branch );
 		branch->setName( identifier );
 
 		if ( inherits( btype, identifier ) ) {
@@ -3236,9 +3916,7 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 
 		if ( state != Loading ) {
 			updateHeader();
-			updateLinks();
-			updateFooter();
-			emit linksChanged();
+			linkChanged( branch );
 		}
 	}
 }
@@ -3260,6 +3938,53 @@ bool NifModel::holdUpdates( bool value )
 	return retval;
 }
 
+void NifModel::beginTransaction()
+{
+	if ( transactions++ > 0 )
+		return;
+
+	transactionHold = holdUpdates( true );
+	trackChanges = true;
+	setState( Processing );
+}
+
+void NifModel::commitTransaction()
+{
+	if ( transactions <= 0 || --transactions > 0 )
+		return;
+
+	restoreState();
+	trackChanges = false;
+	holdUpdates( transactionHold );
+
+	// Still inside an outer batch, leave the result for it to collect
+	if ( state == Processing ) {
+		changedRows.clear();
+		return;
+	}
+
+	changedWhileProcessing = false;
+
+	// Signal the children of each changed block so that nested rows get re-evaluated as well
+	QList<int> rows = changedRows.values();
+	changedRows.clear();
+	std::sort( rows.begin(), rows.end() );
+
+	for ( int r : rows ) {
+		NifItem * item = root->child( r );
+		if ( !item )
+			continue;
+
+		QModelIndex index = createIndex( r, 0, item );
+		emit dataChanged( index, index.sibling( r, ValueCol ) );
+
+		if ( item->childCount() > 0 ) {
+			int last = item->childCount() - 1;
+			emit dataChanged( createIndex( 0, 0, item->child( 0 ) ), createIndex( last, ValueCol, item->child( last ) ) );
+		}
+	}
+}
+
 void NifModel::updateModel( UpdateType value )
 {
 	if ( value & utHeader )
@@ -3271,7 +3996,7 @@ void NifModel::updateModel( UpdateType value )
 	if ( value & utFooter )
 		updateFooter();
 
-	if ( value & utLinks )
+	if ( value & ( utLinks | utLinkSignal ) )
 		emit linksChanged();
 }
 
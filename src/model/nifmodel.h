@@ -35,6 +35,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "basemodel.h" // Inherited
 
+#include <QDateTime>
 #include <QHash>
 #include <QReadWriteLock>
 #include <QStack>
@@ -43,6 +44,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <memory>
 
 class SpellBook;
+class QFile;
 class QUndoStack;
 
 using NifBlockPtr = std::shared_ptr<NifBlock>;
@@ -79,6 +81,9 @@ public:
 
 	// QAbstractItemModel
 
+	bool hasChildren( const QModelIndex & parent = QModelIndex() ) const override final;
+	bool canFetchMore( const QModelIndex & parent ) const override final;
+	void fetchMore( const QModelIndex & parent ) override final;
 	QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const override final;
 	bool setData( const QModelIndex & index, const QVariant & value, int role = Qt::EditRole ) override final;
 	bool removeRows( int row, int count, const QModelIndex & parent ) override final;
@@ -172,10 +177,23 @@ public:
 	//! Set delayed updating of model links
 	bool holdUpdates( bool value );
 
+	/*! Begin a batch of changes
+	 *
+	 * Until the matching commitTransaction(), per-item dataChanged signals are suppressed
+	 * and header, link and footer updates are deferred. Transactions may be nested.
+	 */
+	void beginTransaction();
+	//! End a batch of changes, apply the deferred updates and emit a single dataChanged for the changed blocks
+	void commitTransaction();
+
 	//! Insert or append ( row == -1 ) a new NiBlock
 	QModelIndex insertNiBlock( const QString & identifier, int row = -1 );
 	//! Remove a block from the list
 	void removeNiBlock( int blocknum );
+	//! Remove several blocks at once, renumbering the links in a single pass
+	void removeNiBlocks( const QList<int> & blocknums );
+	//! Build the items of every block that a lazy load left unread
+	void materializeAll();
 	//! Move a block in the list
 	void moveNiBlock( int src, int dst );
 	//! Return the block name
@@ -235,6 +253,8 @@ public:
 	QList<int> getRootLinks() const;
 	QList<int> getChildLinks( int block ) const;
 	QList<int> getParentLinks( int block ) const;
+	//! Blocks with a child link to the block, sorted by block number
+	QList<int> getReferrers( int block ) const;
 
 	/*! Get parent
 	 * @return	Parent block number or -1 if there are zero or multiple parents.
@@ -265,6 +285,8 @@ public:
 	bool setLinkArray( const QModelIndex & parent, const QString & name, const QVector<qint32> & links );
 
 	void mapLinks( const QMap<qint32, qint32> & map );
+	//! Map the links of a single block and update its link lists
+	void mapLinks( const QModelIndex & iBlock, const QMap<qint32, qint32> & map );
 
 	//! Is name a compound type?
 	static bool isCompound( const QString & name );
@@ -352,15 +374,34 @@ protected:
 	void insertAncestor( NifItem * parent, const QString & identifier, int row = -1 );
 	void insertType( NifItem * parent, const NifData & data, int row = -1 );
 	NifItem * insertBranch( NifItem * parent, const NifData & data, int row = -1 );
-
+	void insertBlockTypes( NifItem * branch, const NifBlockPtr & block );
+	//! Build the items of a block that was loaded lazily; does nothing for any other item
+	bool materializeBlock( NifItem * block ) const;
+	//! Data shared by every element of an array
+	NifData arrayElementData( NifItem * array );
+	//! Data of a templated field with its template filled in as \a tmp
+	NifData templateData( const NifData & data, const QString & tmp );
+
+	//! Insert or remove elements so that the array has \a rows of them
+	bool resizeArrayItem( NifItem * array, int rows );
 	bool updateByteArrayItem( NifItem * array );
 	bool updateArrays( NifItem * parent );
 
 	void updateLinks( int block = -1 );
-	void updateLinks( int block, NifItem * parent );
-	void checkLinks( int block, QStack<int> & parents );
-	void adjustLinks( NifItem * parent, int block, int delta );
+	void updateLinks( int block, NifItem * parent, QList<int> & children, QList<int> & parents, int & maxLink );
+	void checkLinks();
+	//! Whether adding the child link \a from -> \a to would close a cycle
+	bool reachesBlock( int from, int to ) const;
+	bool isLinkGraphCurrent( int count ) const;
+	void updateRootLinks();
 	void mapLinks( NifItem * parent, const QMap<qint32, qint32> & map );
+	void mapLinks( NifItem * parent, const QVector<qint32> & map );
+	//! Renumber the blocks of the link graph; \a map holds the new number of each block, or -1 if removed
+	void remapLinkGraph( const QVector<qint32> & map, int count );
+	//! Rewrite the link values of every block that may refer to a block renumbered by \a map
+	void remapBlockLinks( const QVector<qint32> & map, int first );
+	//! Update links and footer after a link value in item changed
+	void linkChanged( NifItem * item );
 
 	static void updateStrings( NifModel * src, NifModel * tgt, NifItem * item );
 	bool assignString( NifItem * parent, const QString & string, bool replace = false );
@@ -368,10 +409,70 @@ protected:
 	//! NIF file version
 	quint32 version;
 
-	QHash<int, QList<int> > childLinks;
-	QHash<int, QList<int> > parentLinks;
+	//! Link graph, indexed by block number
+	QVector<QList<int>> childLinks;
+	QVector<QList<int>> parentLinks;
+	//! Blocks with a child link to each block, in ascending order
+	QVector<QList<int>> referrers;
+	//! Highest link value found in each block, including links dropped as cycles
+	QVector<int> maxLinks;
 	QList<int> rootLinks;
 
+	//! The file the blocks were loaded from, with its size and modification time at that point
+	QString rawSource;
+	mutable qint64 rawSourceSize = 0;
+	mutable QDateTime rawSourceModified;
+	//! Offset and size in rawSource of every block unchanged since loading
+	mutable QHash<const NifItem *, QPair<qint64, qint64>> rawBlocks;
+	//! Offset and size of every block written by a save over rawSource, until it is committed
+	mutable QHash<const NifItem *, QPair<qint64, qint64>> savedBlocks;
+	//! A link in the bytes of a block that has not been built yet
+	struct LazyLink
+	{
+		//! Offset of the link in the block
+		quint32 offset;
+		//! Value in rawSource and current value, which differ once the blocks are renumbered
+		qint32 read, value;
+		bool up;
+	};
+	//! Links of a block that has not been built yet
+	struct LazyBlock
+	{
+		QVector<LazyLink> links;
+	};
+	//! Blocks whose items have not been built yet
+	mutable QHash<const NifItem *, LazyBlock> lazyBlocks;
+	//! Last top level row of each block type that can hold a link, or -1 if it has none
+	QHash<QString, int> lazyLinkRows;
+	//! Names of the top level fields of each block type
+	mutable QHash<QString, QSet<QString>> lazyFieldNames;
+	//! Whether a value of \a type, or any field of it, can be a link
+	QHash<QString, bool> linkTypes;
+	bool holdsLinks( const QString & type );
+	//! Find the links of a block that is loaded lazily, reading only up to its last link; its items are dropped again afterwards
+	LazyBlock scanLazyBlock( NifItem * block, NifIStream & stream );
+	void scanLinks( NifItem * parent, NifSStream & stream, quint32 & ofs, QVector<LazyLink> & links ) const;
+	//! Whether an unbuilt block has a top level field \a name
+	bool lazyBlockHasField( const NifItem * block, const QString & name ) const;
+	//! Read the bytes of a raw block from \a source, with the links of an unbuilt block renumbered since loading
+	QByteArray readRawBlock( QFile & source, const NifItem * block ) const;
+	//! Whether rawSource still is the file the raw blocks were read from
+	bool isRawSourceUnchanged() const;
+	//! User versions the raw blocks were written with
+	mutable quint32 rawUserVersion = 0;
+	mutable quint32 rawUserVersion2 = 0;
+
+	//! Whether a block can be written back from its raw bytes
+	bool isRawBlock( const NifItem * block ) const;
+	//! Build the remaining blocks before a header version they were written for changes
+	void versionChanging( NifItem * item );
+	void itemModified( NifItem * item ) override final;
+	void fileSaved( const QString & file ) const override final;
+
+	//! Derived data, keyed by the shared definition it came from; the definition is kept alongside so the key stays unique
+	QHash<const void *, QPair<NifData, NifData>> elementData;
+	QHash<QPair<const void *, QString>, QPair<NifData, NifData>> templatedData;
+
 	bool lockUpdates;
 
 	enum UpdateType
@@ -380,10 +481,16 @@ protected:
 		utHeader = 0x1,
 		utLinks  = 0x2,
 		utFooter = 0x4,
-		utAll = 0x7
+		utAll = 0x7,
+		utLinkSignal = 0x8
 	};
 	UpdateType needUpdates;
 
+	//! Nesting depth of beginTransaction()
+	int transactions = 0;
+	//! Value of holdUpdates() before the outermost transaction
+	bool transactionHold = false;
+
 	void updateModel( UpdateType value = utAll );
 
 	//! Parse the XML file using a NifXmlHandler
@@ -479,6 +586,11 @@ inline QList<int> NifModel::getParentLinks( int block ) const
 	return parentLinks.value( block );
 }
 
+inline QList<int> NifModel::getReferrers( int block ) const
+{
+	return referrers.value( block );
+}
+
 inline bool NifModel::itemIsLink( NifItem * item, bool * isChildLink ) const
 {
 	if ( isChildLink )
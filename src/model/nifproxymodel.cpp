@@ -44,14 +44,21 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class NifProxyItem
 {
 public:
-	NifProxyItem( int number, NifProxyItem * parent )
+	NifProxyItem( int number, NifProxyItem * parent, QMultiHash<int, NifProxyItem *> * items = nullptr )
 	{
 		blockNumber = number;
 		parentItem  = parent;
+		blockItems  = parent ? parent->blockItems : items;
+
+		if ( blockItems && blockNumber >= 0 )
+			blockItems->insert( blockNumber, this );
 	}
 	~NifProxyItem()
 	{
 		qDeleteAll( childItems );
+
+		if ( blockItems && blockNumber >= 0 )
+			blockItems->remove( blockNumber, this );
 	}
 
 	NifProxyItem * getLink( int link )
@@ -154,52 +161,16 @@ public:
 		return blocks;
 	}
 
-	NifProxyItem * findItem( int b, bool scanParents = true )
-	{
-		if ( blockNumber == b )
-			return this;
-
-		for ( NifProxyItem * child : childItems ) {
-			if ( child->blockNumber == b )
-				return child;
-		}
-
-		for ( NifProxyItem * child : childItems ) {
-			if ( NifProxyItem * x = child->findItem( b, false ) )
-				return x;
-		}
-
-		if ( parentItem && scanParents ) {
-			NifProxyItem * root = parentItem;
-
-			while ( root && root->parentItem )
-				root = root->parentItem;
-
-			if ( NifProxyItem * x = root->findItem( b, false ) )
-				return x;
-		}
-
-		return nullptr;
-	}
-
-	void findAllItems( int b, QList<NifProxyItem *> & list )
-	{
-		for ( NifProxyItem * item : childItems ) {
-			item->findAllItems( b, list );
-		}
-
-		if ( blockNumber == b )
-			list.append( this );
-	}
-
 	int blockNumber;
 	NifProxyItem * parentItem;
 	QList<NifProxyItem *> childItems;
+	//! The model's index of items by block number
+	QMultiHash<int, NifProxyItem *> * blockItems;
 };
 
 NifProxyModel::NifProxyModel( QObject * parent ) : QAbstractItemModel( parent )
 {
-	root = new NifProxyItem( -1, 0 );
+	root = new NifProxyItem( -1, 0, &blockItems );
 	nif = nullptr;
 }
 
@@ -244,10 +215,55 @@ void NifProxyModel::reset()
 	//qDebug() << "proxy reset";
 	root->killChildren();
 	updateRoot( true );
+	saveLinks();
 	endResetModel();
 }
 
-void NifProxyModel::updateRoot( bool fast )
+void NifProxyModel::saveLinks()
+{
+	int count = nif ? nif->getBlockCount() : 0;
+
+	builtChildLinks.resize( count );
+	builtParentLinks.resize( count );
+	for ( int b = 0; b < count; b++ ) {
+		builtChildLinks[b] = nif->getChildLinks( b );
+		builtParentLinks[b] = nif->getParentLinks( b );
+	}
+
+	builtRootLinks = nif ? nif->getRootLinks() : QList<int>();
+}
+
+void NifProxyModel::updateLinks()
+{
+	if ( !( nif && nif->getBlockCount() > 0 ) ) {
+		updateRoot( false );
+		saveLinks();
+		return;
+	}
+
+	// The tree only depends on the root links and the links of each block number,
+	// so only the items of blocks whose links differ need updating, even after renumbering
+	QList<int> changed;
+	for ( int b = 0; b < nif->getBlockCount(); b++ ) {
+		if ( nif->getChildLinks( b ) != builtChildLinks.value( b ) || nif->getParentLinks( b ) != builtParentLinks.value( b ) )
+			changed.append( b );
+	}
+
+	if ( nif->getRootLinks() != builtRootLinks )
+		updateRoot( false, false );
+
+	for ( const auto b : changed ) {
+		for ( NifProxyItem * item : blockItems.values( b ) ) {
+			// Updating an earlier item may have removed a later one from the tree
+			if ( blockItems.contains( b, item ) )
+				updateItem( item, false, false );
+		}
+	}
+
+	saveLinks();
+}
+
+void NifProxyModel::updateRoot( bool fast, bool deep )
 {
 	if ( !( nif && nif->getBlockCount() > 0 ) ) {
 		if ( root->childCount() > 0 ) {
@@ -283,6 +299,7 @@ void NifProxyModel::updateRoot( bool fast )
 
 	for ( const auto l : nif->getRootLinks() ) {
 		NifProxyItem * item = root->getLink( l );
+		bool added = !item;
 
 		if ( !item ) {
 			if ( !fast )
@@ -294,11 +311,12 @@ void NifProxyModel::updateRoot( bool fast )
 				endInsertRows();
 		}
 
-		updateItem( item, fast );
+		if ( deep || added )
+			updateItem( item, fast );
 	}
 }
 
-void NifProxyModel::updateItem( NifProxyItem * item, bool fast )
+void NifProxyModel::updateItem( NifProxyItem * item, bool fast, bool deep )
 {
 	QModelIndex index( createIndex( item->row(), 0, item ) );
 
@@ -319,6 +337,8 @@ void NifProxyModel::updateItem( NifProxyItem * item, bool fast )
 	}
 	for ( const auto l : nif->getChildLinks( item->block() ) ) {
 		NifProxyItem * child = item->getLink( l );
+		// Existing children were built from their own links, unless only a parent link had added them
+		bool build = deep || !child || child->childCount() == 0;
 
 		if ( !child ) {
 			int at = item->childCount();
@@ -332,6 +352,9 @@ void NifProxyModel::updateItem( NifProxyItem * item, bool fast )
 				endInsertRows();
 		}
 
+		if ( !build )
+			continue;
+
 		if ( !parents.contains( child->block() ) ) {
 			updateItem( child, fast );
 		} else {
@@ -436,16 +459,39 @@ QModelIndex NifProxyModel::mapFrom( const QModelIndex & idx, const QModelIndex &
 	if ( blockNumber < 0 )
 		return QModelIndex();
 
-	NifProxyItem * item = root;
+	NifProxyItem * refItem = root;
 
 	if ( ref.isValid() ) {
 		if ( ref.model() == this )
-			item = static_cast<NifProxyItem *>( ref.internalPointer() );
+			refItem = static_cast<NifProxyItem *>( ref.internalPointer() );
 		else
 			qDebug() << tr( "NifProxyModel::mapFrom() called with wrong ref model" );
 	}
 
-	item = item->findItem( blockNumber );
+	// Prefer the ref item itself, then the shallowest item below it, then the shallowest item anywhere
+	NifProxyItem * item = nullptr;
+
+	if ( refItem->block() == blockNumber ) {
+		item = refItem;
+	} else {
+		int itemDepth = 0;
+		bool itemBelow = false;
+
+		for ( NifProxyItem * candidate : blockItems.values( blockNumber ) ) {
+			int depth = 0;
+			bool below = false;
+			for ( NifProxyItem * p = candidate->parent(); p; p = p->parent() ) {
+				below |= ( p == refItem );
+				depth++;
+			}
+
+			if ( !item || ( below && !itemBelow ) || ( below == itemBelow && depth < itemDepth ) ) {
+				item = candidate;
+				itemDepth = depth;
+				itemBelow = below;
+			}
+		}
+	}
 
 	if ( item )
 		return createIndex( item->row(), 0, item );
@@ -473,9 +519,7 @@ QList<QModelIndex> NifProxyModel::mapFrom( const QModelIndex & idx ) const
 	if ( blockNumber < 0 )
 		return indices;
 
-	QList<NifProxyItem *> items;
-	root->findAllItems( blockNumber, items );
-	for ( NifProxyItem * item : items ) {
+	for ( NifProxyItem * item : blockItems.values( blockNumber ) ) {
 		indices.append( createIndex( item->row(), idx.column() != NifModel::NameCol ? 1 : 0, item ) );
 	}
 
@@ -565,7 +609,7 @@ void NifProxyModel::xDataChanged( const QModelIndex & begin, const QModelIndex &
 
 void NifProxyModel::xLinksChanged()
 {
-	updateRoot( false );
+	updateLinks();
 }
 
 void NifProxyModel::xRowsAboutToBeRemoved( const QModelIndex & parent, int first, int last )
@@ -573,9 +617,11 @@ void NifProxyModel::xRowsAboutToBeRemoved( const QModelIndex & parent, int first
 	if ( !parent.isValid() ) {
 		// block removed
 		for ( int c = first; c <= last; c++ ) {
-			QList<NifProxyItem *> list;
-			root->findAllItems( c - 1, list );
-			for ( NifProxyItem * item : list ) {
+			for ( NifProxyItem * item : blockItems.values( c - 1 ) ) {
+				// Removing an earlier item may have deleted this one with its subtree
+				if ( !blockItems.contains( c - 1, item ) )
+					continue;
+
 				QModelIndex idx = createIndex( item->row(), 0, item );
 				beginRemoveRows( idx.parent(), idx.row(), idx.row() );
 				item->parentItem->childItems.removeAll( item );
@@ -36,7 +36,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QAbstractItemModel> // Inherited
 #include <QList>
 #include <QModelIndex>
+#include <QMultiHash>
 #include <QVariant>
+#include <QVector>
 
 
 //! @file nifproxymodel.h NifProxyModel
@@ -87,12 +89,23 @@ protected slots:
 protected:
 	QList<QModelIndex> mapFrom( const QModelIndex & index ) const;
 
-	void updateRoot( bool fast );
-	void updateItem( NifProxyItem * item, bool fast );
+	void updateRoot( bool fast, bool deep = true );
+	void updateItem( NifProxyItem * item, bool fast, bool deep = true );
+	//! Updates only the items of blocks whose links differ from when the tree was last built
+	void updateLinks();
+	//! Records the links the tree was built from
+	void saveLinks();
 
 	NifModel * nif;
 
 	NifProxyItem * root;
+
+	//! Proxy items of each block number
+	QMultiHash<int, NifProxyItem *> blockItems;
+
+	//! Child and parent links of each block and the root links the tree was last built from
+	QVector<QList<int>> builtChildLinks, builtParentLinks;
+	QList<int> builtRootLinks;
 };
 
 #endif
@@ -36,12 +36,595 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 
 #include <QCoreApplication>
+#include <QDataStream>
+#include <QTemporaryFile>
 
+#include <algorithm>
+#include <type_traits>
 
-//! @file undocommands.cpp ChangeValueCommand, ToggleCheckBoxListCommand
+
+//! @file undocommands.cpp UndoJournal, ChangeValueCommand, ToggleCheckBoxListCommand
 
 size_t ChangeValueCommand::lastID = 0;
 
+/*
+ *  UndoJournal
+ */
+
+qint64 UndoJournal::memoryUsed = 0;
+QHash<const QAbstractItemModel *, QList<UndoJournal *>> UndoJournal::journals;
+
+//! Tag of values stored as a plain string (string table indices are edited as text)
+static const quint8 tagString = 0xfe;
+
+//! Minimum size of the in-memory entries written to the spill file at once
+static const int spillChunk = 64 * 1024;
+
+template <typename T> static void writeRaw( QDataStream & ds, const void * data )
+{
+	static_assert( std::is_trivially_copyable<T>::value, "Only plain value types can be journaled as raw bytes" );
+	ds.writeRawData( static_cast<const char *>( data ), sizeof( T ) );
+}
+
+template <typename T> static void readRaw( QDataStream & ds, void * data )
+{
+	ds.readRawData( static_cast<char *>( data ), sizeof( T ) );
+}
+
+static bool isStringType( int t )
+{
+	return ( t >= NifValue::tSizedString && t <= NifValue::tChar8String )
+		|| t == NifValue::tString || t == NifValue::tStringIndex || t == NifValue::tFilePath;
+}
+
+//! Start and end offsets of the entries in data, in order
+static QVector<QPair<qint64, qint64>> entryRanges( const QByteArray & data )
+{
+	QDataStream ds( data );
+	QVector<QPair<qint64, qint64>> ranges;
+
+	qint64 pos = data.size();
+	while ( pos > 0 ) {
+		quint32 size;
+		ds.device()->seek( pos - sizeof( quint32 ) );
+		ds >> size;
+
+		ranges.prepend( { pos - qint64( sizeof( quint32 ) ) - size, pos } );
+		pos -= sizeof( quint32 ) + size;
+	}
+
+	return ranges;
+}
+
+//! Reads the block slot, shift count and rows of an entry, leaving ds at its values
+static void readEntry( QDataStream & ds, quint32 & slot, quint32 & since, QVector<int> & path )
+{
+	quint8 depth;
+	ds >> slot >> since >> depth;
+
+	path.resize( depth );
+	for ( int & row : path ) {
+		quint32 r;
+		ds >> r;
+		row = r;
+	}
+}
+
+UndoJournal::UndoJournal()
+{
+}
+
+UndoJournal::~UndoJournal()
+{
+	memoryUsed -= buffer.size();
+
+	if ( model )
+		journals[model].removeOne( this );
+}
+
+void UndoJournal::track( UndoJournal * journal, const QAbstractItemModel * model )
+{
+	journal->model = model;
+
+	if ( !journals.contains( model ) ) {
+		auto shift = [model]( const QModelIndex & parent, int first, int last, bool inserted ) {
+			for ( UndoJournal * j : journals.value( model ) )
+				j->shiftRows( parent, first, last, inserted );
+		};
+
+		QObject::connect( model, &QAbstractItemModel::rowsInserted, model,
+			[shift]( const QModelIndex & parent, int first, int last ) {
+				shift( parent, first, last, true );
+			}
+		);
+		QObject::connect( model, &QAbstractItemModel::rowsRemoved, model,
+			[shift]( const QModelIndex & parent, int first, int last ) {
+				shift( parent, first, last, false );
+			}
+		);
+		QObject::connect( model, &QAbstractItemModel::rowsMoved, model,
+			[shift]( const QModelIndex & parent, int first, int last, const QModelIndex & dest, int row ) {
+				// Entries of the moved rows are dropped, the rows around them shift
+				int count = last - first + 1;
+				shift( parent, first, last, false );
+				if ( dest == parent && row > last )
+					row -= count;
+				shift( dest, row, row + count - 1, true );
+			}
+		);
+		QObject::connect( model, &QAbstractItemModel::modelReset, model, [model]() {
+			for ( UndoJournal * j : journals.value( model ) )
+				j->tops.fill( -1 );
+		} );
+		QObject::connect( model, &QObject::destroyed, [model]() {
+			for ( UndoJournal * j : journals.value( model ) )
+				j->model = nullptr;
+			journals.remove( model );
+		} );
+	}
+
+	journals[model].append( journal );
+}
+
+quint32 UndoJournal::slot( int top )
+{
+	int s = tops.indexOf( top );
+	if ( s < 0 || top < 0 ) {
+		s = tops.size();
+		tops.append( top );
+	}
+
+	return s;
+}
+
+void UndoJournal::append( const QModelIndex & index, const QVariant & oldValue, const QVariant & newValue )
+{
+	append( index, {}, oldValue, newValue );
+}
+
+void UndoJournal::append( const QModelIndex & parent, const QVector<int> & rows, const QVariant & oldValue, const QVariant & newValue )
+{
+	if ( !model && parent.model() )
+		track( this, parent.model() );
+
+	QVector<int> path = rows;
+	QModelIndex top = parent;
+	for ( ; top.parent().isValid(); top = top.parent() )
+		path.prepend( top.row() );
+
+	QByteArray values;
+	QDataStream ds( &values, QIODevice::WriteOnly );
+	writeValue( ds, oldValue );
+	writeValue( ds, newValue );
+
+	write( slot( top.row() ), path, values );
+}
+
+void UndoJournal::append( const UndoJournal & other )
+{
+	if ( !model && other.model )
+		track( this, other.model );
+
+	// Bring the other journal's entries up to date and move them over to this block table
+	const QByteArray data = other.contents();
+	QDataStream ds( data );
+
+	for ( const auto & range : entryRanges( data ) ) {
+		ds.device()->seek( range.first );
+
+		quint32 s, since;
+		QVector<int> path;
+		readEntry( ds, s, since, path );
+
+		int top = other.tops.value( s, -1 );
+		if ( top < 0 || !other.resolve( s, since, path ) )
+			continue;
+
+		const qint64 values = ds.device()->pos();
+		write( slot( top ), path, data.mid( values, range.second - sizeof( quint32 ) - values ) );
+	}
+}
+
+void UndoJournal::clear()
+{
+	memoryUsed -= buffer.size();
+	buffer.clear();
+	spillFile.reset();
+	entries = 0;
+}
+
+void UndoJournal::write( quint32 slot, const QVector<int> & path, const QByteArray & values )
+{
+	const int start = buffer.size();
+
+	// Entry: block slot, row shifts logged before it, depth, rows in the block, old value, new value,
+	//	followed by the entry size so it can be read backwards
+	QDataStream ds( &buffer, QIODevice::WriteOnly | QIODevice::Append );
+	ds << slot << quint32( shifts.size() ) << quint8( path.size() );
+	for ( int row : path )
+		ds << quint32( row );
+
+	ds.writeRawData( values.constData(), values.size() );
+	ds << quint32( buffer.size() - start );
+
+	memoryUsed += buffer.size() - start;
+	entries++;
+	written = shifts.size();
+
+	if ( memoryUsed > memoryLimit && buffer.size() >= spillChunk )
+		spill();
+}
+
+int UndoJournal::mark( const QModelIndex & index )
+{
+	if ( !model && index.model() )
+		track( this, index.model() );
+
+	QVector<int> path;
+	QModelIndex top = index;
+	for ( ; top.parent().isValid(); top = top.parent() )
+		path.prepend( top.row() );
+
+	marks.append( { slot( top.row() ), quint32( shifts.size() ), path } );
+	written = shifts.size();
+
+	return marks.size() - 1;
+}
+
+QModelIndex UndoJournal::locate( NifModel * nif, int mark ) const
+{
+	if ( mark < 0 || mark >= marks.size() )
+		return QModelIndex();
+
+	const Mark & m = marks.at( mark );
+	QVector<int> path = m.path;
+	if ( !resolve( m.slot, m.since, path ) )
+		return QModelIndex();
+
+	return find( nif, m.slot, path, 0, false );
+}
+
+void UndoJournal::shiftRows( const QModelIndex & parent, int first, int last, bool inserted )
+{
+	const int count = last - first + 1;
+
+	if ( !parent.isValid() ) {
+		for ( int & top : tops ) {
+			if ( top < first )
+				continue;
+			else if ( inserted )
+				top += count;
+			else
+				top = ( top > last ) ? top - count : -1;
+		}
+		return;
+	}
+
+	// Nothing recorded yet can be affected, and later entries start after this change
+	if ( entries == 0 && marks.isEmpty() )
+		return;
+
+	QVector<int> prefix;
+	QModelIndex top = parent;
+	for ( ; top.parent().isValid(); top = top.parent() )
+		prefix.prepend( top.row() );
+
+	const int s = tops.indexOf( top.row() );
+	if ( s < 0 )
+		return;
+
+	const int rows = model->rowCount( parent );
+
+	// A removal which undoes the last insertion cancels it out, unless something was recorded in between
+	if ( !inserted && shifts.size() > written ) {
+		const Shift & previous = shifts.last();
+		if ( int( previous.slot ) == s && previous.prefix == prefix && previous.first == first
+			&& previous.count == count && previous.end == rows )
+		{
+			shifts.removeLast();
+			return;
+		}
+	}
+
+	shifts.append( { quint32( s ), prefix, first, inserted ? count : -count, inserted ? rows - count : rows + count } );
+}
+
+bool UndoJournal::resolve( quint32 slot, quint32 since, QVector<int> & path ) const
+{
+	for ( int i = since; i < shifts.size(); i++ ) {
+		const Shift & shift = shifts.at( i );
+		const int depth = shift.prefix.size();
+		if ( shift.slot != slot || path.size() <= depth
+			|| !std::equal( shift.prefix.cbegin(), shift.prefix.cend(), path.cbegin() ) )
+			continue;
+
+		int & row = path[depth];
+		if ( row < shift.first || row >= shift.end )
+			continue;
+
+		// The item itself was removed
+		if ( shift.count < 0 && row < shift.first - shift.count )
+			return false;
+
+		row += shift.count;
+	}
+
+	return true;
+}
+
+QModelIndex UndoJournal::find( NifModel * nif, quint32 slot, const QVector<int> & path, int column, bool resize ) const
+{
+	int top = tops.value( slot, -1 );
+	if ( top < 0 )
+		return QModelIndex();
+
+	QModelIndex index = nif->index( top, path.isEmpty() ? column : 0 );
+	for ( int i = 0; i < path.size() && index.isValid(); i++ ) {
+		if ( resize && path.at( i ) >= nif->rowCount( index ) && nif->isArray( index ) )
+			nif->updateArray( index );
+
+		index = nif->index( path.at( i ), ( i == path.size() - 1 ) ? column : 0, index );
+	}
+
+	return index;
+}
+
+void UndoJournal::apply( NifModel * nif, bool undo, bool resize ) const
+{
+	const QByteArray data = contents();
+	QDataStream ds( data );
+
+	if ( entries > 1 )
+		nif->setState( BaseModel::Processing );
+
+	// Changed rows of each parent, signalled as one range per parent
+	QHash<QModelIndex, QPair<int, int>> changed;
+	auto applyEntry = [&]( qint64 pos ) {
+		ds.device()->seek( pos );
+
+		quint32 s, since;
+		QVector<int> path;
+		readEntry( ds, s, since, path );
+
+		const QVariant oldValue = readValue( ds );
+		const QVariant newValue = readValue( ds );
+		const QVariant & value = undo ? oldValue : newValue;
+
+		// Skip items of removed blocks or rows, which no longer exist or were replaced by an item of another type
+		if ( !resolve( s, since, path ) )
+			return;
+
+		QModelIndex index = find( nif, s, path, NifModel::ValueCol, resize );
+		if ( !index.isValid() )
+			return;
+
+		if ( value.userType() == qMetaTypeId<NifValue>() ) {
+			int journaled = static_cast<const NifValue *>( value.constData() )->type();
+			int current = nif->getValue( index ).type();
+			if ( journaled != current && !( isStringType( journaled ) && isStringType( current ) ) )
+				return;
+		}
+
+		nif->setData( index, value, Qt::EditRole );
+
+		auto it = changed.find( index.parent() );
+		if ( it == changed.end() ) {
+			changed.insert( index.parent(), { index.row(), index.row() } );
+		} else {
+			it->first = std::min( it->first, index.row() );
+			it->second = std::max( it->second, index.row() );
+		}
+	};
+
+	const auto ranges = entryRanges( data );
+	if ( undo ) {
+		for ( auto it = ranges.crbegin(); it != ranges.crend(); ++it )
+			applyEntry( it->first );
+	} else {
+		for ( const auto & range : ranges )
+			applyEntry( range.first );
+	}
+
+	if ( entries > 1 ) {
+		nif->restoreState();
+		for ( auto it = changed.cbegin(); it != changed.cend(); ++it )
+			emit nif->dataChanged( nif->index( it->first, NifModel::ValueCol, it.key() ),
+				nif->index( it->second, NifModel::ValueCol, it.key() ) );
+	}
+}
+
+QByteArray UndoJournal::contents() const
+{
+	if ( !spillFile )
+		return buffer;
+
+	spillFile->seek( 0 );
+	return spillFile->readAll() + buffer;
+}
+
+void UndoJournal::spill()
+{
+	if ( !spillFile ) {
+		spillFile.reset( new QTemporaryFile );
+		if ( !spillFile->open() ) {
+			// Keep the entries in memory
+			spillFile.reset();
+			return;
+		}
+	}
+
+	qint64 size = spillFile->size();
+	spillFile->seek( size );
+	if ( spillFile->write( buffer ) != buffer.size() || !spillFile->flush() ) {
+		spillFile->resize( size );
+		return;
+	}
+
+	memoryUsed -= buffer.size();
+	buffer.clear();
+}
+
+void UndoJournal::writeValue( QDataStream & ds, const QVariant & value )
+{
+	if ( value.userType() != qMetaTypeId<NifValue>() ) {
+		ds << tagString << value.toString();
+		return;
+	}
+
+	const NifValue & v = *static_cast<const NifValue *>( value.constData() );
+	ds << quint8( v.typ );
+
+	switch ( v.typ ) {
+	case NifValue::tVector2:
+	case NifValue::tHalfVector2:
+		writeRaw<Vector2>( ds, v.val.data );
+		break;
+	case NifValue::tVector3:
+	case NifValue::tHalfVector3:
+	case NifValue::tUshortVector3:
+	case NifValue::tByteVector3:
+		writeRaw<Vector3>( ds, v.val.data );
+		break;
+	case NifValue::tVector4:
+		writeRaw<Vector4>( ds, v.val.data );
+		break;
+	case NifValue::tQuat:
+	case NifValue::tQuatXYZW:
+		writeRaw<Quat>( ds, v.val.data );
+		break;
+	case NifValue::tMatrix:
+		writeRaw<Matrix>( ds, v.val.data );
+		break;
+	case NifValue::tMatrix4:
+		writeRaw<Matrix4>( ds, v.val.data );
+		break;
+	case NifValue::tTriangle:
+		writeRaw<Triangle>( ds, v.val.data );
+		break;
+	case NifValue::tColor3:
+		writeRaw<Color3>( ds, v.val.data );
+		break;
+	case NifValue::tColor4:
+	case NifValue::tByteColor4:
+		writeRaw<Color4>( ds, v.val.data );
+		break;
+	case NifValue::tBSVertexDesc:
+		writeRaw<BSVertexDesc>( ds, v.val.data );
+		break;
+	case NifValue::tString:
+	case NifValue::tSizedString:
+	case NifValue::tText:
+	case NifValue::tShortString:
+	case NifValue::tHeaderString:
+	case NifValue::tLineString:
+	case NifValue::tChar8String:
+		ds << *static_cast<QString *>( v.val.data );
+		break;
+	case NifValue::tByteArray:
+	case NifValue::tStringPalette:
+	case NifValue::tBlob:
+		ds << *static_cast<QByteArray *>( v.val.data );
+		break;
+	case NifValue::tByteMatrix:
+		{
+			auto m = static_cast<ByteMatrix *>( v.val.data );
+			ds << qint32( m->count( 0 ) ) << qint32( m->count( 1 ) );
+			ds.writeRawData( m->data(), m->count() );
+		}
+		break;
+	case NifValue::tNone:
+		break;
+	default:
+		ds << v.val.u64;
+		break;
+	}
+}
+
+QVariant UndoJournal::readValue( QDataStream & ds )
+{
+	quint8 tag;
+	ds >> tag;
+
+	if ( tag == tagString ) {
+		QString s;
+		ds >> s;
+		return s;
+	}
+
+	NifValue v( NifValue::Type( tag ) );
+
+	switch ( v.typ ) {
+	case NifValue::tVector2:
+	case NifValue::tHalfVector2:
+		readRaw<Vector2>( ds, v.val.data );
+		break;
+	case NifValue::tVector3:
+	case NifValue::tHalfVector3:
+	case NifValue::tUshortVector3:
+	case NifValue::tByteVector3:
+		readRaw<Vector3>( ds, v.val.data );
+		break;
+	case NifValue::tVector4:
+		readRaw<Vector4>( ds, v.val.data );
+		break;
+	case NifValue::tQuat:
+	case NifValue::tQuatXYZW:
+		readRaw<Quat>( ds, v.val.data );
+		break;
+	case NifValue::tMatrix:
+		readRaw<Matrix>( ds, v.val.data );
+		break;
+	case NifValue::tMatrix4:
+		readRaw<Matrix4>( ds, v.val.data );
+		break;
+	case NifValue::tTriangle:
+		readRaw<Triangle>( ds, v.val.data );
+		break;
+	case NifValue::tColor3:
+		readRaw<Color3>( ds, v.val.data );
+		break;
+	case NifValue::tColor4:
+	case NifValue::tByteColor4:
+		readRaw<Color4>( ds, v.val.data );
+		break;
+	case NifValue::tBSVertexDesc:
+		readRaw<BSVertexDesc>( ds, v.val.data );
+		break;
+	case NifValue::tString:
+	case NifValue::tSizedString:
+	case NifValue::tText:
+	case NifValue::tShortString:
+	case NifValue::tHeaderString:
+	case NifValue::tLineString:
+	case NifValue::tChar8String:
+		ds >> *static_cast<QString *>( v.val.data );
+		break;
+	case NifValue::tByteArray:
+	case NifValue::tStringPalette:
+	case NifValue::tBlob:
+		ds >> *static_cast<QByteArray *>( v.val.data );
+		break;
+	case NifValue::tByteMatrix:
+		{
+			qint32 len0, len1;
+			ds >> len0 >> len1;
+
+			ByteMatrix m( len0, len1 );
+			ds.readRawData( m.data(), m.count() );
+			*static_cast<ByteMatrix *>( v.val.data ) = m;
+		}
+		break;
+	case NifValue::tNone:
+		break;
+	default:
+		ds >> v.val.u64;
+		break;
+	}
+
+	return v.toVariant();
+}
+
+
 /*
  *  ChangeValueCommand
  */
@@ -50,9 +633,7 @@ ChangeValueCommand::ChangeValueCommand( const QModelIndex & index,
 	const QVariant & value, const QString & valueString, const QString & valueType, NifModel * model )
 	: QUndoCommand(), nif( model )
 {
-	idxs << index;
-	oldValues << index.data( Qt::EditRole );
-	newValues << value;
+	journal.append( index, index.data( Qt::EditRole ), value );
 
 	localID = lastID;
 
@@ -69,9 +650,7 @@ ChangeValueCommand::ChangeValueCommand( const QModelIndex & index, const NifValu
 										const NifValue & newVal, const QString & valueType, NifModel * model )
 	: QUndoCommand(), nif( model )
 {
-	idxs << index;
-	oldValues << oldVal.toVariant();
-	newValues << newVal.toVariant();
+	journal.append( index, oldVal.toVariant(), newVal.toVariant() );
 
 	localID = lastID;
 
@@ -87,44 +666,13 @@ ChangeValueCommand::ChangeValueCommand( const QModelIndex & index, const NifValu
 void ChangeValueCommand::redo()
 {
 	//qDebug() << "Redoing";
-	Q_ASSERT( idxs.size() == newValues.size() && newValues.size() == oldValues.size() );
-
-	if ( idxs.size() > 1 )
-		nif->setState( BaseModel::Processing );
-
-	int i = 0;
-	for ( auto idx : idxs ) {
-		if ( idx.isValid() )
-			nif->setData( idx, newValues.at( i++ ), Qt::EditRole );
-	}
-
-	if ( idxs.size() > 1 ) {
-		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
-	}
-
-	//qDebug() << nif->data( idx ).toString();
+	journal.apply( nif, false );
 }
 
 void ChangeValueCommand::undo()
 {
 	//qDebug() << "Undoing";
-
-	if ( idxs.size() > 1 )
-		nif->setState( BaseModel::Processing );
-
-	int i = 0;
-	for ( auto idx : idxs ) {
-		if ( idx.isValid() )
-			nif->setData( idx, oldValues.at( i++ ), Qt::EditRole );
-	}
-
-	if ( idxs.size() > 1 ) {
-		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
-	}
-
-	//qDebug() << nif->data( idx ).toString();
+	journal.apply( nif, true );
 }
 
 int ChangeValueCommand::id() const
@@ -139,9 +687,7 @@ bool ChangeValueCommand::mergeWith( const QUndoCommand * other )
 	if ( localID != cv->localID )
 		return false;
 
-	idxs << cv->idxs;
-	newValues << cv->newValues;
-	oldValues << cv->oldValues;
+	journal.append( cv->journal );
 
 	return true;
 }
@@ -158,12 +704,9 @@ void ChangeValueCommand::createTransaction()
 
 ToggleCheckBoxListCommand::ToggleCheckBoxListCommand( const QModelIndex & index,
 	const QVariant & value, const QString & valueType, NifModel * model )
-	: QUndoCommand(), nif( model ), idx( index )
+	: QUndoCommand(), nif( model )
 {
-	oldValue = index.data( Qt::EditRole );
-	newValue = value;
-
-	auto oldTxt = index.data( Qt::DisplayRole ).toString();
+	journal.append( index, index.data( Qt::EditRole ), value );
 
 	setText( QCoreApplication::translate( "ToggleCheckBoxListCommand", "Modify %1" ).arg( valueType ) );
 }
@@ -171,40 +714,80 @@ ToggleCheckBoxListCommand::ToggleCheckBoxListCommand( const QModelIndex & index,
 void ToggleCheckBoxListCommand::redo()
 {
 	//qDebug() << "Redoing";
-	if ( idx.isValid() )
-		nif->setData( idx, newValue, Qt::EditRole );
-
-	//qDebug() << nif->data( idx ).toString();
+	journal.apply( nif, false );
 }
 
 void ToggleCheckBoxListCommand::undo()
 {
 	//qDebug() << "Undoing";
-	if ( idx.isValid() )
-		nif->setData( idx, oldValue, Qt::EditRole );
+	journal.apply( nif, true );
+}
+
+//! Collects the values of the items below parent from row first on, in order, along with their rows
+static void collectValues( const NifItem * parent, QVector<int> & rows, QVector<QPair<QVector<int>, QVariant>> & values, int first = 0 )
+{
+	for ( int r = std::max( first, 0 ); r < parent->childCount(); r++ ) {
+		const NifItem * item = parent->child( r );
+		rows.append( r );
+
+		if ( item->childCount() > 0 )
+			collectValues( item, rows, values );
+		else if ( item->isBinary() || ( !item->isArray() && item->value().type() != NifValue::tNone ) )
+			values.append( { rows, item->value().toVariant() } );
 
-	//qDebug() << nif->data( idx ).toString();
+		rows.removeLast();
+	}
 }
 
 ArrayUpdateCommand::ArrayUpdateCommand( const QModelIndex & index, NifModel * model )
-	: QUndoCommand(), nif( model ), idx( index )
+	: QUndoCommand(), nif( model )
 {
+	array = journal.mark( index );
+
 	setText( QCoreApplication::translate( "ArrayUpdateCommand", "Update Array" ) );
 }
 
 void ArrayUpdateCommand::redo()
 {
-	if ( idx.isValid() ) {
-		oldSize = nif->rowCount( idx );
+	QModelIndex idx = journal.locate( nif, array );
+	if ( !idx.isValid() )
+		return;
+
+	NifItem * item = static_cast<NifItem *>( idx.internalPointer() );
+	oldSize = nif->rowCount( idx );
+	journal.clear();
+
+	if ( item->isBinary() ) {
+		const QVariant oldValue = item->value().toVariant();
 		nif->updateArray( idx );
-		newSize = nif->rowCount( idx );
+		journal.append( idx, oldValue, item->value().toVariant() );
+		return;
 	}
+
+	// Keep the values of the elements the update removes
+	QVector<QPair<QVector<int>, QVariant>> values;
+	QVector<int> rows;
+	collectValues( item, rows, values, nif->getArraySize( item ) );
+
+	nif->updateArray( idx );
+
+	for ( const auto & v : values )
+		journal.append( idx, v.first, v.second, v.second );
 }
 
 void ArrayUpdateCommand::undo()
 {
-	if ( idx.isValid() ) {
-		// TODO: Actually attempt to set the array size back
-		nif->updateArray( idx );
+	QModelIndex idx = journal.locate( nif, array );
+	if ( !idx.isValid() )
+		return;
+
+	NifItem * item = static_cast<NifItem *>( idx.internalPointer() );
+	if ( item->isBinary() ) {
+		journal.apply( nif, true );
+		return;
 	}
+
+	// Shrink back or add the removed elements, then restore their values and the arrays inside them
+	nif->resizeArrayItem( item, oldSize );
+	journal.apply( nif, false, true );
 }
@@ -34,14 +34,124 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define UNDOCOMMANDS_H
 
 #include <QUndoCommand>
+#include <QHash>
 #include <QModelIndex>
 #include <QVariant>
+#include <QVector>
 
+#include <memory>
 
-//! @file undocommands.h ChangeValueCommand, ToggleCheckBoxListCommand
+
+//! @file undocommands.h UndoJournal, ChangeValueCommand, ToggleCheckBoxListCommand
 
 class NifModel;
 class NifValue;
+class QAbstractItemModel;
+class QDataStream;
+class QTemporaryFile;
+
+/*! A compact record of value changes made by an undo command
+ *
+ * Each change is packed into a binary entry holding the item's block and its row path inside
+ * that block, and its old and new values, instead of a QPersistentModelIndex and two QVariants.
+ * Blocks are kept as their top-level rows (header, blocks, footer) in a small table which
+ * follows top-level row insertions and removals. Rows inserted or removed inside a block are
+ * added to a log of row shifts; each entry remembers how much of the log came before it, and
+ * the later shifts are applied to its rows when it is applied, so that an entry never lands on
+ * another item. Recorded entries are never rewritten.
+ * Once all journals together hold more than memoryLimit bytes, entries are spilled to a
+ * temporary file and read back when the command is undone or redone.
+ */
+class UndoJournal final
+{
+public:
+	UndoJournal();
+	~UndoJournal();
+
+	//! Records a change of the item at index from oldValue to newValue
+	void append( const QModelIndex & index, const QVariant & oldValue, const QVariant & newValue );
+	//! Records a change of the item at rows below parent, which does not have to exist yet
+	void append( const QModelIndex & parent, const QVector<int> & rows, const QVariant & oldValue, const QVariant & newValue );
+	//! Appends all changes recorded by another journal
+	void append( const UndoJournal & other );
+	//! Forgets all changes; marked items are kept
+	void clear();
+
+	/*! Applies the new values in order, or the old values in reverse order when undoing
+	 *
+	 * With resize, an array that is too short for an entry is first updated to its size field,
+	 * so that elements and the arrays inside them come back along with their values.
+	 */
+	void apply( NifModel * nif, bool undo, bool resize = false ) const;
+
+	//! Records where an item is, returning a handle for locate()
+	int mark( const QModelIndex & index );
+	//! Finds a marked item again after the rows around it changed; invalid once it was removed
+	QModelIndex locate( NifModel * nif, int mark ) const;
+
+	//! The number of recorded changes
+	int count() const { return entries; }
+
+	//! Bytes all journals may hold in memory before spilling entries to disk
+	static constexpr qint64 memoryLimit = 32 * 1024 * 1024;
+
+private:
+	//! Rows inserted ( count > 0 ) or removed ( count < 0 ) at first, below the rows prefix of a block
+	struct Shift
+	{
+		quint32 slot;
+		QVector<int> prefix;
+		int first, count;
+		//! Row count before the change; rows past it did not exist then and are not shifted
+		int end;
+	};
+
+	//! An item located by mark(), with the size of the shift log at that time
+	struct Mark
+	{
+		quint32 slot, since;
+		QVector<int> path;
+	};
+
+	//! All entries, including those spilled to disk
+	QByteArray contents() const;
+	//! Moves the entries held in memory to the spill file
+	void spill();
+	//! The slot of a top-level row in the block table, added if missing
+	quint32 slot( int top );
+	//! Writes an entry with its values already serialized
+	void write( quint32 slot, const QVector<int> & path, const QByteArray & values );
+	//! Applies the shifts logged from since on to a path in block slot; false if the item was removed
+	bool resolve( quint32 slot, quint32 since, QVector<int> & path ) const;
+	//! The index of a path in block slot, at column below the last row
+	QModelIndex find( NifModel * nif, quint32 slot, const QVector<int> & path, int column, bool resize ) const;
+	//! Follows rows inserted into or removed from parent
+	void shiftRows( const QModelIndex & parent, int first, int last, bool inserted );
+
+	//! Registers a journal for the structural changes of its model
+	static void track( UndoJournal * journal, const QAbstractItemModel * model );
+
+	static void writeValue( QDataStream & ds, const QVariant & value );
+	static QVariant readValue( QDataStream & ds );
+
+	const QAbstractItemModel * model = nullptr;
+	//! Top-level row of each block the entries belong to, -1 once removed
+	QVector<int> tops;
+	//! Row shifts inside the blocks in tops, in order
+	QVector<Shift> shifts;
+	//! Size of the shift log when the last entry or mark was added
+	int written = 0;
+	QVector<Mark> marks;
+
+	QByteArray buffer;
+	std::unique_ptr<QTemporaryFile> spillFile;
+	int entries = 0;
+
+	//! Bytes held in memory by all journals
+	static qint64 memoryUsed;
+	//! The journals of each model
+	static QHash<const QAbstractItemModel *, QList<UndoJournal *>> journals;
+};
 
 class ChangeValueCommand : public QUndoCommand
 {
@@ -64,8 +174,7 @@ public:
 
 private:
 	NifModel * nif;
-	QVector<QVariant> newValues, oldValues;
-	QVector<QPersistentModelIndex> idxs;
+	UndoJournal journal;
 
 	//! The command ID for this undo command
 	size_t localID;
@@ -83,8 +192,7 @@ public:
 	void undo() override;
 private:
 	NifModel * nif;
-	QVariant newValue, oldValue;
-	QPersistentModelIndex idx;
+	UndoJournal journal;
 };
 
 
@@ -96,8 +204,10 @@ public:
 	void undo() override;
 private:
 	NifModel * nif;
-	uint newSize, oldSize;
-	QPersistentModelIndex idx;
+	//! Marks the array and holds the values of the elements the update removed
+	UndoJournal journal;
+	int array;
+	int oldSize = 0;
 };
 
 #endif // UNDOCOMMANDS_H
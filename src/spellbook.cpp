@@ -36,12 +36,45 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QCache>
 #include <QDir>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QProgressDialog>
 #include <QSettings>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <numeric> // std::iota
 
 
 
 //! \file spellbook.cpp SpellBook implementation
 
+bool Spell::runJobs( const QString & label, int count, const std::function<void( int )> & job )
+{
+	if ( count <= 0 )
+		return true;
+
+	QVector<int> jobs( count );
+	std::iota( jobs.begin(), jobs.end(), 0 );
+
+	QProgressDialog dlg( label, Spell::tr( "Cancel" ), 0, count );
+	dlg.setWindowModality( Qt::ApplicationModal );
+	dlg.setMinimumDuration( 500 );
+
+	QFutureWatcher<void> watcher;
+	QEventLoop loop;
+	QObject::connect( &watcher, &QFutureWatcher<void>::progressValueChanged, &dlg, &QProgressDialog::setValue );
+	QObject::connect( &watcher, &QFutureWatcher<void>::finished, &loop, &QEventLoop::quit );
+	QObject::connect( &dlg, &QProgressDialog::canceled, &watcher, &QFutureWatcher<void>::cancel );
+
+	// Cancelling only stops queued jobs; the ones already running are allowed to finish
+	watcher.setFuture( QtConcurrent::map( jobs, [&job]( int i ) { job( i ); } ) );
+	if ( !watcher.isFinished() )
+		loop.exec();
+	watcher.waitForFinished();
+
+	return !watcher.isCanceled();
+}
+
 QList<SpellPtr> & SpellBook::spells()
 {
 	static QList<SpellPtr> _spells = QList<SpellPtr>();
@@ -107,10 +140,21 @@ SpellBook::~SpellBook()
 	books().removeAll( this );
 }
 
+//! Builds the block holding index if it was loaded lazily, spells look at its rows directly
+static void fetchBlock( NifModel * nif, const QModelIndex & index )
+{
+	QModelIndex block = nif->getBlockOrHeader( index );
+	if ( nif->canFetchMore( block ) )
+		nif->fetchMore( block );
+}
+
 void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell )
 {
 	QSettings cfg;
 
+	if ( nif )
+		fetchBlock( nif, index );
+
 	bool suppressConfirm = cfg.value( "Settings/Suppress Undoable Confirmation", false ).toBool();
 	bool accepted = false;
 
@@ -171,10 +215,12 @@ void SpellBook::sltNif( NifModel * nif )
 
 void SpellBook::sltIndex( const QModelIndex & index )
 {
-	if ( index.model() == Nif )
+	if ( index.model() == Nif ) {
 		Index = index;
-	else
+		fetchBlock( Nif, index );
+	} else {
 		Index = QModelIndex();
+	}
 
 	checkActions();
 }
@@ -46,6 +46,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QPersistentModelIndex>
 #include <QString>
 
+#include <functional>
 #include <memory>
 
 
@@ -99,6 +100,16 @@ public:
 			cast( nif, index );
 	}
 
+	//! Runs \a count independent jobs on the global thread pool
+	/*!
+	 * A progress dialog labelled with \a label is shown while the jobs run,
+	 * keeping the GUI responsive. The jobs must not touch the model; gather
+	 * their input beforehand and write their results back afterwards.
+	 *
+	 * \return False if the user cancelled before every job was run
+	 */
+	static bool runJobs( const QString & label, int count, const std::function<void( int )> & job );
+
 	//! i18n wrapper for various strings
 	/*!
 	 * Note that we don't use QObject::tr() because that doesn't provide
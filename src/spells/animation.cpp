@@ -1,6 +1,19 @@
 #include "spellbook.h"
 
+#include "gl/glcontroller.h"
+#include "gl/gltools/animationbaker.h"
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QDoubleSpinBox>
 #include <QFileDialog>
+#include <QLabel>
+#include <QLayout>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -425,3 +438,372 @@ public:
 };
 
 REGISTER_SPELL( spFixAVObjectPalette );
+
+
+//! A dialog of labelled option fields with Ok and Cancel buttons, shared by the animation spells
+class OptionsDialog final : public QDialog
+{
+public:
+	OptionsDialog()
+	{
+		vbox = new QVBoxLayout;
+		setLayout( vbox );
+	}
+
+	QSpinBox * addInt( const QString & label, int min, int max, int value )
+	{
+		vbox->addWidget( new QLabel( label ) );
+
+		QSpinBox * spn = new QSpinBox;
+		spn->setRange( min, max );
+		spn->setValue( value );
+		vbox->addWidget( spn );
+		return spn;
+	}
+
+	QDoubleSpinBox * addDouble( const QString & label, double max, int decimals, double step, double value )
+	{
+		vbox->addWidget( new QLabel( label ) );
+
+		QDoubleSpinBox * spn = new QDoubleSpinBox;
+		spn->setRange( 0, max );
+		spn->setDecimals( decimals );
+		spn->setSingleStep( step );
+		spn->setValue( value );
+		vbox->addWidget( spn );
+		return spn;
+	}
+
+	QCheckBox * addCheck( const QString & text, bool checked )
+	{
+		QCheckBox * chk = new QCheckBox( text );
+		chk->setChecked( checked );
+		vbox->addWidget( chk );
+		return chk;
+	}
+
+	//! Adds the buttons and shows the dialog; true if it was accepted
+	bool run()
+	{
+		QHBoxLayout * hbox = new QHBoxLayout;
+		vbox->addLayout( hbox );
+
+		QPushButton * ok = new QPushButton;
+		ok->setText( Spell::tr( "Ok" ) );
+		hbox->addWidget( ok );
+
+		QPushButton * cancel = new QPushButton;
+		cancel->setText( Spell::tr( "Cancel" ) );
+		hbox->addWidget( cancel );
+
+		QObject::connect( ok, &QPushButton::clicked, this, &QDialog::accept );
+		QObject::connect( cancel, &QPushButton::clicked, this, &QDialog::reject );
+
+		return exec() == QDialog::Accepted;
+	}
+
+private:
+	QVBoxLayout * vbox;
+};
+
+
+//! Resample the keys of a sequence on a fixed timestep
+/*!
+ * Evaluates every interpolator of the sequence at a fixed frame rate with
+ * AnimationBaker and replaces their keys with linear keys, dropping the keys
+ * that linear interpolation reproduces within the given tolerance.
+ */
+class spResampleSequence final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Resample Keyframes" ); }
+	QString page() const override final { return Spell::tr( "Animation" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isNiBlock( index, "NiControllerSequence" );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		OptionsDialog dlg;
+		QSpinBox * spnFps = dlg.addInt( Spell::tr( "Frames per second" ), 1, 240, 30 );
+		QDoubleSpinBox * spnTolerance = dlg.addDouble( Spell::tr( "Tolerance (0 keeps a key per frame)" ), 1, 5, 0.0001, 0.0001 );
+
+		if ( !dlg.run() )
+			return index;
+
+		AnimationBaker baker( nif, index );
+		baker.bake( spnFps->value() );
+
+		int written = baker.writeBack( nif, spnTolerance->value() );
+
+		Message::info( nullptr, Spell::tr( "Resampled %1 of %2 interpolators at %3 frames." )
+					   .arg( written ).arg( baker.tracks().count() ).arg( baker.frameCount() ) );
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spResampleSequence );
+
+
+//! One key group of a key data block, reduced by reduceKeys()
+struct KeyReduction
+{
+	//! The array of keys
+	QPersistentModelIndex iKeys;
+	//! The number of keys
+	QPersistentModelIndex iCount;
+
+	KeyData keys;
+	bool rotation = false;
+	float tolerance = 0;
+
+	//! The keys to keep
+	QVector<int> keep;
+};
+
+//! Queue a key group for reduction; only linear and constant keys can be reduced without changing the curve
+static void queueKeys( QVector<KeyReduction> & queue, const QModelIndex & iKeys, const QModelIndex & iCount, const KeyData & keys, float tolerance, bool rotation = false )
+{
+	if ( !iKeys.isValid() || keys.times.count() < 3 )
+		return;
+
+	if ( keys.type != 1 && keys.type != 5 )
+		return;
+
+	KeyReduction r;
+	r.iKeys = iKeys;
+	r.iCount = iCount;
+	r.keys = keys;
+	r.rotation = rotation;
+	r.tolerance = tolerance;
+	queue.append( r );
+}
+
+//! Queue the key groups of a key data block
+static void queueBlock( const NifModel * nif, const QModelIndex & iData, QVector<KeyReduction> & queue, float tolerance, float angle )
+{
+	if ( nif->isNiBlock( iData, QStringList{ "NiKeyframeData", "NiTransformData" } ) ) {
+		KeyData rotations = Controller::decodeKeys<Matrix>( nif, iData );
+
+		if ( rotations.type == 4 ) {
+			QModelIndex iXYZ = nif->getIndex( iData, "XYZ Rotations" );
+
+			for ( int i = 0; iXYZ.isValid() && i < nif->rowCount( iXYZ ); i++ ) {
+				QModelIndex iGroup = iXYZ.child( i, 0 );
+				queueKeys( queue, nif->getIndex( iGroup, "Keys" ), nif->getIndex( iGroup, "Num Keys" ),
+						   Controller::decodeKeys<float>( nif, iGroup ), angle );
+			}
+		} else {
+			queueKeys( queue, nif->getIndex( iData, "Quaternion Keys" ), nif->getIndex( iData, "Num Rotation Keys" ),
+					   rotations, angle, true );
+		}
+
+		QModelIndex iTrans = nif->getIndex( iData, "Translations" );
+		queueKeys( queue, nif->getIndex( iTrans, "Keys" ), nif->getIndex( iTrans, "Num Keys" ),
+				   Controller::decodeKeys<Vector3>( nif, iTrans ), tolerance );
+
+		QModelIndex iScale = nif->getIndex( iData, "Scales" );
+		queueKeys( queue, nif->getIndex( iScale, "Keys" ), nif->getIndex( iScale, "Num Keys" ),
+				   Controller::decodeKeys<float>( nif, iScale ), tolerance );
+	} else if ( nif->isNiBlock( iData, QStringList{ "NiFloatData", "NiPosData" } ) ) {
+		QModelIndex iGroup = nif->getIndex( iData, "Data" );
+		KeyData keys = nif->isNiBlock( iData, "NiPosData" ) ? Controller::decodeKeys<Vector3>( nif, iGroup )
+															  : Controller::decodeKeys<float>( nif, iGroup );
+
+		queueKeys( queue, nif->getIndex( iGroup, "Keys" ), nif->getIndex( iGroup, "Num Keys" ), keys, tolerance );
+	}
+}
+
+/*! Remove the keys of key data blocks that interpolation reproduces within the tolerances
+ *
+ * The keys are decoded first, reduced in parallel and then written back.
+ *
+ * @return The number of keys removed
+ */
+static int reduceKeys( NifModel * nif, const QList<QPersistentModelIndex> & blocks, float tolerance, float angle )
+{
+	QVector<KeyReduction> queue;
+
+	for ( const QModelIndex & iData : blocks )
+		queueBlock( nif, iData, queue, tolerance, angle );
+
+	QtConcurrent::blockingMap( queue, []( KeyReduction & r ) {
+		const KeyData & k = r.keys;
+
+		if ( k.type == 5 ) {
+			// Constant keys only matter where the value changes
+			for ( int i = 0; i < k.times.count(); i++ ) {
+				bool changed = ( i == 0 || i == k.times.count() - 1 );
+
+				for ( int c = 0; c < k.stride && !changed; c++ )
+					changed = qAbs( k.values[i * k.stride + c] - k.values[r.keep.last() * k.stride + c] ) > r.tolerance;
+
+				if ( changed )
+					r.keep.append( i );
+			}
+		} else {
+			r.keep = AnimationBaker::linearKeys( k.times, k.values.constData(), k.stride, r.tolerance, r.rotation );
+		}
+	} );
+
+	int removed = 0;
+
+	for ( const KeyReduction & r : queue ) {
+		if ( r.keep.count() == r.keys.times.count() || !r.iKeys.isValid() )
+			continue;
+
+		// Keys are only removed, so each kept key moves down over a removed one
+		for ( int i = 0; i < r.keep.count(); i++ ) {
+			if ( r.keep[i] == i )
+				continue;
+
+			QModelIndex iDst = r.iKeys.child( i, 0 );
+			QModelIndex iSrc = r.iKeys.child( r.keep[i], 0 );
+
+			for ( int c = 0; c < nif->rowCount( iSrc ); c++ )
+				nif->setValue( iDst.child( c, 0 ), nif->getValue( iSrc.child( c, 0 ) ) );
+		}
+
+		removed += r.keys.times.count() - r.keep.count();
+
+		nif->set<int>( r.iCount, r.keep.count() );
+		nif->updateArray( r.iKeys );
+	}
+
+	return removed;
+}
+
+//! Show the options of the keyframe reduction spells
+static bool reduceOptions( double & tolerance, double & angle, bool * splines = nullptr, int * fps = nullptr )
+{
+	OptionsDialog dlg;
+	QDoubleSpinBox * spnTolerance = dlg.addDouble( Spell::tr( "Positional tolerance" ), 10, 5, 0.0001, tolerance );
+	QDoubleSpinBox * spnAngle = dlg.addDouble( Spell::tr( "Angular tolerance (degrees)" ), 10, 3, 0.01, angle );
+
+	QCheckBox * chkSplines = nullptr;
+	QSpinBox * spnFps = nullptr;
+
+	if ( splines && fps ) {
+		chkSplines = dlg.addCheck( Spell::tr( "Convert transforms to compressed B-splines" ), *splines );
+		spnFps = dlg.addInt( Spell::tr( "B-spline sample rate (frames per second)" ), 1, 240, *fps );
+		spnFps->setEnabled( *splines );
+
+		QObject::connect( chkSplines, &QCheckBox::toggled, spnFps, &QSpinBox::setEnabled );
+	}
+
+	if ( !dlg.run() )
+		return false;
+
+	tolerance = spnTolerance->value();
+	angle = spnAngle->value();
+
+	if ( chkSplines ) {
+		*splines = chkSplines->isChecked();
+		*fps = spnFps->value();
+	}
+
+	return true;
+}
+
+//! Remove redundant keys from a key data block
+class spReduceKeyframes final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Reduce Keyframes" ); }
+	QString page() const override final { return Spell::tr( "Animation" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isNiBlock( index, QStringList{ "NiKeyframeData", "NiTransformData", "NiFloatData", "NiPosData" } );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		double tolerance = 0.0001, angle = 0.01;
+
+		if ( !reduceOptions( tolerance, angle ) )
+			return index;
+
+		int removed = reduceKeys( nif, { index }, tolerance, angle * PI / 180.0 );
+
+		Message::info( nullptr, Spell::tr( "Removed %1 keys." ).arg( removed ) );
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spReduceKeyframes );
+
+//! Remove redundant keys from all key data blocks, optionally converting transforms to B-splines
+class spReduceAllKeyframes final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Reduce All Keyframes" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		double tolerance = 0.0001, angle = 0.01;
+		bool splines = false;
+		int fps = 30;
+
+		if ( !reduceOptions( tolerance, angle, &splines, &fps ) )
+			return QModelIndex();
+
+		float radians = angle * PI / 180.0;
+		int converted = 0;
+
+		if ( splines && nif->checkVersion( 0x14000004, 0 ) ) {
+			QList<int> unused;
+
+			for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+				QModelIndex iSeq = nif->getBlock( n, "NiControllerSequence" );
+
+				if ( !iSeq.isValid() )
+					continue;
+
+				AnimationBaker baker( nif, iSeq );
+				baker.bake( fps );
+				converted += baker.writeSplines( nif, tolerance, radians, &unused );
+			}
+
+			// Remove the key data that no longer has users, last block first
+			std::sort( unused.begin(), unused.end(), std::greater<int>() );
+
+			for ( int b : unused ) {
+				if ( nif->getParent( b ) < 0 )
+					nif->removeNiBlock( b );
+			}
+		}
+
+		QList<QPersistentModelIndex> blocks;
+
+		spReduceKeyframes reduce;
+
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlock( n );
+
+			if ( reduce.isApplicable( nif, idx ) )
+				blocks << idx;
+		}
+
+		int removed = reduceKeys( nif, blocks, tolerance, radians );
+
+		if ( converted > 0 )
+			Message::info( nullptr, Spell::tr( "Converted %1 interpolators to B-splines and removed %2 keys." ).arg( converted ).arg( removed ) );
+		else
+			Message::info( nullptr, Spell::tr( "Removed %1 keys." ).arg( removed ) );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spReduceAllKeyframes );
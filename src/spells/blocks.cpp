@@ -8,6 +8,7 @@
 #include <QMessageBox>
 #include <QMimeData>
 #include <QRegularExpression>
+#include <QSet>
 #include <QSettings>
 
 #include <algorithm> // std::stable_sort
@@ -1685,17 +1686,15 @@ public:
 
 		QRegularExpression exp( match );
 
-		int n = 0;
+		QList<int> remove;
 
-		while ( n < nif->getBlockCount() ) {
-			QModelIndex iBlock = nif->getBlock( n );
-
-			if ( nif->itemName( iBlock ).indexOf( exp ) >= 0 )
-				nif->removeNiBlock( n );
-			else
-				n++;
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			if ( nif->itemName( nif->getBlock( n ) ).indexOf( exp ) >= 0 )
+				remove << n;
 		}
 
+		nif->removeNiBlocks( remove );
+
 		return QModelIndex();
 	}
 };
@@ -1737,19 +1736,17 @@ public:
 		// construct list of block numbers of all blocks in this branch of index
 		QList<quint32> branch = getBranch( nif, nif->getBlockNumber( index ) );
 		//qDebug() << branch;
-		// remove non-branch blocks
-		int n = 0; // tracks the current block number in the new system (after some blocks have been removed already)
-		int m = 0; // tracks the block number in the old system i.e.  as they are numbered in the branch list
+		// remove non-branch blocks in one pass
+		QSet<quint32> keep = branch.toSet();
+		QList<int> remove;
 
-		while ( n < nif->getBlockCount() ) {
-			if ( !branch.contains( m ) )
-				nif->removeNiBlock( n );
-			else
-				n++;
-
-			m++;
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			if ( !keep.contains( n ) )
+				remove << n;
 		}
 
+		nif->removeNiBlocks( remove );
+
 		// done
 		return QModelIndex();
 	}
@@ -1,11 +1,13 @@
 #include "spellbook.h"
 
+#include "gl/gltools.h"
+#include "spells/mesh.h"
 #include "ui/widgets/nifeditors.h"
 
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file bounds.cpp
- * \brief Bounding box editing spells (spEditBounds)
+ * \brief Bounding box editing spells (spEditBounds, spUpdateBSBound)
  *
  * All classes here inherit from the Spell class.
  */
@@ -63,3 +65,59 @@ public:
 };
 
 REGISTER_SPELL( spEditBounds );
+
+//! Recalculate a BSBound from the geometry under its node
+class spUpdateBSBound final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Update" ); }
+	QString page() const override final { return Spell::tr( "Bounds" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isNiBlock( index, "BSBound" );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iNode = nif->getBlock( nif->getParent( nif->getBlockNumber( index ) ), "NiNode" );
+		if ( !iNode.isValid() )
+			return index;
+
+		// The box is in the space of the node holding the BSBound
+		BoundingBox box;
+		collect( nif, iNode, Transform(), box );
+
+		if ( box.isEmpty() )
+			return index;
+
+		nif->set<Vector3>( index, "Center", box.center() );
+		nif->set<Vector3>( index, "Dimensions", box.extents() );
+
+		return index;
+	}
+
+	static void collect( const NifModel * nif, const QModelIndex & iBlock, const Transform & t, BoundingBox & box )
+	{
+		QVector<Vector3> verts;
+		if ( nif->inherits( iBlock, "NiTriBasedGeom" ) )
+			verts = nif->getArray<Vector3>( nif->getBlock( nif->getLink( iBlock, "Data" ) ), "Vertices" );
+		else if ( nif->inherits( iBlock, "BSTriShape" ) )
+			verts = spUpdateBounds::vertices( nif, iBlock );
+
+		for ( const Vector3 & v : verts )
+			box |= t * v;
+
+		if ( !nif->inherits( iBlock, "NiNode" ) )
+			return;
+
+		int parent = nif->getBlockNumber( iBlock );
+		for ( const auto link : nif->getChildLinks( parent ) ) {
+			QModelIndex iChild = nif->getBlock( link, "NiAVObject" );
+			if ( iChild.isValid() && nif->getParent( link ) == parent )
+				collect( nif, iChild, t * Transform( nif, iChild ), box );
+		}
+	}
+};
+
+REGISTER_SPELL( spUpdateBSBound );
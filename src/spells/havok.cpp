@@ -50,49 +50,50 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ) );
-		if ( !iData.isValid() )
-			iData = nif->getIndex( index, "Vertex Data" );
-
-		if ( !iData.isValid() )
+		Options opts;
+		if ( !options( opts ) )
 			return index;
 
-		float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
-
-		havokScale *= havokConst;
+		QVector<Hull> hulls = { extract( nif, index ) };
+		if ( !build( hulls, opts ) )
+			return index;
 
-		/* those will be filled with the CVS data */
-		QVector<Vector4> convex_verts, convex_norms;
+		nif->beginTransaction();
+		QPersistentModelIndex iCVS = createShape( nif, hulls[0], opts );
+		QModelIndex iRigidBody = attach( nif, nif->getBlock( nif->getParent( nif->getBlockNumber( index ) ) ),
+		                                 { nif->getBlockNumber( iCVS ) } );
+		nif->commitTransaction();
 
-		/* get the verts of our mesh */
-		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-		QVector<Vector3> vertsTrans;
+		Message::info( nullptr,
+					   Spell::tr( "Created hull with %1 vertices, %2 normals." )
+						.arg( hulls[0].verts.count() )
+						.arg( hulls[0].norms.count() )
+		);
 
-		if ( nif->getUserVersion2() < 100 ) {
-			verts = nif->getArray<Vector3>( iData, "Vertices" );
-		} else {
-			int numVerts = nif->get<int>( index, "Num Vertices" );
-			verts.reserve( numVerts );
-			for ( int i = 0; i < numVerts; i++ )
-				verts += nif->get<Vector3>( nif->index( i, 0, iData ), "Vertex" );
-		}
+		return (iCVS.isValid()) ? QModelIndex( iCVS ) : iRigidBody;
+	}
 
-		// Offset by translation of NiTriShape
-		Vector3 trans = nif->get<Vector3>( index, "Translation" );
-		Matrix rot = nif->get<Matrix>( index, "Rotation" );
-		float scale = nif->get<float>( index, "Scale" );
-		Transform transform;
-		transform.translation = trans;
-		transform.rotation = rot;
-		transform.scale = scale;
+	//! Hull settings chosen by the user
+	struct Options
+	{
+		float precision = 0.25f;
+		float radius = 0.005f;
+		quint32 material = 0;
+	};
 
-		for ( auto v : verts ) {
-			vertsTrans.append( transform * v );
-		}
+	//! A single hull, gathered on the GUI thread and built on the thread pool
+	struct Hull
+	{
+		QVector<Vector3> points;
+		float havokScale = havokConst;
 
-		// to store results
-		QVector<Vector4> hullVerts, hullNorms;
+		QVector<Vector4> verts;
+		QVector<Vector4> norms;
+	};
 
+	//! Asks for the precision, radius and material of the hulls
+	static bool options( Options & opts )
+	{
 		// ask for precision
 		QDialog dlg;
 		QVBoxLayout * vbox = new QVBoxLayout;
@@ -171,69 +172,131 @@ public:
 		QObject::connect( ok, &QPushButton::clicked, &dlg, &QDialog::accept );
 		QObject::connect( cancel, &QPushButton::clicked, &dlg, &QDialog::reject );
 
-		if ( dlg.exec() != QDialog::Accepted ) {
-			return index;
-		}
+		if ( dlg.exec() != QDialog::Accepted )
+			return false;
 
-		/* make a convex hull from it */
-		compute_convex_hull( vertsTrans, hullVerts, hullNorms, (float)precSpin->value() );
+		opts.precision = (float)precSpin->value();
+		opts.radius = (float)spnRadius->value();
+		opts.material = matValues.at( cmbOptions->currentIndex() );
+		return true;
+	}
 
-		// sort and remove duplicate vertices
-		QList<Vector4> sortedVerts;
-		for ( Vector4 vert : hullVerts ) {
-			vert /= havokScale;
+	//! Gathers the vertices of a shape, offset by its transform
+	static Hull extract( const NifModel * nif, const QModelIndex & index )
+	{
+		Hull hull;
 
-			if ( !sortedVerts.contains( vert ) ) {
-				sortedVerts.append( vert );
-			}
-		}
-		std::sort( sortedVerts.begin(), sortedVerts.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> vertIter( sortedVerts );
+		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ) );
+		if ( !iData.isValid() )
+			iData = nif->getIndex( index, "Vertex Data" );
 
-		while ( vertIter.hasNext() ) {
-			Vector4 sorted = vertIter.next();
-			convex_verts.append( sorted );
-		}
+		if ( !iData.isValid() )
+			return hull;
 
-		// sort and remove duplicate normals
-		QList<Vector4> sortedNorms;
-		for ( Vector4 norm : hullNorms ) {
-			norm = Vector4( Vector3( norm ), norm[3] / havokScale );
+		if ( nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12 )
+			hull.havokScale *= 10.0f;
 
-			if ( !sortedNorms.contains( norm ) ) {
-				sortedNorms.append( norm );
-			}
-		}
-		std::sort( sortedNorms.begin(), sortedNorms.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> normIter( sortedNorms );
+		/* get the verts of our mesh */
+		QVector<Vector3> verts;
 
-		while ( normIter.hasNext() ) {
-			Vector4 sorted = normIter.next();
-			convex_norms.append( sorted );
+		if ( nif->getUserVersion2() < 100 ) {
+			verts = nif->getArray<Vector3>( iData, "Vertices" );
+		} else {
+			int numVerts = nif->get<int>( index, "Num Vertices" );
+			verts.reserve( numVerts );
+			for ( int i = 0; i < numVerts; i++ )
+				verts += nif->get<Vector3>( nif->index( i, 0, iData ), "Vertex" );
 		}
 
+		// Offset by translation of NiTriShape
+		Transform transform;
+		transform.translation = nif->get<Vector3>( index, "Translation" );
+		transform.rotation = nif->get<Matrix>( index, "Rotation" );
+		transform.scale = nif->get<float>( index, "Scale" );
+
+		hull.points.reserve( verts.count() );
+		for ( const auto & v : verts )
+			hull.points.append( transform * v );
+
+		return hull;
+	}
+
+	//! Builds the hulls in the background
+	/*!
+	 * Qhull itself is serialized by compute_convex_hull(); the scaling and
+	 * deduplication of its output still run in parallel.
+	 *
+	 * \return False if the user cancelled
+	 */
+	static bool build( QVector<Hull> & hulls, const Options & opts )
+	{
+		Hull * data = hulls.data();
+		float precision = opts.precision;
+
+		return Spell::runJobs( Spell::tr( "Computing convex hulls..." ), hulls.count(), [data, precision]( int i ) {
+			Hull & hull = data[i];
+			if ( hull.points.isEmpty() )
+				return;
+
+			QVector<Vector4> hullVerts, hullNorms;
+			compute_convex_hull( hull.points, hullVerts, hullNorms, precision );
+
+			for ( Vector4 & v : hullVerts )
+				v /= hull.havokScale;
+
+			for ( Vector4 & n : hullNorms )
+				n = Vector4( Vector3( n ), n[3] / hull.havokScale );
+
+			// sort and remove duplicates
+			auto unique = []( QVector<Vector4> & list ) {
+				std::sort( list.begin(), list.end(), Vector4::lexLessThan );
+				list.erase( std::unique( list.begin(), list.end() ), list.end() );
+			};
+
+			unique( hullVerts );
+			unique( hullNorms );
+
+			hull.verts = hullVerts;
+			hull.norms = hullNorms;
+		} );
+	}
+
+	//! Creates the bhkConvexVerticesShape for a built hull
+	static QModelIndex createShape( NifModel * nif, const Hull & hull, const Options & opts )
+	{
 		/* create the CVS block */
 		QModelIndex iCVS = nif->insertNiBlock( "bhkConvexVerticesShape" );
 
 		/* set CVS material */
-		int mat = matValues.at( cmbOptions->currentIndex() );
-		nif->set<int>( iCVS, "Material", mat );
+		nif->set<int>( iCVS, "Material", opts.material );
 
 		/* set CVS verts */
-		nif->set<uint>( iCVS, "Num Vertices", convex_verts.count() );
+		nif->set<uint>( iCVS, "Num Vertices", hull.verts.count() );
 		nif->updateArray( iCVS, "Vertices" );
-		nif->setArray<Vector4>( iCVS, "Vertices", convex_verts );
+		nif->setArray<Vector4>( iCVS, "Vertices", hull.verts );
 
 		/* set CVS norms */
-		nif->set<uint>( iCVS, "Num Normals", convex_norms.count() );
+		nif->set<uint>( iCVS, "Num Normals", hull.norms.count() );
 		nif->updateArray( iCVS, "Normals" );
-		nif->setArray<Vector4>( iCVS, "Normals", convex_norms );
+		nif->setArray<Vector4>( iCVS, "Normals", hull.norms );
 
 		// radius is always 0.1?
 		// TODO: Figure out if radius is not arbitrarily set in vanilla NIFs
-		nif->set<float>( iCVS, "Radius", spnRadius->value() );
+		nif->set<float>( iCVS, "Radius", opts.radius );
 
-		QModelIndex iParent = nif->getBlock( nif->getParent( nif->getBlockNumber( index ) ) );
+		return iCVS;
+	}
+
+	//! Links new shapes into the collision object of a node
+	/*!
+	 * Creates the collision object and rigid body if needed. If the body
+	 * already has a shape, the user decides whether to combine into a list
+	 * shape or to replace it. Several new shapes always end up in a list.
+	 *
+	 * \return The rigid body
+	 */
+	static QModelIndex attach( NifModel * nif, const QModelIndex & iParent, const QVector<qint32> & newLinks )
+	{
 		QModelIndex collisionLink = nif->getIndex( iParent, "Collision Object" );
 		QModelIndex collisionObject = nif->getBlock( nif->getLink( collisionLink ) );
 
@@ -246,7 +309,7 @@ public:
 		}
 
 		QModelIndex rigidBodyLink = nif->getIndex( collisionObject, "Body" );
-		QModelIndex rigidBody = nif->getBlock( nif->getLink( rigidBodyLink ) );
+		QPersistentModelIndex rigidBody = nif->getBlock( nif->getLink( rigidBodyLink ) );
 
 		// create bhkRigidBody
 		if ( !rigidBody.isValid() ) {
@@ -258,10 +321,17 @@ public:
 		QPersistentModelIndex shapeLink = nif->getIndex( rigidBody, "Shape" );
 		QPersistentModelIndex shape = nif->getBlock( nif->getLink( shapeLink ) );
 
-		QVector<qint32> shapeLinks;
+		auto setListShape = [nif]( const QModelIndex & iListShape, const QVector<qint32> & shapeLinks ) {
+			nif->set<uint>( iListShape, "Num Sub Shapes", shapeLinks.size() );
+			nif->updateArray( iListShape, "Sub Shapes" );
+			nif->setLinkArray( iListShape, "Sub Shapes", shapeLinks );
+			nif->set<uint>( iListShape, "Num Unknown Ints", shapeLinks.size() );
+			nif->updateArray( iListShape, "Unknown Ints" );
+		};
+
 		bool replace = true;
 		if ( shape.isValid() ) {
-			shapeLinks = { nif->getBlockNumber( shape ) };
+			QVector<qint32> shapeLinks = { nif->getBlockNumber( shape ) };
 
 			QString questionTitle = tr( "Create List Shape" );
 			QString questionBody = tr( "This collision object already has a shape. Combine into a list shape? 'No' will replace the shape." );
@@ -282,36 +352,95 @@ public:
 					nif->setLink( shapeLink, nif->getBlockNumber( iListShape ) );
 				}
 
-				shapeLinks << nif->getBlockNumber( iCVS );
-				nif->set<uint>( iListShape, "Num Sub Shapes", shapeLinks.size() );
-				nif->updateArray( iListShape, "Sub Shapes" );
-				nif->setLinkArray( iListShape, "Sub Shapes", shapeLinks );
-				nif->set<uint>( iListShape, "Num Unknown Ints", shapeLinks.size() );
-				nif->updateArray( iListShape, "Unknown Ints" );
+				setListShape( iListShape, shapeLinks + newLinks );
 				replace = false;
 			}
-		} 
-		
+		}
+
 		if ( replace ) {
 			// Replace link
-			nif->setLink( shapeLink, nif->getBlockNumber( iCVS ) );
+			if ( newLinks.count() == 1 ) {
+				nif->setLink( shapeLink, newLinks.first() );
+			} else {
+				QModelIndex iListShape = nif->insertNiBlock( "bhkListShape" );
+				nif->setLink( shapeLink, nif->getBlockNumber( iListShape ) );
+				setListShape( iListShape, newLinks );
+			}
 			// Remove all old shapes
 			spRemoveBranch rm;
 			rm.castIfApplicable( nif, shape );
 		}
 
-		Message::info( nullptr,
-					   Spell::tr( "Created hull with %1 vertices, %2 normals." )
-						.arg( convex_verts.count() )
-						.arg( convex_norms.count() ) 
-		);
-
-		return (iCVS.isValid()) ? iCVS : rigidBody;
+		return rigidBody;
 	}
 };
 
 REGISTER_SPELL( spCreateCVS );
 
+//! Creates a convex hull for every shape under a node
+class spCreateAllCVS final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Create Convex Shapes" ); }
+	QString page() const override final { return Spell::tr( "Havok" ); }
+
+	static QList<QPersistentModelIndex> shapes( const NifModel * nif, const QModelIndex & index )
+	{
+		QList<QPersistentModelIndex> list;
+
+		spCreateCVS cvs;
+		for ( const auto link : nif->getChildLinks( nif->getBlockNumber( index ) ) ) {
+			QModelIndex iChild = nif->getBlock( link );
+			if ( cvs.isApplicable( nif, iChild ) )
+				list << iChild;
+		}
+
+		return list;
+	}
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->inherits( index, "NiNode" ) && !shapes( nif, index ).isEmpty();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		spCreateCVS::Options opts;
+		if ( !spCreateCVS::options( opts ) )
+			return index;
+
+		QList<QPersistentModelIndex> iShapes = shapes( nif, index );
+
+		QVector<spCreateCVS::Hull> hulls;
+		hulls.reserve( iShapes.count() );
+		for ( const auto & iShape : iShapes )
+			hulls << spCreateCVS::extract( nif, iShape );
+
+		if ( !spCreateCVS::build( hulls, opts ) )
+			return index;
+
+		QPersistentModelIndex iNode = index;
+
+		nif->beginTransaction();
+		QVector<qint32> links;
+		for ( const auto & hull : hulls ) {
+			if ( !hull.verts.isEmpty() )
+				links << nif->getBlockNumber( spCreateCVS::createShape( nif, hull, opts ) );
+		}
+
+		QModelIndex iRigidBody;
+		if ( !links.isEmpty() )
+			iRigidBody = spCreateCVS::attach( nif, iNode, links );
+		nif->commitTransaction();
+
+		Message::info( nullptr, Spell::tr( "Created %1 hulls from %2 shapes." ).arg( links.count() ).arg( iShapes.count() ) );
+
+		return iRigidBody.isValid() ? iRigidBody : QModelIndex( iNode );
+	}
+};
+
+REGISTER_SPELL( spCreateAllCVS );
+
 //! Transforms Havok constraints
 class spConstraintHelper final : public Spell
 {
@@ -1,8 +1,13 @@
 #include "mesh.h"
 #include "gl/gltools.h"
+#include "gl/gltools/vertexweld.h"
 
 #include <QDialog>
+#include <QDoubleSpinBox>
 #include <QGridLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <cfloat>
 
@@ -49,13 +54,88 @@ static QModelIndex getTriShapeData( const NifModel * nif, const QModelIndex & in
 	return QModelIndex();
 }
 
-//! Removes elements of the specified type from an array
-template <typename T> static void removeFromArray( QVector<T> & array, QMap<quint16, bool> map )
+//! Moves the elements kept by a remap to their new index and removes the others
+template <typename T> static void removeFromArray( QVector<T> & array, const QVector<int> & remap, int count )
 {
-	for ( int x = array.count() - 1; x >= 0; x-- ) {
-		if ( !map.contains( x ) )
-			array.remove( x );
+	if ( array.count() != remap.count() )
+		return;
+
+	for ( int x = 0; x < remap.count(); x++ ) {
+		if ( remap[x] >= 0 )
+			array[remap[x]] = array[x];
+	}
+
+	array.resize( count );
+}
+
+//! Copies the values of a branch to a branch of the same type
+static void copyBranch( NifModel * nif, const QModelIndex & iSrc, const QModelIndex & iDst )
+{
+	int rows = nif->rowCount( iSrc );
+
+	if ( rows == 0 ) {
+		nif->setValue( iDst, nif->getValue( iSrc ) );
+		return;
+	}
+
+	for ( int r = 0; r < rows; r++ )
+		copyBranch( nif, iSrc.child( r, 0 ), iDst.child( r, 0 ) );
+}
+
+//! Finds the NiSkinPartition of a shape
+static QModelIndex getSkinPartition( const NifModel * nif, const QModelIndex & iShape )
+{
+	QModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+	QModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
+
+	QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
+
+	if ( !iSkinPart.isValid() )
+		iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
+
+	return iSkinPart;
+}
+
+/*! Reads the NiSkinData weights of a shape as a vertex attribute for VertexWeld
+ *
+ * @param[out] width	Number of floats per vertex, 0 if the shape is not skinned
+ * @return				The (bone, weight) pairs of every vertex sorted by bone, padded with -1
+ */
+static QVector<float> getSkinWeights( const NifModel * nif, const QModelIndex & iShape, int numVerts, int & width )
+{
+	QModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+	QModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
+	QModelIndex iBones = nif->getIndex( iSkinData, "Bone List" );
+
+	QVector<QVector<QPair<int, float>>> influences( numVerts );
+	int most = 0;
+
+	// Bones are visited in order, so the influences of each vertex are sorted by bone
+	for ( int b = 0; b < nif->rowCount( iBones ); b++ ) {
+		QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
+
+		for ( int w = 0; w < nif->rowCount( iWeights ); w++ ) {
+			int v = nif->get<int>( iWeights.child( w, 0 ), "Index" );
+
+			if ( v >= 0 && v < numVerts ) {
+				influences[v].append( { b, nif->get<float>( iWeights.child( w, 0 ), "Weight" ) } );
+				most = qMax( most, influences[v].count() );
+			}
+		}
+	}
+
+	width = most * 2;
+
+	QVector<float> weights( numVerts * width, -1.0f );
+
+	for ( int v = 0; v < numVerts; v++ ) {
+		for ( int i = 0; i < influences[v].count(); i++ ) {
+			weights[v * width + i * 2] = influences[v][i].first;
+			weights[v * width + i * 2 + 1] = influences[v][i].second;
+		}
 	}
+
+	return weights;
 }
 
 //! Removes waste vertices from the specified data and shape
@@ -94,12 +174,13 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 
 		// detect unused vertices
 
-		QMap<quint16, bool> used;
+		QVector<bool> used( numVerts, false );
 
 		QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
 		for ( const Triangle& tri : tris ) {
 			for ( int t = 0; t < 3; t++ ) {
-				used.insert( tri[t], true );
+				if ( tri[t] < numVerts )
+					used[tri[t]] = true;
 			}
 		}
 
@@ -109,54 +190,48 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 		for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
 			strips << nif->getArray<quint16>( iPoints.child( r, 0 ) );
 			for ( const auto p : strips.last() ) {
-				used.insert( p, true );
+				if ( p < numVerts )
+					used[p] = true;
 			}
 		}
 
+		// number the used vertices
+
+		QVector<int> map( numVerts, -1 );
+		int numUsed = 0;
+
+		for ( int x = 0; x < numVerts; x++ ) {
+			if ( used[x] )
+				map[x] = numUsed++;
+		}
+
 		// remove them
 
-		Message::info( nullptr, Spell::tr( "Removed %1 vertices." ).arg( verts.count() - used.count() ) );
+		Message::info( nullptr, Spell::tr( "Removed %1 vertices." ).arg( numVerts - numUsed ) );
 
-		if ( verts.count() == used.count() )
+		if ( numVerts == numUsed )
 			return;
 
-		removeFromArray( verts, used );
-		removeFromArray( norms, used );
-		removeFromArray( colors, used );
+		removeFromArray( verts, map, numUsed );
+		removeFromArray( norms, map, numUsed );
+		removeFromArray( colors, map, numUsed );
 
 		for ( int c = 0; c < texco.count(); c++ )
-			removeFromArray( texco[c], used );
+			removeFromArray( texco[c], map, numUsed );
 
 		// adjust the faces
 
-		QMap<quint16, quint16> map;
-		quint16 y = 0;
-
-		for ( quint16 x = 0; x < numVerts; x++ ) {
-			if ( used.contains( x ) )
-				map.insert( x, y++ );
-		}
-
-		QMutableVectorIterator<Triangle> itri( tris );
-
-		while ( itri.hasNext() ) {
-			Triangle & tri = itri.next();
-
+		for ( Triangle & tri : tris ) {
 			for ( int t = 0; t < 3; t++ ) {
-				if ( map.contains( tri[t] ) )
+				if ( tri[t] < numVerts )
 					tri[t] = map[ tri[t] ];
 			}
-
 		}
 
-		QMutableListIterator<QVector<quint16> > istrip( strips );
-
-		while ( istrip.hasNext() ) {
-			QVector<quint16> & strip = istrip.next();
-
-			for ( int s = 0; s < strip.size(); s++ ) {
-				if ( map.contains( strip[s] ) )
-					strip[s] = map[ strip[s] ];
+		for ( QVector<quint16> & strip : strips ) {
+			for ( quint16 & p : strip ) {
+				if ( p < numVerts )
+					p = map[ p ];
 			}
 		}
 
@@ -192,21 +267,10 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 			QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
 
 			for ( int w = 0; w < nif->rowCount( iWeights ); w++ ) {
-				weights.append( QPair<int, float>( nif->get<int>( iWeights.child( w, 0 ), "Index" ), nif->get<float>( iWeights.child( w, 0 ), "Weight" ) ) );
-			}
+				int x = nif->get<int>( iWeights.child( w, 0 ), "Index" );
 
-			for ( int x = weights.count() - 1; x >= 0; x-- ) {
-				if ( !used.contains( weights[x].first ) )
-					weights.remove( x );
-			}
-
-			QMutableVectorIterator<QPair<int, float> > it( weights );
-
-			while ( it.hasNext() ) {
-				QPair<int, float> & w = it.next();
-
-				if ( map.contains( w.first ) )
-					w.first = map[ w.first ];
+				if ( x >= 0 && x < numVerts && map[x] >= 0 )
+					weights.append( QPair<int, float>( map[x], nif->get<float>( iWeights.child( w, 0 ), "Weight" ) ) );
 			}
 
 			nif->set<int>( iBones.child( b, 0 ), "Num Vertices", weights.count() );
@@ -220,14 +284,39 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 
 		// process NiSkinPartition
 
-		QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
-
-		if ( !iSkinPart.isValid() )
-			iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
+		QModelIndex iSkinPart = getSkinPartition( nif, iShape );
 
 		if ( iSkinPart.isValid() ) {
-			nif->removeNiBlock( nif->getBlockNumber( iSkinPart ) );
-			Message::warning( nullptr, Spell::tr( "The skin partition was removed, please regenerate it with the skin partition spell." ) );
+			// The partitions stay valid if all their vertices are still used
+			QModelIndex iParts = nif->getIndex( iSkinPart, "Partitions" );
+			QList<QVector<int>> vertexMaps;
+			bool remapped = iParts.isValid();
+
+			for ( int p = 0; p < nif->rowCount( iParts ) && remapped; p++ ) {
+				QModelIndex iPart = iParts.child( p, 0 );
+				QVector<int> vertmap = nif->getArray<int>( iPart, "Vertex Map" );
+
+				remapped = ( vertmap.count() == nif->get<int>( iPart, "Num Vertices" ) );
+
+				for ( int & v : vertmap ) {
+					if ( v < 0 || v >= numVerts || map[v] < 0 ) {
+						remapped = false;
+						break;
+					}
+
+					v = map[v];
+				}
+
+				vertexMaps << vertmap;
+			}
+
+			if ( remapped ) {
+				for ( int p = 0; p < vertexMaps.count(); p++ )
+					nif->setArray<int>( nif->getIndex( iParts.child( p, 0 ), "Vertex Map" ), vertexMaps[p] );
+			} else {
+				nif->removeNiBlock( nif->getBlockNumber( iSkinPart ) );
+				Message::warning( nullptr, Spell::tr( "The skin partition was removed, please regenerate it with the skin partition spell." ) );
+			}
 		}
 	}
 	catch ( QString & e )
@@ -236,6 +325,131 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 	}
 }
 
+//! Find BSTriShape geometry which stores its vertices on the shape
+static QModelIndex getBSShape( const NifModel * nif, const QModelIndex & index )
+{
+	QModelIndex iShape = nif->getBlock( index );
+
+	// Dynamic shapes keep a second vertex array which is not handled; skinned SSE shapes store the vertices on the partition
+	if ( nif->inherits( iShape, "BSTriShape" ) && !nif->isNiBlock( iShape, "BSDynamicTriShape" )
+	     && nif->get<int>( iShape, "Data Size" ) > 0 && nif->getIndex( iShape, "Vertex Data" ).isValid() )
+		return iShape;
+
+	return QModelIndex();
+}
+
+/*! Welds the duplicate vertices of a BSTriShape and removes the unused vertices
+ *
+ * @param epsilon	Position tolerance, see VertexWeld; 0 welds exact duplicates only
+ * @return			The number of vertices removed
+ */
+static int weldBSVertices( NifModel * nif, const QModelIndex & iShape, float epsilon )
+{
+	QModelIndex iVertData = nif->getIndex( iShape, "Vertex Data" );
+	int numVerts = nif->get<int>( iShape, "Num Vertices" );
+
+	if ( numVerts == 0 )
+		throw QString( Spell::tr( "No vertices" ) );
+
+	if ( nif->rowCount( iVertData ) < numVerts )
+		throw QString( Spell::tr( "Vertex array size differs" ) );
+
+	// read the data
+
+	QVector<Vector3> verts, norms, tangents;
+	QVector<Vector2> coords;
+	QVector<Color4> colors;
+	QVector<float> skin;
+
+	for ( int i = 0; i < numVerts; i++ ) {
+		QModelIndex idx = iVertData.child( i, 0 );
+
+		verts << nif->get<Vector3>( idx, "Vertex" );
+		coords << nif->get<HalfVector2>( idx, "UV" );
+		norms << nif->get<ByteVector3>( idx, "Normal" );
+		tangents << nif->get<ByteVector3>( idx, "Tangent" );
+
+		QModelIndex vcIdx = nif->getIndex( idx, "Vertex Colors" );
+		if ( vcIdx.isValid() )
+			colors << nif->get<ByteColor4>( vcIdx );
+
+		QModelIndex iWeights = nif->getIndex( idx, "Bone Weights" );
+		if ( iWeights.isValid() ) {
+			QVector<float> wts = nif->getArray<float>( iWeights );
+			QVector<quint8> bns = nif->getArray<quint8>( idx, "Bone Indices" );
+
+			for ( int b = 0; b < 4; b++ ) {
+				skin << ( b < wts.count() ? wts[b] : 0.0f );
+				skin << ( b < bns.count() ? float( bns[b] ) : 0.0f );
+			}
+		}
+	}
+
+	// detect the duplicates
+
+	VertexWeld weld( numVerts );
+	weld.addAttribute( verts, epsilon );
+	weld.addAttribute( coords );
+	weld.addAttribute( norms );
+	weld.addAttribute( tangents );
+	weld.addAttribute( colors );
+
+	if ( skin.count() == numVerts * 8 )
+		weld.addAttribute( skin.constData(), 8 );
+
+	QVector<int> welded = weld.weld();
+
+	// adjust the faces and find the used vertices
+
+	QVector<Triangle> tris = nif->getArray<Triangle>( iShape, "Triangles" );
+	QVector<bool> used( numVerts, false );
+
+	for ( Triangle & tri : tris ) {
+		for ( int t = 0; t < 3; t++ ) {
+			if ( tri[t] < numVerts ) {
+				tri[t] = welded[tri[t]];
+				used[tri[t]] = true;
+			}
+		}
+	}
+
+	QVector<int> map( numVerts, -1 );
+	int numUsed = 0;
+
+	for ( int x = 0; x < numVerts; x++ ) {
+		if ( used[x] )
+			map[x] = numUsed++;
+	}
+
+	if ( numUsed == numVerts )
+		return 0;
+
+	for ( Triangle & tri : tris ) {
+		for ( int t = 0; t < 3; t++ ) {
+			if ( tri[t] < numVerts )
+				tri[t] = map[tri[t]];
+		}
+	}
+
+	// move the used vertices down, each to an index not above its own
+
+	for ( int x = 0; x < numVerts; x++ ) {
+		if ( map[x] >= 0 && map[x] != x )
+			copyBranch( nif, iVertData.child( x, 0 ), iVertData.child( map[x], 0 ) );
+	}
+
+	// write back the data
+
+	nif->set<int>( iShape, "Num Vertices", numUsed );
+	nif->updateArray( iVertData );
+	nif->setArray<Triangle>( iShape, "Triangles", tris );
+
+	auto desc = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+	nif->set<uint>( iShape, "Data Size", desc.GetVertexSize() * numUsed + 6 * nif->get<uint>( iShape, "Num Triangles" ) );
+
+	return numVerts - numUsed;
+}
+
 //! Flip texture UV coordinates
 class spFlipTexCoords final : public Spell
 {
@@ -455,127 +669,139 @@ public:
 
 REGISTER_SPELL( spPruneRedundantTriangles );
 
-//! Removes duplicate vertices from a mesh
-class spRemoveDuplicateVertices final : public Spell
+/*! Welds the duplicate vertices of a mesh and removes the unused vertices
+ *
+ * Vertices are only welded if their position, normal, color, UV sets and skin
+ * weights are equal; positions closer than epsilon count as equal.
+ */
+static void weldVertices( NifModel * nif, const QModelIndex & index, float epsilon )
 {
-public:
-	QString name() const override final { return Spell::tr( "Remove Duplicate Vertices" ); }
-	QString page() const override final { return Spell::tr( "Mesh" ); }
-
-	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	try
 	{
-		return getShape( nif, index ).isValid();
-	}
+		QModelIndex iBSShape = getBSShape( nif, index );
 
-	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
-	{
-		try
-		{
-			QModelIndex iShape = getShape( nif, index );
-			QModelIndex iData  = nif->getBlock( nif->getLink( iShape, "Data" ) );
+		if ( iBSShape.isValid() ) {
+			int removed = weldBSVertices( nif, iBSShape, epsilon );
+			Message::info( nullptr, Spell::tr( "Removed %1 vertices." ).arg( removed ) );
+			return;
+		}
 
-			// read the data
+		QModelIndex iShape = getShape( nif, index );
+		QModelIndex iData  = nif->getBlock( nif->getLink( iShape, "Data" ) );
 
-			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+		// read the data
 
-			if ( !verts.count() )
-				throw QString( Spell::tr( "No vertices" ) );
+		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
 
-			QVector<Vector3> norms = nif->getArray<Vector3>( iData, "Normals" );
-			QVector<Color4> colors = nif->getArray<Color4>( iData, "Vertex Colors" );
-			QList<QVector<Vector2> > texco;
-			QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
+		if ( !verts.count() )
+			throw QString( Spell::tr( "No vertices" ) );
 
-			for ( int r = 0; r < nif->rowCount( iUVSets ); r++ ) {
-				texco << nif->getArray<Vector2>( iUVSets.child( r, 0 ) );
+		QVector<Vector3> norms = nif->getArray<Vector3>( iData, "Normals" );
+		QVector<Color4> colors = nif->getArray<Color4>( iData, "Vertex Colors" );
+		QList<QVector<Vector2> > texco;
+		QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
 
-				if ( texco.last().count() != verts.count() )
-					throw QString( Spell::tr( "UV array size differs" ) );
-			}
+		for ( int r = 0; r < nif->rowCount( iUVSets ); r++ ) {
+			texco << nif->getArray<Vector2>( iUVSets.child( r, 0 ) );
 
-			int numVerts = verts.count();
+			if ( texco.last().count() != verts.count() )
+				throw QString( Spell::tr( "UV array size differs" ) );
+		}
 
-			if ( numVerts != nif->get<int>( iData, "Num Vertices" )
-			     || ( norms.count() && norms.count() != numVerts )
-			     || ( colors.count() && colors.count() != numVerts ) )
-			{
-				throw QString( Spell::tr( "Vertex array size differs" ) );
-			}
+		int numVerts = verts.count();
 
-			// detect the dublicates
+		if ( numVerts != nif->get<int>( iData, "Num Vertices" )
+		     || ( norms.count() && norms.count() != numVerts )
+		     || ( colors.count() && colors.count() != numVerts ) )
+		{
+			throw QString( Spell::tr( "Vertex array size differs" ) );
+		}
 
-			QMap<quint16, quint16> map;
+		// detect the duplicates
 
-			for ( int a = 0; a < numVerts; a++ ) {
-				Vector3 v = verts[a];
+		VertexWeld weld( numVerts );
+		weld.addAttribute( verts, epsilon );
+		weld.addAttribute( norms );
+		weld.addAttribute( colors );
 
-				for ( int b = 0; b < a; b++ ) {
-					if ( !( v == verts[b] ) )
-						continue;
+		for ( const auto & uv : texco )
+			weld.addAttribute( uv );
 
-					if ( norms.count() && !( norms[a] == norms[b] ) )
-						continue;
+		int width = 0;
+		QVector<float> weights = getSkinWeights( nif, iShape, numVerts, width );
 
-					if ( colors.count() && !( colors[a] == colors[b] ) )
-						continue;
+		if ( width > 0 )
+			weld.addAttribute( weights.constData(), width );
 
-					int t = 0;
+		QVector<int> welded = weld.weld();
 
-					for ( t = 0; t < texco.count(); t++ ) {
-						if ( !( texco[t][a] == texco[t][b] ) )
-							break;
-					}
+		// adjust the faces
 
-					if ( t < texco.count() )
-						continue;
+		QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
 
-					map.insert( b, a );
-				}
+		for ( Triangle & t : tris ) {
+			for ( int p = 0; p < 3; p++ ) {
+				if ( t[p] < numVerts )
+					t[p] = welded[t[p]];
 			}
+		}
 
-			//qDebug() << QString( Spell::tr("detected % duplicates") ).arg( map.count() );
+		nif->setArray<Triangle>( iData, "Triangles", tris );
 
-			// adjust the faces
+		QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
-			QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
-			QMutableVectorIterator<Triangle> itri( tris );
+		for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
+			QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( r, 0 ) );
 
-			while ( itri.hasNext() ) {
-				Triangle & t = itri.next();
+			for ( quint16 & p : strip ) {
+				if ( p < numVerts )
+					p = welded[p];
+			}
 
-				for ( int p = 0; p < 3; p++ ) {
-					if ( map.contains( t[p] ) )
-						t[p] = map.value( t[p] );
-				}
+			nif->setArray<quint16>( iPoints.child( r, 0 ), strip );
+		}
 
-			}
+		// the skin partitions refer to the welded vertices too
 
-			nif->setArray<Triangle>( iData, "Triangles", tris );
+		QModelIndex iParts = nif->getIndex( getSkinPartition( nif, iShape ), "Partitions" );
 
-			QModelIndex iPoints = nif->getIndex( iData, "Points" );
+		for ( int p = 0; p < nif->rowCount( iParts ); p++ ) {
+			QModelIndex iVertexMap = nif->getIndex( iParts.child( p, 0 ), "Vertex Map" );
+			QVector<int> vertmap = nif->getArray<int>( iVertexMap );
 
-			for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
-				QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( r, 0 ) );
-				QMutableVectorIterator<quint16> istrp( strip );
+			for ( int & v : vertmap ) {
+				if ( v >= 0 && v < numVerts )
+					v = welded[v];
+			}
 
-				while ( istrp.hasNext() ) {
-					quint16 & p = istrp.next();
+			nif->setArray<int>( iVertexMap, vertmap );
+		}
 
-					if ( map.contains( p ) )
-						p = map.value( p );
-				}
+		// finally, remove the now unused vertices
 
-				nif->setArray<quint16>( iPoints.child( r, 0 ), strip );
-			}
+		removeWasteVertices( nif, iData, iShape );
+	}
+	catch ( QString & e )
+	{
+		Message::warning( nullptr, Spell::tr( "There were errors during the operation." ), e );
+	}
+}
 
-			// finally, remove the now unused vertices
+//! Removes duplicate vertices from a mesh
+class spRemoveDuplicateVertices final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Remove Duplicate Vertices" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
 
-			removeWasteVertices( nif, iData, iShape );
-		}
-		catch ( QString & e )
-		{
-			Message::warning( nullptr, Spell::tr( "There were errors during the operation." ), e );
-		}
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return getShape( nif, index ).isValid() || getBSShape( nif, index ).isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		weldVertices( nif, index, 0 );
 
 		return index;
 	}
@@ -583,6 +809,52 @@ public:
 
 REGISTER_SPELL( spRemoveDuplicateVertices );
 
+//! Welds vertices closer than a tolerance
+class spWeldVertices final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Weld Vertices" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return getShape( nif, index ).isValid() || getBSShape( nif, index ).isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QDialog dlg;
+		QGridLayout * grid = new QGridLayout;
+		dlg.setLayout( grid );
+
+		QDoubleSpinBox * spnEpsilon = new QDoubleSpinBox;
+		spnEpsilon->setRange( 0, 1 );
+		spnEpsilon->setDecimals( 5 );
+		spnEpsilon->setSingleStep( 0.0001 );
+		spnEpsilon->setValue( 0.0001 );
+
+		grid->addWidget( new QLabel( Spell::tr( "Position tolerance" ) ), 0, 0 );
+		grid->addWidget( spnEpsilon, 0, 1 );
+
+		QPushButton * btOk = new QPushButton( Spell::tr( "Weld" ) );
+		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+		QPushButton * btCancel = new QPushButton( Spell::tr( "Cancel" ) );
+		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+
+		grid->addWidget( btOk, 1, 0 );
+		grid->addWidget( btCancel, 1, 1 );
+
+		if ( dlg.exec() != QDialog::Accepted )
+			return index;
+
+		weldVertices( nif, index, spnEpsilon->value() );
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spWeldVertices );
+
 //! Removes unused vertices
 class spRemoveWasteVertices final : public Spell
 {
@@ -625,8 +897,7 @@ QModelIndex spUpdateCenterRadius::cast( NifModel * nif, const QModelIndex & inde
 	if ( !verts.count() )
 		return index;
 
-	Vector3 center;
-	float radius = 0.0f;
+	BoundSphere bounds;
 
 	/*
 	    Oblivion and CT_volatile meshes require a
@@ -636,91 +907,65 @@ QModelIndex spUpdateCenterRadius::cast( NifModel * nif, const QModelIndex & inde
 	     || ( nif->get<ushort>( iData, "Consistency Flags" ) & 0x8000 ) )
 	{
 		/* is a Oblivion mesh! */
-		float xMin( FLT_MAX ), xMax( -FLT_MAX );
-		float yMin( FLT_MAX ), yMax( -FLT_MAX );
-		float zMin( FLT_MAX ), zMax( -FLT_MAX );
-		for ( const Vector3& v : verts ) {
-			if ( v[0] < xMin )
-				xMin = v[0];
-			else if ( v[0] > xMax )
-				xMax = v[0];
-
-			if ( v[1] < yMin )
-				yMin = v[1];
-			else if ( v[1] > yMax )
-				yMax = v[1];
-
-			if ( v[2] < zMin )
-				zMin = v[2];
-			else if ( v[2] > zMax )
-				zMax = v[2];
-		}
-
-		center = Vector3( xMin + xMax, yMin + yMax, zMin + zMax ) / 2;
+		bounds = BoundSphere::around( BoundingBox( verts ).center(), verts.constData(), verts.count() );
 	} else {
-		for ( const Vector3& v : verts ) {
-			center += v;
-		}
-		center /= verts.count();
+		bounds = BoundSphere( verts );
 	}
 
-	float d;
-	for ( const Vector3& v : verts ) {
-		if ( ( d = ( center - v ).length() ) > radius )
-			radius = d;
-	}
-
-	BoundSphere::setBounds( nif, iData, center, radius );
+	BoundSphere::setBounds( nif, iData, bounds.center, bounds.radius );
 
 	return index;
 }
 
 REGISTER_SPELL( spUpdateCenterRadius );
 
-//! Updates Bounds of NiTriShape or BSTriShape
-class spUpdateBounds final : public Spell
+/*
+ * spUpdateBounds
+ */
+bool spUpdateBounds::isApplicable( const NifModel * nif, const QModelIndex & index )
 {
-public:
-	QString name() const override final { return Spell::tr( "Update Bounding Sphere" ); }
-	QString page() const override final { return Spell::tr( "Mesh" ); }
-
-	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
-	{
-		return nif->inherits( index, "NiTriShape" ) || nif->inherits( index, "BSTriShape" ) && nif->getIndex( index, "Vertex Data" ).isValid();
-	}
+	return nif->inherits( index, "NiTriShape" ) || nif->inherits( index, "BSTriShape" ) && nif->getIndex( index, "Vertex Data" ).isValid();
+}
 
-	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
-	{
-		QModelIndex vertData;
-		QVector<Vector3> verts;
+QModelIndex spUpdateBounds::cast( NifModel * nif, const QModelIndex & index )
+{
+	QVector<Vector3> verts = vertices( nif, index );
 
-		if ( nif->inherits( index, "NiTriShape" ) ) {
-			vertData = nif->getIndex( nif->getBlock( nif->getLink( index, "Data" ) ), "Vertices" );
+	if ( verts.isEmpty() )
+		return index;
 
-			// Retrieve the verts
-			for ( int i = 0; i < nif->rowCount( vertData ); i++ ) {
-				verts << nif->get<Vector3>( vertData.child( i, 0 ) );
-			}
-		}
-		else if ( nif->inherits( index, "BSTriShape" ) ) {
-			vertData = nif->getIndex( index, "Vertex Data" );
+	// Creating a bounding sphere from the verts
+	BoundSphere bounds = BoundSphere( verts );
+	bounds.update( nif, index );
 
-			// Retrieve the verts
-			for ( int i = 0; i < nif->rowCount( vertData ); i++ ) {
-				verts << nif->get<Vector3>( vertData.child( i, 0 ), "Vertex" );
-			}
-		}
-
-		if ( verts.isEmpty() )
-			return index;
+	return index;
+}
 
-		// Creating a bounding sphere from the verts
-		BoundSphere bounds = BoundSphere( verts );
-		bounds.update( nif, index );
+QVector<Vector3> spUpdateBounds::vertices( const NifModel * nif, const QModelIndex & index )
+{
+	QVector<Vector3> verts;
 
-		return index;
+	if ( nif->inherits( index, "NiTriShape" ) ) {
+		verts = nif->getArray<Vector3>( nif->getBlock( nif->getLink( index, "Data" ) ), "Vertices" );
+	}
+	else if ( nif->inherits( index, "BSTriShape" ) ) {
+		QModelIndex vertData = nif->getIndex( index, "Vertex Data" );
+		int numVerts = nif->rowCount( vertData );
+		if ( numVerts == 0 )
+			return verts;
+
+		// Every vertex shares the layout of the first, so look up the field once
+		int vertexRow = nif->getIndex( vertData.child( 0, 0 ), "Vertex" ).row();
+		if ( vertexRow < 0 )
+			return verts;
+
+		verts.reserve( numVerts );
+		for ( int i = 0; i < numVerts; i++ )
+			verts << nif->get<Vector3>( vertData.child( i, 0 ).child( vertexRow, 0 ) );
 	}
-};
+
+	return verts;
+}
 
 REGISTER_SPELL( spUpdateBounds );
 
@@ -744,21 +989,39 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QList<QPersistentModelIndex> indices;
+		struct Job
+		{
+			QPersistentModelIndex iShape;
+			QVector<Vector3> verts;
+			BoundSphere bounds;
+		};
+
+		QVector<Job> jobs;
 
 		spUpdateBounds updBounds;
 
 		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
 			QModelIndex idx = nif->getBlock( n );
 
-			if ( updBounds.isApplicable( nif, idx ) )
-				indices << idx;
-		}
+			if ( !updBounds.isApplicable( nif, idx ) )
+				continue;
 
-		for ( const QModelIndex& idx : indices ) {
-			updBounds.castIfApplicable( nif, idx );
+			Job job;
+			job.iShape = idx;
+			job.verts = spUpdateBounds::vertices( nif, idx );
+			if ( !job.verts.isEmpty() )
+				jobs << job;
 		}
 
+		QtConcurrent::blockingMap( jobs, []( Job & job ) {
+			job.bounds = BoundSphere( job.verts );
+		} );
+
+		nif->beginTransaction();
+		for ( Job & job : jobs )
+			job.bounds.update( nif, job.iShape );
+		nif->commitTransaction();
+
 		return QModelIndex();
 	}
 };
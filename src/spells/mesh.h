@@ -17,6 +17,20 @@ public:
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
 };
 
+//! Updates Bounds of NiTriShape or BSTriShape
+class spUpdateBounds final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Update Bounding Sphere" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final;
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
+
+	//! Reads the vertex positions of a NiTriShape or BSTriShape
+	static QVector<Vector3> vertices( const NifModel * nif, const QModelIndex & index );
+};
+
 //! Update Triangles on Data from Skin
 class spUpdateTrianglesFromSkin final : public Spell
 {
@@ -1,7 +1,10 @@
 #include "misc.h"
 #include "model/undocommands.h"
+#include "ui/widgets/arrayedit.h"
 
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QLineEdit>
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file misc.cpp
@@ -58,6 +61,69 @@ public:
 
 REGISTER_SPELL( spUpdateArray );
 
+//! Finds an array element containing a value without expanding the array
+class spFindInArray final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Find Value" ); }
+	QString page() const override final { return Spell::tr( "Array" ); }
+	bool constant() const override final { return true; }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isArray( index ) || nif->isArray( index.parent() );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iArray = nif->isArray( index ) ? index : index.parent();
+		QString arrayName = nif->data( iArray.sibling( iArray.row(), NifModel::NameCol ), Qt::DisplayRole ).toString();
+
+		bool ok = false;
+		QString text = QInputDialog::getText( nif->getWindow(), Spell::tr( "Find Value" ),
+			Spell::tr( "Find the next element of %1 containing:" ).arg( arrayName ), QLineEdit::Normal, QString(), &ok );
+
+		if ( !ok || text.isEmpty() )
+			return index;
+
+		// Search the fields like the table editor does, from the element after the selected one
+		ArrayTableModel table( nif, iArray );
+		int row = table.find( text, ( iArray == index ) ? 0 : index.row() + 1 );
+
+		if ( row < 0 ) {
+			Message::info( nif->getWindow(), Spell::tr( "No element of %1 contains \"%2\"." ).arg( arrayName ).arg( text ) );
+			return index;
+		}
+
+		return nif->index( row, 0, iArray );
+	}
+};
+
+REGISTER_SPELL( spFindInArray );
+
+//! Edits the elements of an array in a table, one column per field
+class spEditArrayTable final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Edit as Table" ); }
+	QString page() const override final { return Spell::tr( "Array" ); }
+	bool constant() const override final { return true; }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isArray( index ) && nif->rowCount( index ) > 0 && !nif->isArray( nif->index( 0, 0, index ) );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		ArrayEdit * edit = new ArrayEdit( nif, index );
+		edit->show();
+		return index;
+	}
+};
+
+REGISTER_SPELL( spEditArrayTable );
+
 //! Updates the header of the NifModel
 class spUpdateHeader final : public Spell
 {
@@ -1,5 +1,8 @@
 #include "spellbook.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file moppcode.cpp
@@ -38,6 +41,9 @@ private:
 	fnRetrieveMoppOrigin RetrieveMoppOrigin;
 	fnGenerateMoppCodeWithSubshapes GenerateMoppCodeWithSubshapes;
 
+	//! NifMopp.dll keeps the last generated code in global state
+	QMutex mutex;
+
 public:
 	HavokMoppCode() : hMoppLib( 0 ), GenerateMoppCode( 0 ), RetrieveMoppCode( 0 ), RetrieveMoppScale( 0 ),
 		  RetrieveMoppOrigin( 0 ), GenerateMoppCodeWithSubshapes( 0 )
@@ -52,6 +58,8 @@ public:
 
 	bool Initialize()
 	{
+		QMutexLocker lock( &mutex );
+
 		if ( !hMoppLib ) {
 			SetDllDirectoryA( QCoreApplication::applicationDirPath().toLocal8Bit().constData() );
 			hMoppLib = LoadLibraryA( "NifMopp.dll" );
@@ -70,6 +78,8 @@ public:
 		QByteArray code;
 
 		if ( Initialize() ) {
+			QMutexLocker lock( &mutex );
+
 			int len = GenerateMoppCode( verts.size(), &verts[0], tris.size(), &tris[0] );
 
 			if ( len > 0 ) {
@@ -98,6 +108,8 @@ public:
 		QByteArray code;
 
 		if ( Initialize() ) {
+			QMutexLocker lock( &mutex );
+
 			int len;
 
 			if ( GenerateMoppCodeWithSubshapes )
@@ -156,80 +168,131 @@ public:
 			return iBlock;
 		}
 
-		QPersistentModelIndex ibhkMoppBvTreeShape = iBlock;
-
-		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlock( nif->getLink( ibhkMoppBvTreeShape, "Shape" ) );
-
-		if ( !nif->isNiBlock( ibhkPackedNiTriStripsShape, "bhkPackedNiTriStripsShape" ) ) {
-			Message::warning( nullptr, Spell::tr( "Only bhkPackedNiTriStripsShape is supported at this time." ) );
+		QVector<Job> jobs( 1 );
+		QString err = extract( nif, iBlock, jobs[0] );
+		if ( !err.isEmpty() ) {
+			Message::critical( nullptr, err );
 			return iBlock;
 		}
 
-		QModelIndex ihkPackedNiTriStripsData = nif->getBlock( nif->getLink( ibhkPackedNiTriStripsShape, "Data" ) );
-
-		if ( !nif->isNiBlock( ihkPackedNiTriStripsData, "hkPackedNiTriStripsData" ) )
+		if ( !update( nif, jobs ) )
 			return iBlock;
 
+		if ( jobs[0].code.isEmpty() )
+			Message::critical( nullptr, Spell::tr( "Failed to generate MOPP code." ) );
+
+		return iBlock;
+	}
+
+	//! The input and output of one MOPP build
+	struct Job
+	{
+		QPersistentModelIndex iMoppBvTree;
+
 		QVector<int> subshapeVerts;
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+
+		Vector3 origin;
+		float scale = 0;
+		QByteArray code;
+	};
+
+	//! Gathers the collision mesh of a bhkMoppBvTreeShape
+	/*!
+	 * \return An error message, or an empty string on success
+	 */
+	static QString extract( const NifModel * nif, const QModelIndex & iBlock, Job & job )
+	{
+		job.iMoppBvTree = iBlock;
 
-		if ( nif->checkVersion( 0x14000004, 0x14000005 ) ) {
-			int nSubShapes = nif->get<int>( ibhkPackedNiTriStripsShape, "Num Sub Shapes" );
-			QModelIndex ihkSubShapes = nif->getIndex( ibhkPackedNiTriStripsShape, "Sub Shapes" );
-			subshapeVerts.resize( nSubShapes );
+		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlock( nif->getLink( iBlock, "Shape" ) );
 
-			for ( int t = 0; t < nSubShapes; t++ ) {
-				subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
-			}
-		} else if ( nif->checkVersion( 0x14020007, 0x14020007 ) ) {
-			int nSubShapes = nif->get<int>( ihkPackedNiTriStripsData, "Num Sub Shapes" );
-			QModelIndex ihkSubShapes = nif->getIndex( ihkPackedNiTriStripsData, "Sub Shapes" );
-			subshapeVerts.resize( nSubShapes );
+		if ( !nif->isNiBlock( ibhkPackedNiTriStripsShape, "bhkPackedNiTriStripsShape" ) )
+			return Spell::tr( "Only bhkPackedNiTriStripsShape is supported at this time." );
+
+		QModelIndex ihkPackedNiTriStripsData = nif->getBlock( nif->getLink( ibhkPackedNiTriStripsShape, "Data" ) );
+
+		if ( !nif->isNiBlock( ihkPackedNiTriStripsData, "hkPackedNiTriStripsData" ) )
+			return Spell::tr( "Missing hkPackedNiTriStripsData." );
+
+		QModelIndex iSubShapesParent;
+		if ( nif->checkVersion( 0x14000004, 0x14000005 ) )
+			iSubShapesParent = ibhkPackedNiTriStripsShape;
+		else if ( nif->checkVersion( 0x14020007, 0x14020007 ) )
+			iSubShapesParent = ihkPackedNiTriStripsData;
+
+		if ( iSubShapesParent.isValid() ) {
+			int nSubShapes = nif->get<int>( iSubShapesParent, "Num Sub Shapes" );
+			QModelIndex ihkSubShapes = nif->getIndex( iSubShapesParent, "Sub Shapes" );
+			job.subshapeVerts.resize( nSubShapes );
 
 			for ( int t = 0; t < nSubShapes; t++ ) {
-				subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
+				job.subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
 			}
 		}
 
-		QVector<Vector3> verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
-		QVector<Triangle> triangles;
+		job.verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
 
 		int nTriangles = nif->get<int>( ihkPackedNiTriStripsData, "Num Triangles" );
 		QModelIndex iTriangles = nif->getIndex( ihkPackedNiTriStripsData, "Triangles" );
-		triangles.resize( nTriangles );
+		job.triangles.resize( nTriangles );
 
 		for ( int t = 0; t < nTriangles; t++ ) {
-			triangles[t] = nif->get<Triangle>( iTriangles.child( t, 0 ), "Triangle" );
+			job.triangles[t] = nif->get<Triangle>( iTriangles.child( t, 0 ), "Triangle" );
 		}
 
-		if ( verts.isEmpty() || triangles.isEmpty() ) {
-			Message::critical( nullptr, Spell::tr( "Insufficient data to calculate MOPP code." ),
-				Spell::tr("Vertices: %1, Triangles: %2").arg( !verts.isEmpty() ).arg( !triangles.isEmpty() )
-			);
-			return iBlock;
+		if ( job.verts.isEmpty() || job.triangles.isEmpty() ) {
+			return Spell::tr( "Insufficient data to calculate MOPP code." ) + "\n"
+				+ Spell::tr( "Vertices: %1, Triangles: %2" ).arg( !job.verts.isEmpty() ).arg( !job.triangles.isEmpty() );
 		}
 
-		Vector3 origin;
-		float scale;
-		QByteArray moppcode = TheHavokCode.CalculateMoppCode( subshapeVerts, verts, triangles, &origin, &scale );
+		return QString();
+	}
 
-		if ( moppcode.size() == 0 ) {
-			Message::critical( nullptr, Spell::tr( "Failed to generate MOPP code." ) );
-		} else {
-			auto iMoppCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Code" );
+	//! Generates the MOPP code of each job in the background and writes it back in one transaction
+	/*!
+	 * NifMopp.dll is not reentrant, so the builds themselves are serialized
+	 * by HavokMoppCode; running them off the GUI thread keeps the progress
+	 * dialog responsive and lets the user cancel between shapes.
+	 *
+	 * \return False if the user cancelled, in which case nothing is written
+	 */
+	static bool update( NifModel * nif, QVector<Job> & jobs )
+	{
+		Job * data = jobs.data();
 
-			nif->set<Vector4>( nif->getIndex( iMoppCode, "Offset" ), Vector4(origin, scale) );
+		bool finished = Spell::runJobs( Spell::tr( "Generating MOPP code..." ), jobs.count(), [data]( int i ) {
+			Job & job = data[i];
+			job.code = TheHavokCode.CalculateMoppCode( job.subshapeVerts, job.verts, job.triangles, &job.origin, &job.scale );
+		} );
+
+		if ( !finished )
+			return false;
+
+		nif->beginTransaction();
+
+		for ( const Job & job : jobs ) {
+			if ( job.code.isEmpty() || !job.iMoppBvTree.isValid() )
+				continue;
+
+			auto iMoppCode = nif->getIndex( job.iMoppBvTree, "MOPP Code" );
+
+			nif->set<Vector4>( nif->getIndex( iMoppCode, "Offset" ), Vector4( job.origin, job.scale ) );
 
 			QModelIndex iCodeSize = nif->getIndex( iMoppCode, "Data Size" );
 			QModelIndex iCode = nif->getIndex( iMoppCode, "Data" ).child( 0, 0 );
 
 			if ( iCodeSize.isValid() && iCode.isValid() ) {
-				nif->set<int>( iCodeSize, moppcode.size() );
+				nif->set<int>( iCodeSize, job.code.size() );
 				nif->updateArray( iCode );
-				nif->set<QByteArray>( iCode, moppcode );
+				nif->set<QByteArray>( iCode, job.code );
 			}
 		}
 
-		return iBlock;
+		nif->commitTransaction();
+
+		return true;
 	}
 };
 
@@ -259,19 +322,32 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QList<QPersistentModelIndex> indices;
-
 		spMoppCode TSpacer;
 
+		QVector<spMoppCode::Job> jobs;
+
 		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
 			QModelIndex idx = nif->getBlock( n );
 
-			if ( TSpacer.isApplicable( nif, idx ) )
-				indices << idx;
+			if ( !TSpacer.isApplicable( nif, idx ) )
+				continue;
+
+			spMoppCode::Job job;
+			QString err = spMoppCode::extract( nif, idx, job );
+			if ( err.isEmpty() )
+				jobs << job;
+			else
+				Message::append( Spell::tr( "Some MOPP code could not be updated." ),
+					QString( "%1: %2" ).arg( n ).arg( err ) );
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
+		if ( !spMoppCode::update( nif, jobs ) )
+			return QModelIndex();
+
+		for ( const auto & job : jobs ) {
+			if ( job.code.isEmpty() )
+				Message::append( Spell::tr( "Some MOPP code could not be updated." ),
+					Spell::tr( "%1: Failed to generate MOPP code." ).arg( nif->getBlockNumber( job.iMoppBvTree ) ) );
 		}
 
 		return QModelIndex();
@@ -2,11 +2,16 @@
 
 #include "lib/nvtristripwrapper.h"
 
+#include <QCheckBox>
 #include <QDialog>
 #include <QDoubleSpinBox>
+#include <QHash>
 #include <QLabel>
 #include <QLayout>
 #include <QPushButton>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -16,6 +21,42 @@
  * All classes here inherit from the Spell class.
  */
 
+//! Reads the triangles of the shape data found by spFaceNormals::getShapeData()
+static QVector<Triangle> getShapeTriangles( const NifModel * nif, const QModelIndex & index, const QModelIndex & iData )
+{
+	QVector<Triangle> triangles;
+
+	if ( nif->getUserVersion2() < 100 ) {
+		QModelIndex iPoints = nif->getIndex( iData, "Points" );
+
+		if ( iPoints.isValid() ) {
+			QVector<QVector<quint16> > strips;
+
+			for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+				strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
+
+			triangles = triangulate( strips );
+		} else {
+			triangles = nif->getArray<Triangle>( iData, "Triangles" );
+		}
+	} else {
+		auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
+		if ( !((vf & VertexFlags::VF_SKINNED) && nif->getUserVersion2() == 100) ) {
+			triangles = nif->getArray<Triangle>( index, "Triangles" );
+		} else {
+			// Skinned SSE
+			// Get triangles from all partitions
+			auto iPart = iData.parent();
+			auto numParts = nif->get<int>( iPart, "Num Partitions" );
+			auto iParts = nif->getIndex( iPart, "Partitions" );
+			for ( int i = 0; i < numParts; i++ )
+				triangles << nif->getArray<Triangle>( iParts.child( i, 0 ), "Triangles" );
+		}
+	}
+
+	return triangles;
+}
+
 //! Recalculates and faces the normals of a mesh
 class spFaceNormals final : public Spell
 {
@@ -78,20 +119,7 @@ public:
 
 		if ( nif->getUserVersion2() < 100 ) {
 			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-			QVector<Triangle> triangles;
-			QModelIndex iPoints = nif->getIndex( iData, "Points" );
-
-			if ( iPoints.isValid() ) {
-				QVector<QVector<quint16> > strips;
-
-				for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
-					strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
-
-				triangles = triangulate( strips );
-			} else {
-				triangles = nif->getArray<Triangle>( iData, "Triangles" );
-			}
-
+			QVector<Triangle> triangles = getShapeTriangles( nif, index, iData );
 
 			QVector<Vector3> norms( verts.count() );
 			
@@ -101,22 +129,15 @@ public:
 			nif->updateArray( iData, "Normals" );
 			nif->setArray<Vector3>( iData, "Normals", norms );
 		} else {
-			QVector<Triangle> triangles;
+			QVector<Triangle> triangles = getShapeTriangles( nif, index, iData );
 			int numVerts;
 			auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
 			if ( !((vf & VertexFlags::VF_SKINNED) && nif->getUserVersion2() == 100) ) {
 				numVerts = nif->get<int>( index, "Num Vertices" );
-				triangles = nif->getArray<Triangle>( index, "Triangles" );
 			} else {
 				// Skinned SSE
 				auto iPart = iData.parent();
 				numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
-
-				// Get triangles from all partitions
-				auto numParts = nif->get<int>( iPart, "Num Partitions" );
-				auto iParts = nif->getIndex( iPart, "Partitions" );
-				for ( int i = 0; i < numParts; i++ )
-					triangles << nif->getArray<Triangle>( iParts.child( i, 0 ), "Triangles" );
 			}
 
 			QVector<Vector3> verts;
@@ -183,6 +204,194 @@ public:
 
 REGISTER_SPELL( spFlipNormals );
 
+/*! Sums the face normals at each vertex, weighted by the angle of the face at the vertex
+ *
+ * Unlike an area weighted sum, the result does not depend on how a surface is
+ * split into triangles.
+ */
+static QVector<Vector3> angleWeightedNormals( const QVector<Vector3> & verts, const QVector<Triangle> & triangles )
+{
+	QVector<Vector3> norms( verts.count() );
+
+	for ( const Triangle & tri : triangles ) {
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			continue;
+
+		const Vector3 & a = verts[tri[0]];
+		const Vector3 & b = verts[tri[1]];
+		const Vector3 & c = verts[tri[2]];
+
+		Vector3 fn = Vector3::crossProduct( b - a, c - a );
+
+		if ( fn.squaredLength() == 0 )
+			continue;
+
+		fn.normalize();
+
+		norms[tri[0]] += fn * Vector3::angle( b - a, c - a );
+		norms[tri[1]] += fn * Vector3::angle( c - b, a - b );
+		norms[tri[2]] += fn * Vector3::angle( a - c, b - c );
+	}
+
+	for ( Vector3 & n : norms )
+		n.normalize();
+
+	return norms;
+}
+
+/*! Adds the normals of nearby vertices with a similar normal to each normal
+ *
+ * Vertices are bucketed in a uniform grid with cells as large as the search
+ * radius, so each vertex only tests the vertices of the 27 cells around it.
+ * The grid is only read while the vertices are smoothed in parallel.
+ *
+ * @param maxa	Maximum angle between the normals, in radians
+ * @param maxd	Maximum squared distance between the vertices
+ */
+static QVector<Vector3> smoothNormals( const QVector<Vector3> & verts, const QVector<Vector3> & norms, float maxa, float maxd )
+{
+	QVector<Vector3> snorms( norms );
+
+	if ( maxd > 0 ) {
+		float cell = sqrt( maxd );
+
+		auto cellOf = [cell]( const Vector3 & v, int dx, int dy, int dz ) {
+			qint64 x = qint64( floor( v[0] / cell ) ) + dx;
+			qint64 y = qint64( floor( v[1] / cell ) ) + dy;
+			qint64 z = qint64( floor( v[2] / cell ) ) + dz;
+
+			// Colliding cells only add candidates, the distance is always tested
+			return quint64( x * 73856093 ) ^ quint64( y * 19349663 ) ^ quint64( z * 83492791 );
+		};
+
+		// Sort the vertices by cell, each cell is a range of the sorted list
+		QVector<QPair<quint64, int>> sorted( verts.count() );
+		for ( int i = 0; i < verts.count(); i++ )
+			sorted[i] = { cellOf( verts[i], 0, 0, 0 ), i };
+
+		std::sort( sorted.begin(), sorted.end() );
+
+		QHash<quint64, QPair<int, int>> cells;
+		cells.reserve( verts.count() );
+
+		for ( int first = 0; first < sorted.count(); ) {
+			int last = first + 1;
+			while ( last < sorted.count() && sorted[last].first == sorted[first].first )
+				last++;
+
+			cells.insert( sorted[first].first, { first, last } );
+			first = last;
+		}
+
+		QVector<QPair<int, int>> ranges;
+		for ( int i = 0; i < verts.count(); i += 4096 )
+			ranges.append( { i, qMin( i + 4096, verts.count() ) } );
+
+		QtConcurrent::blockingMap( ranges, [&]( const QPair<int, int> & range ) {
+			for ( int i = range.first; i < range.second; i++ ) {
+				const Vector3 & a = verts[i];
+				const Vector3 & an = norms[i];
+
+				quint64 keys[27];
+				int numKeys = 0;
+
+				for ( int dx = -1; dx <= 1; dx++ ) {
+					for ( int dy = -1; dy <= 1; dy++ ) {
+						for ( int dz = -1; dz <= 1; dz++ ) {
+							quint64 key = cellOf( a, dx, dy, dz );
+
+							if ( std::find( keys, keys + numKeys, key ) == keys + numKeys )
+								keys[numKeys++] = key;
+						}
+					}
+				}
+
+				for ( int k = 0; k < numKeys; k++ ) {
+					auto it = cells.constFind( keys[k] );
+					if ( it == cells.constEnd() )
+						continue;
+
+					for ( int s = it.value().first; s < it.value().second; s++ ) {
+						int j = sorted[s].second;
+
+						if ( j == i || ( a - verts[j] ).squaredLength() >= maxd )
+							continue;
+
+						if ( Vector3::angle( an, norms[j] ) < maxa )
+							snorms[i] += norms[j];
+					}
+				}
+			}
+		} );
+	}
+
+	for ( Vector3 & n : snorms )
+		n.normalize();
+
+	return snorms;
+}
+
+//! Options of the smooth normals spells
+struct SmoothOptions
+{
+	//! Maximum angle between the normals, in radians
+	float angle = 0;
+	//! Maximum squared distance between the vertices
+	float distance = 0;
+	//! Recalculate the normals from the faces before smoothing
+	bool faces = false;
+};
+
+//! Asks for the options of the smooth normals spells
+static bool smoothOptions( SmoothOptions & options )
+{
+	QDialog dlg;
+	dlg.setWindowTitle( Spell::tr( "Smooth Normals" ) );
+
+	QGridLayout * grid = new QGridLayout;
+	dlg.setLayout( grid );
+
+	QDoubleSpinBox * angle = new QDoubleSpinBox;
+	angle->setRange( 0, 180 );
+	angle->setValue( 60 );
+	angle->setSingleStep( 5 );
+
+	grid->addWidget( new QLabel( Spell::tr( "Max Smooth Angle" ) ), 0, 0 );
+	grid->addWidget( angle, 0, 1 );
+
+	QDoubleSpinBox * dist = new QDoubleSpinBox;
+	dist->setRange( 0, 1 );
+	dist->setDecimals( 4 );
+	dist->setSingleStep( 0.01 );
+	dist->setValue( 0.001 );
+
+	grid->addWidget( new QLabel( Spell::tr( "Max Vertex Distance" ) ), 1, 0 );
+	grid->addWidget( dist, 1, 1 );
+
+	QCheckBox * faces = new QCheckBox( Spell::tr( "Recalculate from faces" ) );
+	grid->addWidget( faces, 2, 0, 1, 2 );
+
+	QPushButton * btOk = new QPushButton;
+	btOk->setText( Spell::tr( "Smooth" ) );
+	QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+
+	QPushButton * btCancel = new QPushButton;
+	btCancel->setText( Spell::tr( "Cancel" ) );
+	QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+
+	grid->addWidget( btOk, 3, 0 );
+	grid->addWidget( btCancel, 3, 1 );
+
+	if ( dlg.exec() != QDialog::Accepted )
+		return false;
+
+	options.angle = angle->value() / 180 * PI;
+	options.distance = dist->value();
+	options.faces = faces->isChecked();
+
+	return true;
+}
+
 //! Smooths the normals of a mesh
 class spSmoothNormals final : public Spell
 {
@@ -196,6 +405,17 @@ public:
 	}
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		SmoothOptions options;
+
+		if ( smoothOptions( options ) )
+			smooth( nif, index, options );
+
+		return index;
+	}
+
+	//! Smooths the normals of a mesh with the given options
+	static bool smooth( NifModel * nif, const QModelIndex & index, const SmoothOptions & options )
 	{
 		QModelIndex iData = spFaceNormals::getShapeData( nif, index );
 
@@ -237,89 +457,81 @@ public:
 				verts << Vector3(v);
 		}
 
-		if ( verts.isEmpty() || verts.count() != norms.count() )
-			return index;
-
-		QDialog dlg;
-		dlg.setWindowTitle( Spell::tr( "Smooth Normals" ) );
-
-		QGridLayout * grid = new QGridLayout;
-		dlg.setLayout( grid );
-
-		QDoubleSpinBox * angle = new QDoubleSpinBox;
-		angle->setRange( 0, 180 );
-		angle->setValue( 60 );
-		angle->setSingleStep( 5 );
+		if ( options.faces )
+			norms = angleWeightedNormals( verts, getShapeTriangles( nif, index, iData ) );
 
-		grid->addWidget( new QLabel( Spell::tr( "Max Smooth Angle" ) ), 0, 0 );
-		grid->addWidget( angle, 0, 1 );
+		if ( verts.isEmpty() || verts.count() != norms.count() )
+			return false;
 
-		QDoubleSpinBox * dist = new QDoubleSpinBox;
-		dist->setRange( 0, 1 );
-		dist->setDecimals( 4 );
-		dist->setSingleStep( 0.01 );
-		dist->setValue( 0.001 );
+		QVector<Vector3> snorms = smoothNormals( verts, norms, options.angle, options.distance );
 
-		grid->addWidget( new QLabel( Spell::tr( "Max Vertex Distance" ) ), 1, 0 );
-		grid->addWidget( dist, 1, 1 );
+		if ( nif->getUserVersion2() < 100 ) {
+			if ( !nif->get<bool>( iData, "Has Normals" ) ) {
+				nif->set<int>( iData, "Has Normals", 1 );
+				nif->updateArray( iData, "Normals" );
+			}
 
-		QPushButton * btOk = new QPushButton;
-		btOk->setText( Spell::tr( "Smooth" ) );
-		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
+			nif->setArray<Vector3>( iData, "Normals", snorms );
+		} else {
+			// Pause updates between model/view
+			nif->setState( BaseModel::Processing );
+			for ( int i = 0; i < numVerts; i++ )
+				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", snorms[i] );
+			nif->resetState();
+		}
 
-		QPushButton * btCancel = new QPushButton;
-		btCancel->setText( Spell::tr( "Cancel" ) );
-		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
+		return true;
+	}
+};
 
-		grid->addWidget( btOk, 2, 0 );
-		grid->addWidget( btCancel, 2, 1 );
+REGISTER_SPELL( spSmoothNormals );
 
-		if ( dlg.exec() != QDialog::Accepted )
-			return index;
+//! Smooths the normals of all meshes
+class spSmoothAllNormals final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Smooth All Normals" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
 
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
 
-		float maxa = angle->value() / 180 * PI;
-		float maxd = dist->value();
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		SmoothOptions options;
 
-		QVector<Vector3> snorms( norms );
+		if ( !smoothOptions( options ) )
+			return QModelIndex();
 
-		for ( int i = 0; i < verts.count(); i++ ) {
-			const Vector3 & a = verts[i];
-			Vector3 an = norms[i];
+		QList<QPersistentModelIndex> indices;
 
-			for ( int j = i + 1; j < verts.count(); j++ ) {
-				const Vector3 & b = verts[j];
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlock( n );
 
-				if ( ( a - b ).squaredLength() < maxd ) {
-					Vector3 bn = norms[j];
+			// Data blocks are reached through their shape
+			if ( nif->isNiBlock( idx, { "NiTriShapeData", "NiTriStripsData" } ) )
+				continue;
 
-					if ( Vector3::angle( an, bn ) < maxa ) {
-						snorms[i] += bn;
-						snorms[j] += an;
-					}
-				}
-			}
+			if ( spFaceNormals::getShapeData( nif, idx ).isValid() )
+				indices << idx;
 		}
 
-		for ( int i = 0; i < verts.count(); i++ )
-			snorms[i].normalize();
+		int smoothed = 0;
 
-		if ( nif->getUserVersion2() < 100 ) {
-			nif->setArray<Vector3>( iData, "Normals", snorms );
-		} else {
-			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
-			for ( int i = 0; i < numVerts; i++ )
-				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", snorms[i] );
-			nif->resetState();
+		for ( const QModelIndex & idx : indices ) {
+			if ( spSmoothNormals::smooth( nif, idx, options ) )
+				smoothed++;
 		}
-		
 
-		return index;
+		Message::info( nullptr, Spell::tr( "Smoothed the normals of %1 shapes." ).arg( smoothed ) );
+
+		return QModelIndex();
 	}
 };
 
-REGISTER_SPELL( spSmoothNormals );
+REGISTER_SPELL( spSmoothAllNormals );
 
 //! Normalises any single Vector3 or array.
 /**
@@ -5,11 +5,12 @@
 #include "spells/tangentspace.h"
 #include "spells/transform.h"
 
+#include "xxhash.h"
+
 #include <QBuffer>
 #include <QMessageBox>
 
-#include <algorithm> // std::sort
-#include <functional> //std::greater
+#include <algorithm> // std::sort, std::find_if
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -21,6 +22,10 @@
 
 //! Combines properties
 /*!
+ * Duplicate properties, textures, texture sets, skin data and collision shapes
+ * are found by hashing their serialized data. Blocks are visited children first,
+ * so parents whose children were merged are compared with the remapped links.
+ *
  * This has a tendency to fail due to supposedly boolean values in many NIFs
  * having values apart from 0 and 1.
  *
@@ -40,76 +45,100 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		int numRemoved = 0;
-		QMap<qint32, QByteArray> props;
-		QMap<qint32, qint32> map;
+		QVector<qint32> order;
+		QVector<bool> visited( nif->getBlockCount(), false );
 
-		do {
-			props.clear();
-			map.clear();
+		for ( qint32 b = 0; b < nif->getBlockCount(); b++ )
+			visit( nif, b, visited, order );
 
-			for ( qint32 b = 0; b < nif->getBlockCount(); b++ ) {
-				QModelIndex iBlock = nif->getBlock( b );
-				QString original_material_name;
+		QHash<quint64, QList<qint32>> buckets;
+		QHash<qint32, QByteArray> props;
+		QMap<qint32, qint32> map;
 
-				if ( nif->isNiBlock( iBlock, "NiMaterialProperty" ) ) {
-					original_material_name = nif->get<QString>( iBlock, "Name" );
+		for ( const auto b : order ) {
+			QModelIndex iBlock = nif->getBlock( b );
 
-					if ( nif->get<QString>( iBlock, "Name" ).contains( "Material" ) )
-						nif->set<QString>( iBlock, "Name", "Material" );
-					else if ( nif->get<QString>( iBlock, "Name" ).contains( "Default" ) )
-						nif->set<QString>( iBlock, "Name", "Default" );
-				}
+			if ( !isCombinable( nif, iBlock ) )
+				continue;
 
-				if ( nif->inherits( iBlock, "BSShaderProperty" ) || nif->isNiBlock( iBlock, "BSShaderTextureSet" ) ) {
-					// these need to be unique
-					continue;
-				}
+			if ( !map.isEmpty() )
+				nif->mapLinks( iBlock, map );
 
-				if ( nif->inherits( iBlock, "NiProperty" ) || nif->inherits( iBlock, "NiSourceTexture" ) ) {
-					QBuffer data;
-					data.open( QBuffer::WriteOnly );
-					data.write( nif->itemName( iBlock ).toLatin1() );
-					nif->saveIndex( data, iBlock );
-					props.insert( b, data.buffer() );
-				}
+			QByteArray data = serialize( nif, iBlock );
+			QList<qint32> & bucket = buckets[ XXH64( data.constData(), data.size(), 0 ) ];
 
-				// restore name
-				if ( nif->isNiBlock( iBlock, "NiMaterialProperty" ) ) {
-					nif->set<QString>( iBlock, "Name", original_material_name );
-				}
+			auto it = std::find_if( bucket.cbegin(), bucket.cend(), [&props, &data]( qint32 x ) {
+				return props.value( x ) == data;
+			} );
+
+			if ( it != bucket.cend() ) {
+				map.insert( b, *it );
+			} else {
+				bucket << b;
+				props.insert( b, data );
 			}
+		}
 
-			for ( const auto x : props.keys() ) {
-				for ( const auto y : props.keys() ) {
-					if ( x < y && ( !map.contains( y ) ) && props[x].size() == props[y].size() ) {
-						int c = 0;
+		if ( !map.isEmpty() ) {
+			nif->mapLinks( map );
+			nif->removeNiBlocks( map.keys() );
+		}
 
-						while ( c < props[x].size() ) {
-							if ( props[x][c] != props[y][c] )
-								break;
-							c++;
-						}
+		Message::info( nullptr, Spell::tr( "Removed %1 properties." ).arg( map.count() ) );
+		return QModelIndex();
+	}
 
-						if ( c == props[x].size() )
-							map.insert( y, x );
-					}
-				}
-			}
+	//! Append block b to order after all of its children
+	static void visit( const NifModel * nif, qint32 b, QVector<bool> & visited, QVector<qint32> & order )
+	{
+		if ( visited[b] )
+			return;
 
-			if ( !map.isEmpty() ) {
-				numRemoved += map.count();
-				nif->mapLinks( map );
-				QList<qint32> l = map.keys();
-				std::sort( l.begin(), l.end(), std::greater<qint32>() );
-				for ( const auto b : l ) {
-					nif->removeNiBlock( b );
-				}
-			}
-		} while ( !map.isEmpty() );
+		visited[b] = true;
 
-		Message::info( nullptr, Spell::tr( "Removed %1 properties." ).arg( numRemoved ) );
-		return QModelIndex();
+		for ( const auto c : nif->getChildLinks( b ) ) {
+			if ( c >= 0 && c < visited.count() )
+				visit( nif, c, visited, order );
+		}
+
+		order << b;
+	}
+
+	//! Determine if a block may be shared by several parents
+	static bool isCombinable( const NifModel * nif, const QModelIndex & iBlock )
+	{
+		// these need to be unique
+		if ( nif->inherits( iBlock, "BSShaderProperty" ) )
+			return false;
+
+		return nif->inherits( iBlock, { "NiProperty", "NiSourceTexture", "BSShaderTextureSet", "NiSkinData", "bhkShape", "hkPackedNiTriStripsData" } );
+	}
+
+	//! Serialize a block for comparison
+	static QByteArray serialize( NifModel * nif, const QModelIndex & iBlock )
+	{
+		QString original_material_name;
+
+		if ( nif->isNiBlock( iBlock, "NiMaterialProperty" ) ) {
+			original_material_name = nif->get<QString>( iBlock, "Name" );
+
+			if ( original_material_name.contains( "Material" ) )
+				nif->set<QString>( iBlock, "Name", "Material" );
+			else if ( original_material_name.contains( "Default" ) )
+				nif->set<QString>( iBlock, "Name", "Default" );
+		}
+
+		QBuffer data;
+		data.open( QBuffer::WriteOnly );
+		data.write( nif->itemName( iBlock ).toLatin1() );
+		nif->saveIndex( data, iBlock );
+
+		// restore name
+		if ( nif->isNiBlock( iBlock, "NiMaterialProperty" ) ) {
+			nif->set<QString>( iBlock, "Name", original_material_name );
+		}
+
+		return data.buffer();
 	}
 };
 
@@ -313,6 +342,9 @@ public:
 
 		QList<QPersistentModelIndex> remove;
 
+		// Only values change here, so the per-item signals can be coalesced
+		nif->beginTransaction();
+
 		for ( const auto lTriA : match.keys() ) {
 			ApplyTransform.cast( nif, nif->getBlock( lTriA ) );
 
@@ -325,6 +357,8 @@ public:
 			TSpace.castIfApplicable( nif, nif->getBlock( lTriA ) );
 		}
 
+		nif->commitTransaction();
+
 		// remove the now obsolete shapes
 
 		spRemoveBranch BranchRemover;
@@ -418,6 +418,19 @@ public:
 	{
 		for ( int b = 0; b < nif->getBlockCount(); b++ ) {
 			QModelIndex iBlock = nif->getBlock( b );
+
+			// Blocks that were not built yet only had their links renumbered since loading, check just their numbers
+			if ( nif->canFetchMore( iBlock ) ) {
+				for ( const auto l : nif->getChildLinks( b ) + nif->getParentLinks( b ) ) {
+					if ( l >= nif->getBlockCount() ) {
+						qCCritical( nsSpell ) << Spell::tr( "Invalid link '%1'." ).arg( QString::number(l) );
+						return iBlock;
+					}
+				}
+
+				continue;
+			}
+
 			QModelIndex idx = check( nif, iBlock );
 
 			if ( idx.isValid() )
@@ -2,9 +2,12 @@
 
 #include "spellbook.h"
 #include "gl/gltools.h"
+#include "gl/gltools/meshoptimizer.h"
+#include "gl/gltools/vertexweld.h"
 
 #include "lib/nvtristripwrapper.h"
 
+#include <QBitArray>
 #include <QCheckBox>
 #include <QFile>
 #include <QGridLayout>
@@ -12,8 +15,11 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSpinBox>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <algorithm> // std::sort
+#include <functional> // std::greater
+#include <queue> // std::priority_queue
 
 #define SKEL_DAT ":/res/skel.dat"
 
@@ -305,698 +311,764 @@ public:
 	typedef struct
 	{
 		QList<int> bones;
+		//! Triangles, using the indices of the vertex map once the partition is done
 		QVector<Triangle> triangles;
+		//! The shape vertex of each partition vertex
+		QVector<int> vertices;
 	} Partition;
 
+	//! The skin of a shape, read from the model so that it can be partitioned off the GUI thread
+	struct Job
+	{
+		QPersistentModelIndex iShape;
+		QPersistentModelIndex iSkinInst;
+		QPersistentModelIndex iSkinData;
+		QPersistentModelIndex iSkinPart;
+
+		int numVerts = 0;
+		int numBones = 0;
+		//! The highest number of bones influencing a vertex
+		int maxInfluences = 0;
+
+		QVector<QList<boneweight> > weights;
+		QVector<Vector3> verts;
+		QVector<Triangle> triangles;
+
+		//! The existing partition of each (rotated) triangle for BSDismemberSkinInstance
+		QMap<Triangle, quint32> trimap;
+		quint32 defaultPart = 0;
+
+		QList<Partition> parts;
+		QString error;
+	};
+
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
 	{
-		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
-		return cast( nif, iBlock, mbpp, mbpv, make_strips );
+		partition( nif, { iBlock } );
+		return iBlock;
 	}
 
-	//! Cast with extra parameters
-	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock, int & maxBonesPerPartition, int & maxBonesPerVertex, bool make_strips, bool pad = false )
+	/*! Partition the skins of several shapes
+	 *
+	 * The options are asked for once. The skins are read from the model, partitioned
+	 * in parallel and then written back one after another.
+	 */
+	static void partition( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
 	{
-		QPersistentModelIndex iShape = iBlock;
-		QString iShapeType = "";
+		QVector<Job> jobs( shapes.count() );
+		int maxInfluences = 0;
+		bool valid = false;
 
-		if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
-			iShapeType = "NiTriShape";
-		} else if ( nif->isNiBlock( iShape, "NiTriStrips" ) ) {
-			iShapeType = "NiTriStrips";
+		for ( int i = 0; i < jobs.count(); i++ ) {
+			jobs[i].iShape = shapes[i];
+
+			try
+			{
+				extract( nif, jobs[i] );
+				maxInfluences = qMax( maxInfluences, jobs[i].maxInfluences );
+				valid = true;
+			}
+			catch ( QString & err )
+			{
+				jobs[i].error = err;
+			}
 		}
 
-		try
-		{
-			QPersistentModelIndex iData;
+		int maxBonesPerPartition = 0, maxBonesPerVertex = 0;
+		bool make_strips = false, pad = false;
 
-			if ( iShapeType == "NiTriShape" ) {
-				iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
-			} else if ( iShapeType == "NiTriStrips" ) {
-				iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriStripsData" );
-			}
+		if ( valid ) {
+			// query max bones per vertex/partition
 
-			QPersistentModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
-			QPersistentModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
-			QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
+			SkinPartitionDialog dlg( maxInfluences );
 
-			if ( !iSkinPart.isValid() )
-				iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
+			if ( dlg.exec() != QDialog::Accepted )
+				return;
 
-			// read in the weights from NiSkinData
+			maxBonesPerPartition = dlg.maxBonesPerPartition();
+			maxBonesPerVertex = dlg.maxBonesPerVertex();
+			make_strips = dlg.makeStrips();
+			pad = dlg.padPartitions();
+		}
 
-			int numVerts = nif->get<int>( iData, "Num Vertices" );
-			QVector<QList<boneweight> > weights( numVerts );
+		QtConcurrent::blockingMap( jobs, [maxBonesPerPartition, maxBonesPerVertex]( Job & job ) {
+			if ( !job.error.isEmpty() )
+				return;
 
-			QModelIndex iBoneList = nif->getIndex( iSkinData, "Bone List" );
-			int numBones = nif->rowCount( iBoneList );
+			try
+			{
+				compute( job, maxBonesPerPartition, maxBonesPerVertex );
+			}
+			catch ( QString & err )
+			{
+				job.error = err;
+			}
+		} );
 
-			for ( int bone = 0; bone < numBones; bone++ ) {
-				QModelIndex iVertexWeights = nif->getIndex( iBoneList.child( bone, 0 ), "Vertex Weights" );
+		for ( const Job & job : jobs ) {
+			if ( job.error.isEmpty() )
+				write( nif, job, maxBonesPerPartition, maxBonesPerVertex, make_strips, pad );
+			else
+				QMessageBox::warning( 0, "NifSkope", job.error );
+		}
+	}
 
-				for ( int r = 0; r < nif->rowCount( iVertexWeights ); r++ ) {
-					int vertex = nif->get<int>( iVertexWeights.child( r, 0 ), "Index" );
-					float weight = nif->get<float>( iVertexWeights.child( r, 0 ), "Weight" );
+	//! Read the weights and triangles of a shape
+	static void extract( const NifModel * nif, Job & job )
+	{
+		QModelIndex iShape = job.iShape;
+		QModelIndex iData;
 
-					if ( vertex >= weights.count() )
-						throw QString( Spell::tr( "bad NiSkinData - vertex count does not match" ) );
+		if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
+			iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+		} else if ( nif->isNiBlock( iShape, "NiTriStrips" ) ) {
+			iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriStripsData" );
+		}
 
-					weights[vertex].append( boneweight( bone, weight ) );
-				}
-			}
+		job.iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+		job.iSkinData = nif->getBlock( nif->getLink( job.iSkinInst, "Data" ), "NiSkinData" );
+		job.iSkinPart = nif->getBlock( nif->getLink( job.iSkinInst, "Skin Partition" ), "NiSkinPartition" );
 
-			// count min and max bones per vertex
+		if ( !job.iSkinPart.isValid() )
+			job.iSkinPart = nif->getBlock( nif->getLink( job.iSkinData, "Skin Partition" ), "NiSkinPartition" );
 
-			int minBones, maxBones;
-			minBones = maxBones = weights.value( 0 ).count();
-			for ( const QList<boneweight> list : weights ) {
-				if ( list.count() < minBones )
-					minBones = list.count();
+		// read in the weights from NiSkinData
 
-				if ( list.count() > maxBones )
-					maxBones = list.count();
-			}
+		job.numVerts = nif->get<int>( iData, "Num Vertices" );
+		job.weights.resize( job.numVerts );
 
-			if ( minBones <= 0 )
-				throw QString( Spell::tr( "bad NiSkinData - some vertices have no weights at all" ) );
+		QModelIndex iBoneList = nif->getIndex( job.iSkinData, "Bone List" );
+		job.numBones = nif->rowCount( iBoneList );
 
-			// query max bones per vertex/partition
+		for ( int bone = 0; bone < job.numBones; bone++ ) {
+			QModelIndex iVertexWeights = nif->getIndex( iBoneList.child( bone, 0 ), "Vertex Weights" );
 
-			if ( maxBonesPerPartition <= 0 || maxBonesPerVertex <= 0 ) {
-				SkinPartitionDialog dlg( maxBones );
+			for ( int r = 0; r < nif->rowCount( iVertexWeights ); r++ ) {
+				int vertex = nif->get<int>( iVertexWeights.child( r, 0 ), "Index" );
+				float weight = nif->get<float>( iVertexWeights.child( r, 0 ), "Weight" );
 
-				if ( dlg.exec() != QDialog::Accepted )
-					return iBlock;
+				if ( vertex >= job.weights.count() )
+					throw QString( Spell::tr( "bad NiSkinData - vertex count does not match" ) );
 
-				maxBonesPerPartition = dlg.maxBonesPerPartition();
-				maxBonesPerVertex = dlg.maxBonesPerVertex();
-				make_strips = dlg.makeStrips();
-				pad = dlg.padPartitions();
+				job.weights[vertex].append( boneweight( bone, weight ) );
 			}
+		}
 
-			// reduce vertex influences if necessary
+		// count min and max bones per vertex
 
-			if ( maxBones > maxBonesPerVertex ) {
-				QMutableVectorIterator<QList<boneweight> > it( weights );
-				int c = 0;
+		int minBones;
+		minBones = job.maxInfluences = job.weights.value( 0 ).count();
+		for ( const QList<boneweight> & list : job.weights ) {
+			if ( list.count() < minBones )
+				minBones = list.count();
 
-				while ( it.hasNext() ) {
-					QList<boneweight> & lst = it.next();
-					std::sort( lst.begin(), lst.end(), boneweight_equivalence() );
+			if ( list.count() > job.maxInfluences )
+				job.maxInfluences = list.count();
+		}
 
-					if ( lst.count() > maxBonesPerVertex )
-						c++;
+		if ( minBones <= 0 )
+			throw QString( Spell::tr( "bad NiSkinData - some vertices have no weights at all" ) );
 
-					while ( lst.count() > maxBonesPerVertex ) {
-						lst.removeLast();
-					}
+		job.verts = nif->getArray<Vector3>( iData, "Vertices" );
 
-					float totalWeight = 0;
-					for ( const auto bw : lst ) {
-						totalWeight += bw.second;
-					}
+		if ( nif->isNiBlock( iData, "NiTriShapeData" ) ) {
+			job.triangles = nif->getArray<Triangle>( iData, "Triangles" );
+		} else {
+			job.triangles = triangulate( readStrips( nif, nif->getIndex( iData, "Points" ) ) );
+		}
 
-					for ( int b = 0; b < lst.count(); b++ ) {
-						// normalize
-						lst[b].second /= totalWeight;
-					}
-				}
+		for ( const Triangle & tri : job.triangles ) {
+			if ( tri[0] >= job.numVerts || tri[1] >= job.numVerts || tri[2] >= job.numVerts )
+				throw QString( Spell::tr( "bad triangles - vertex index out of range" ) );
+		}
+
+		if ( nif->inherits( job.iSkinInst, "BSDismemberSkinInstance" ) ) {
+			// First find a partition to dump dangling faces.  Torso is prefered if available.
+			quint32 nparts = nif->get<uint>( job.iSkinInst, "Num Partitions" );
+			QModelIndex iPartData = nif->getIndex( job.iSkinInst, "Partitions" );
+
+			for ( quint32 i = 0; i < nparts; ++i ) {
+				QModelIndex iPart = iPartData.child( i, 0 );
 
-				qCWarning( nsSpell ) << Spell::tr( "Reduced %1 vertices to %2 bone influences (maximum number of bones per vertex was %3)" )
-					.arg( c )
-					.arg( maxBonesPerVertex )
-					.arg( maxBones );
+				if ( !iPart.isValid() )
+					continue;
+
+				if ( nif->get<uint>( iPart, "Body Part" ) == 0 /* Torso */ ) {
+					job.defaultPart = i;
+					break;
+				}
 			}
 
-			maxBones = maxBonesPerVertex;
+			job.defaultPart = qMin( nparts - 1, job.defaultPart );
 
-			// reduces bone weights so that the triangles fit into the partitions
+			// enumerate existing partitions and select faces into same partition
+			quint32 nskinparts = nif->get<int>( job.iSkinPart, "Num Partitions" );
+			iPartData = nif->getIndex( job.iSkinPart, "Partitions" );
 
-			QList<Triangle> triangles;
+			for ( quint32 i = 0; i < nskinparts; ++i ) {
+				QModelIndex iPart = iPartData.child( i, 0 );
 
-			if ( iShapeType == "NiTriShape" ) {
-				triangles = nif->getArray<Triangle>( iData, "Triangles" ).toList();
-			} else if ( iShapeType == "NiTriStrips" ) {
-				// triangulate first (code copied from strippify.cpp)
-				QVector<QVector<quint16> > strips;
-				QModelIndex iPoints = nif->getIndex( iData, "Points" );
+				if ( !iPart.isValid() )
+					continue;
 
-				for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
-					QVector<quint16> strip;
-					QModelIndex iStrip = iPoints.child( s, 0 );
+				quint32 finalPart = qMin( nparts - 1, i );
 
-					for ( int p = 0; p < nif->rowCount( iStrip ); p++ ) {
-						strip.append( nif->get<int>( iStrip.child( p, 0 ) ) );
-					}
+				QVector<int> vertmap = nif->getArray<int>( iPart, "Vertex Map" );
 
-					strips.append( strip );
+				quint8 hasFaces  = nif->get<quint8>( iPart, "Has Faces" );
+				quint8 numStrips = nif->get<quint8>( iPart, "Num Strips" );
+				QVector<Triangle> partTriangles;
+
+				if ( hasFaces && numStrips == 0 ) {
+					partTriangles = nif->getArray<Triangle>( iPart, "Triangles" );
+				} else if ( numStrips != 0 ) {
+					partTriangles = triangulate( readStrips( nif, nif->getIndex( iPart, "Strips" ) ) );
 				}
 
-				triangles = triangulate( strips ).toList();
+				for ( int j = 0; j < partTriangles.count(); ++j ) {
+					Triangle tri = partTriangles[j];
+
+					if ( !vertmap.isEmpty() ) {
+						tri[0] = vertmap.value( tri[0] );
+						tri[1] = vertmap.value( tri[1] );
+						tri[2] = vertmap.value( tri[2] );
+					}
+
+					qRotate( tri );
+					job.trimap.insert( tri, finalPart );
+				}
 			}
+		}
+	}
 
-			QMap<Triangle, quint32> trimap;
-			quint32 defaultPart = 0;
+	//! Read an array of strips
+	static QVector<QVector<quint16> > readStrips( const NifModel * nif, const QModelIndex & iPoints )
+	{
+		QVector<QVector<quint16> > strips;
 
-			if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
-				// First find a partition to dump dangling faces.  Torso is prefered if available.
-				quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
-				QModelIndex iPartData = nif->getIndex( iSkinInst, "Partitions" );
+		for ( int s = 0; s < nif->rowCount( iPoints ); s++ )
+			strips.append( nif->getArray<quint16>( iPoints.child( s, 0 ) ) );
 
-				for ( quint32 i = 0; i < nparts; ++i ) {
-					QModelIndex iPart = iPartData.child( i, 0 );
+		return strips;
+	}
 
-					if ( !iPart.isValid() )
-						continue;
+	//! Bones used by a triangle
+	static QBitArray triangleBones( const QVector<QList<boneweight> > & weights, const Triangle & tri, int numBones )
+	{
+		QBitArray bones( numBones );
 
-					if ( nif->get<uint>( iPart, "Body Part" ) == 0 /* Torso */ ) {
-						defaultPart = i;
-						break;
-					}
-				}
+		for ( int c = 0; c < 3; c++ ) {
+			for ( const auto & bw : weights[tri[c]] )
+				bones.setBit( bw.first );
+		}
 
-				defaultPart = qMin( nparts - 1, defaultPart );
+		return bones;
+	}
 
-				// enumerate existing partitions and select faces into same partition
-				quint32 nskinparts = nif->get<int>( iSkinPart, "Num Partitions" );
-				iPartData = nif->getIndex( iSkinPart, "Partitions" );
+	//! Split the triangles of a skin into partitions; does not touch the model
+	static void compute( Job & job, int maxBonesPerPartition, int maxBonesPerVertex )
+	{
+		QVector<QList<boneweight> > & weights = job.weights;
+		int numBones = job.numBones;
 
-				for ( quint32 i = 0; i < nskinparts; ++i ) {
-					QModelIndex iPart = iPartData.child( i, 0 );
+		// reduce vertex influences if necessary
 
-					if ( !iPart.isValid() )
-						continue;
+		if ( job.maxInfluences > maxBonesPerVertex ) {
+			int c = 0;
+
+			for ( QList<boneweight> & lst : weights ) {
+				std::sort( lst.begin(), lst.end(), boneweight_equivalence() );
 
-					quint32 finalPart = qMin( nparts - 1, i );
+				if ( lst.count() > maxBonesPerVertex )
+					c++;
 
-					QVector<int> vertmap = nif->getArray<int>( iPart, "Vertex Map" );
+				while ( lst.count() > maxBonesPerVertex ) {
+					lst.removeLast();
+				}
 
-					quint8 hasFaces  = nif->get<quint8>( iPart, "Has Faces" );
-					quint8 numStrips = nif->get<quint8>( iPart, "Num Strips" );
-					QVector<Triangle> partTriangles;
+				float totalWeight = 0;
+				for ( const auto bw : lst ) {
+					totalWeight += bw.second;
+				}
 
-					if ( hasFaces && numStrips == 0 ) {
-						partTriangles = nif->getArray<Triangle>( iPart, "Triangles" );
-					} else if ( numStrips != 0 ) {
-						// triangulate first (code copied from strippify.cpp)
-						QVector<QVector<quint16> > strips;
-						QModelIndex iPoints = nif->getIndex( iPart, "Strips" );
+				for ( int b = 0; b < lst.count(); b++ ) {
+					// normalize
+					lst[b].second /= totalWeight;
+				}
+			}
 
-						for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
-							QVector<quint16> strip;
-							QModelIndex iStrip = iPoints.child( s, 0 );
+			qCWarning( nsSpell ) << Spell::tr( "Reduced %1 vertices to %2 bone influences (maximum number of bones per vertex was %3)" )
+				.arg( c )
+				.arg( maxBonesPerVertex )
+				.arg( job.maxInfluences );
+		}
 
-							for ( int p = 0; p < nif->rowCount( iStrip ); p++ ) {
-								strip.append( nif->get<int>( iStrip.child( p, 0 ) ) );
-							}
+		// reduces bone weights so that the triangles fit into the partitions
 
-							strips.append( strip );
-						}
+		// vertices sharing a position, found on first use
+		QVector<int> welded;
+		QVector<QVector<int> > coincident;
+
+		int cnt = 0;
+
+		for ( const Triangle & tri : job.triangles ) {
+			while ( triangleBones( weights, tri, numBones ).count( true ) > maxBonesPerPartition ) {
+				// sum up the weights for each bone
+				// bones with weight == 1 can't be removed
+
+				QMap<int, float> sum;
+				QList<int> nono;
+
+				for ( int t = 0; t < 3; t++ ) {
+					if ( weights[tri[t]].count() == 1 )
+						nono.append( weights[tri[t]].first().first );
 
-						partTriangles = triangulate( strips );
+					for ( const auto bw : weights[tri[t]] ) {
+						sum[ bw.first ] += bw.second;
 					}
+				}
 
-					for ( int j = 0; j < partTriangles.count(); ++j ) {
-						Triangle t = partTriangles[j];
-						Triangle tri = t;
+				// select the bone to remove
 
-						if ( !vertmap.isEmpty() ) {
-							tri[0] = vertmap[tri[0]];
-							tri[1] = vertmap[tri[1]];
-							tri[2] = vertmap[tri[2]];
-						}
+				float minWeight = 5.0;
+				int minBone = -1;
 
-						qRotate( tri );
-						trimap.insert( tri, finalPart );
+				for ( const auto b : sum.keys() ) {
+					if ( !nono.contains( b ) && sum[b] < minWeight ) {
+						minWeight = sum[b];
+						minBone = b;
 					}
 				}
-			}
 
-			QMap<int, int> match;
-			bool doMatch = true;
+				if ( minBone < 0 )  // this shouldn't never happen
+					throw QString( "internal error 0x01" );
 
-			QList<int> tribones;
+				// do a vertex match detect
 
-			int cnt = 0;
+				if ( welded.isEmpty() ) {
+					VertexWeld weld( job.verts.count() );
+					weld.addAttribute( job.verts );
+					welded = weld.weld();
+					coincident.resize( welded.count() );
 
-			for ( const Triangle& tri : triangles )
-			{
-				do {
-					tribones.clear();
+					for ( int v = 0; v < welded.count(); v++ )
+						coincident[welded[v]].append( v );
+				}
+
+				// vertices at the same position with the same weights
+				QVector<int> match[3];
 
-					for ( int c = 0; c < 3; c++ ) {
-						for ( const auto bw : weights[tri[c]] ) {
-							if ( !tribones.contains( bw.first ) )
-								tribones.append( bw.first );
+				for ( int t = 0; t < 3; t++ ) {
+					int v = tri[t];
+
+					if ( v < welded.count() ) {
+						for ( const auto m : coincident[welded[v]] ) {
+							if ( weights[m] == weights[v] )
+								match[t].append( m );
 						}
+					} else {
+						match[t].append( v );
 					}
+				}
 
-					if ( tribones.count() > maxBonesPerPartition ) {
-						// sum up the weights for each bone
-						// bones with weight == 1 can't be removed
+				// now remove that bone from all vertices of this triangle and from all matching vertices too
 
-						QMap<int, float> sum;
-						QList<int> nono;
+				for ( int t = 0; t < 3; t++ ) {
+					bool rem = false;
+					for ( const auto v : match[t] )
+					{
+						QList<boneweight> & bws = weights[ v ];
+						QMutableListIterator<boneweight> it( bws );
 
-						for ( int t = 0; t < 3; t++ ) {
-							if ( weights[tri[t]].count() == 1 )
-								nono.append( weights[tri[t]].first().first );
+						while ( it.hasNext() ) {
+							boneweight & bw = it.next();
 
-							for ( const auto bw : weights[tri[t]] ) {
-								sum[ bw.first ] += bw.second;
+							if ( bw.first == minBone ) {
+								it.remove();
+								rem = true;
 							}
 						}
 
-						// select the bone to remove
+						float totalWeight = 0;
+						for ( const auto bw : bws ) {
+							totalWeight += bw.second;
+						}
 
-						float minWeight = 5.0;
-						int minBone = -1;
+						if ( totalWeight == 0 )
+							throw QString( "internal error 0x02" );
 
-						for ( const auto b : sum.keys() ) {
-							if ( !nono.contains( b ) && sum[b] < minWeight ) {
-								minWeight = sum[b];
-								minBone = b;
-							}
+						for ( int b = 0; b < bws.count(); b++ ) {
+							// normalize
+							bws[b].second /= totalWeight;
 						}
+					}
 
-						if ( minBone < 0 )  // this shouldn't never happen
-							throw QString( "internal error 0x01" );
+					if ( rem )
+						cnt++;
+				}
+			}
+		}
 
-						// do a vertex match detect
+		if ( cnt > 0 )
+			qCWarning( nsSpell ) << Spell::tr( "Removed %1 bone influences" ).arg( cnt );
 
-						if ( doMatch ) {
-							QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+		// split the triangles into partitions
 
-							for ( int a = 0; a < verts.count(); a++ ) {
-								match.insertMulti( a, a );
+		const QVector<Triangle> & triangles = job.triangles;
+		int numTris = triangles.count();
 
-								for ( int b = a + 1; b < verts.count(); b++ ) {
-									if ( verts[a] == verts[b] && weights[a] == weights[b] ) {
-										match.insertMulti( a, b );
-										match.insertMulti( b, a );
-									}
-								}
-							}
-						}
+		QVector<QBitArray> tribones( numTris );
+		for ( int t = 0; t < numTris; t++ )
+			tribones[t] = triangleBones( weights, triangles[t], numBones );
 
-						// now remove that bone from all vertices of this triangle and from all matching vertices too
+		QList<Partition> & parts = job.parts;
+		QVector<QBitArray> partbones;
+		QVector<bool> assigned( numTris, false );
 
-						for ( int t = 0; t < 3; t++ ) {
-							bool rem = false;
-							for ( const auto v : match.values( tri[t] ) )
-							{
-								QList<boneweight> & bws = weights[ v ];
-								QMutableListIterator<boneweight> it( bws );
+		if ( !job.trimap.isEmpty() ) {
+			for ( int t = 0; t < numTris; t++ ) {
+				Triangle tri = triangles[t];
+				qRotate( tri );
+				int partIdx = job.trimap.value( tri, job.defaultPart );
 
-								while ( it.hasNext() ) {
-									boneweight & bw = it.next();
-
-									if ( bw.first == minBone ) {
-										it.remove();
-										rem = true;
-									}
-								}
+				// Ensure enough partitions
+				while ( partIdx >= parts.count() ) {
+					parts.append( Partition() );
+					partbones.append( QBitArray( numBones ) );
+				}
 
-								float totalWeight = 0;
-								for ( const auto bw : bws ) {
-									totalWeight += bw.second;
-								}
+				partbones[partIdx] |= tribones[t];
+				parts[partIdx].triangles.append( tri );
+				assigned[t] = true;
+			}
+		}
 
-								if ( totalWeight == 0 )
-									throw QString( "internal error 0x02" );
+		// Grow each partition from a seed triangle: first every triangle whose bones are
+		// already in the partition, then the adjacent triangle adding the fewest new bones
 
-								for ( int b = 0; b < bws.count(); b++ ) {
-									// normalize
-									bws[b].second /= totalWeight;
-								}
-							}
+		QVector<QVector<int> > boneTris( numBones );
+		QVector<QVector<int> > vertTris( job.numVerts );
 
-							if ( rem )
-								cnt++;
-						}
-					}
-				} while ( tribones.count() > maxBonesPerPartition );
+		for ( int t = 0; t < numTris; t++ ) {
+			for ( int b = 0; b < numBones; b++ ) {
+				if ( tribones[t].testBit( b ) )
+					boneTris[b].append( t );
 			}
 
-			if ( cnt > 0 )
-				qCWarning( nsSpell ) << Spell::tr( "Removed %1 bone influences" ).arg( cnt );
+			for ( int c = 0; c < 3; c++ )
+				vertTris[triangles[t][c]].append( t );
+		}
 
-			// split the triangles into partitions
+		// number of bones of each triangle that are not in the partition yet
+		QVector<int> missing( numTris );
+		QVector<bool> inFrontier( numTris );
+		int next = 0;
 
-			bool merged = true;
+		while ( true ) {
+			while ( next < numTris && assigned[next] )
+				next++;
 
-			QList<Partition> parts;
+			if ( next >= numTris )
+				break;
 
-			if ( !trimap.isEmpty() ) {
-				QMutableListIterator<Triangle> it( triangles );
+			for ( int t = next; t < numTris; t++ ) {
+				missing[t] = tribones[t].count( true );
+				inFrontier[t] = false;
+			}
 
-				while ( it.hasNext() ) {
-					Triangle tri = it.next();
-					qRotate( tri );
-					QMap<Triangle, quint32>::iterator partItr = trimap.find( tri );
-					int partIdx = ( partItr != trimap.end() ) ? partItr.value() : defaultPart;
+			Partition part;
+			QBitArray bones( numBones );
+			int boneCount = 0;
+			QVector<bool> usedVerts( job.numVerts, false );
 
-					if ( partIdx >= 0 ) {
-						//Triangle & tri = *it;
+			typedef QPair<int, int> Candidate;
+			std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > frontier;
+			QVector<int> ready;
 
-						// Ensure enough partitions
-						while ( partIdx >= int( parts.size() ) )
-							parts.push_back( Partition() );
+			auto addTriangle = [&]( int t ) {
+				assigned[t] = true;
+				part.triangles.append( triangles[t] );
 
-						Partition & part = parts[partIdx];
+				for ( int b = 0; b < numBones; b++ ) {
+					if ( !tribones[t].testBit( b ) || bones.testBit( b ) )
+						continue;
 
-						QList<int> tribones;
+					bones.setBit( b );
+					boneCount++;
 
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
+					for ( const auto u : boneTris[b] ) {
+						if ( assigned[u] )
+							continue;
 
-						part.bones = mergeBones( part.bones, tribones );
-						part.triangles.append( tri );
-						it.remove();
+						if ( --missing[u] == 0 )
+							ready.append( u );
+						else if ( inFrontier[u] )
+							frontier.push( Candidate( missing[u], u ) );
 					}
 				}
 
-				merged = false; // when explicit mapping enabled, no merging is allowed
-			}
+				for ( int c = 0; c < 3; c++ ) {
+					int v = triangles[t][c];
 
-			while ( !triangles.isEmpty() ) {
-				Partition part;
-
-				QHash<int, bool> usedVerts;
+					if ( usedVerts[v] )
+						continue;
 
-				bool addtriangles;
+					usedVerts[v] = true;
 
-				do {
-					QMutableListIterator<Triangle> it( triangles );
+					for ( const auto u : vertTris[v] ) {
+						if ( !assigned[u] && !inFrontier[u] ) {
+							inFrontier[u] = true;
+							frontier.push( Candidate( missing[u], u ) );
+						}
+					}
+				}
+			};
 
-					while ( it.hasNext() ) {
-						Triangle & tri = it.next();
+			addTriangle( next );
 
-						QList<int> tribones;
+			while ( true ) {
+				while ( !ready.isEmpty() ) {
+					int t = ready.takeLast();
 
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
+					if ( !assigned[t] )
+						addTriangle( t );
+				}
 
-						if ( part.bones.isEmpty() || containsBones( part.bones, tribones ) ) {
-							part.bones = mergeBones( part.bones, tribones );
-							part.triangles.append( tri );
-							usedVerts[ tri[0] ] = true;
-							usedVerts[ tri[1] ] = true;
-							usedVerts[ tri[2] ] = true;
-							it.remove();
-						}
-					}
+				// if we have room left in the partition then add an adjacent triangle
+				int t = -1;
 
-					addtriangles = false;
+				while ( t < 0 && !frontier.empty() ) {
+					Candidate c = frontier.top();
+					frontier.pop();
 
-					if ( part.bones.count() < maxBonesPerPartition ) {
-						// if we have room left in the partition then add an adjacent triangle
-						it.toFront();
+					// skip stale entries; a triangle that does not fit now never will
+					if ( !assigned[c.second] && c.first == missing[c.second] && boneCount + c.first <= maxBonesPerPartition )
+						t = c.second;
+				}
 
-						while ( it.hasNext() ) {
-							Triangle & tri = it.next();
-
-							if ( usedVerts.contains( tri[0] ) || usedVerts.contains( tri[1] ) || usedVerts.contains( tri[2] ) ) {
-								QList<int> tribones;
-
-								for ( int c = 0; c < 3; c++ ) {
-									for ( const auto bw : weights[tri[c]] ) {
-										if ( !tribones.contains( bw.first ) )
-											tribones.append( bw.first );
-									}
-								}
-
-								tribones = mergeBones( part.bones, tribones );
-
-								if ( tribones.count() <= maxBonesPerPartition ) {
-									part.bones = tribones;
-									part.triangles.append( tri );
-									usedVerts[ tri[0] ] = true;
-									usedVerts[ tri[1] ] = true;
-									usedVerts[ tri[2] ] = true;
-									it.remove();
-									addtriangles = true;
-									//break;
-								}
-							}
-						}
-					}
-				} while ( addtriangles );
+				if ( t < 0 )
+					break;
 
-				parts.append( part );
+				addTriangle( t );
 			}
 
-			//qDebug() << parts.count() << "small partitions";
-
-			// merge partitions
+			parts.append( part );
+			partbones.append( bones );
+		}
 
-			while ( merged ) {
-				merged = false;
+		// merge partitions
 
-				for ( int p1 = 0; p1 < parts.count() && !merged; p1++ ) {
-					if ( parts[p1].bones.count() < maxBonesPerPartition ) {
-						for ( int p2 = p1 + 1; p2 < parts.count() && !merged; p2++ ) {
-							QList<int> mergedBones = mergeBones( parts[p1].bones, parts[p2].bones );
+		if ( job.trimap.isEmpty() ) {
+			for ( int p1 = 0; p1 < parts.count(); p1++ ) {
+				for ( int p2 = p1 + 1; p2 < parts.count(); ) {
+					QBitArray merged = partbones[p1] | partbones[p2];
 
-							if ( mergedBones.count() <= maxBonesPerPartition ) {
-								parts[p1].bones = mergedBones;
-								parts[p1].triangles << parts[p2].triangles;
-								parts.removeAt( p2 );
-								merged = true;
-							}
-						}
+					if ( merged.count( true ) <= maxBonesPerPartition ) {
+						partbones[p1] = merged;
+						parts[p1].triangles << parts[p2].triangles;
+						parts.removeAt( p2 );
+						partbones.remove( p2 );
+					} else {
+						p2++;
 					}
 				}
 			}
+		}
 
-			//qDebug() << parts.count() << "partitions";
+		// sort the bone weights by weight
+		for ( QList<boneweight> & bw : weights )
+			std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
 
-			// create the NiSkinPartition if it doesn't exist yet
+		for ( int p = 0; p < parts.count(); p++ ) {
+			Partition & part = parts[p];
 
-			if ( !iSkinPart.isValid() ) {
-				iSkinPart = nif->insertNiBlock( "NiSkinPartition", nif->getBlockNumber( iSkinData ) + 1 );
-				nif->setLink( iSkinInst, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
-				nif->setLink( iSkinData, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+			for ( int b = 0; b < numBones; b++ ) {
+				if ( partbones[p].testBit( b ) )
+					part.bones.append( b );
 			}
 
-			// start writing NiSkinPartition
+			// order for the vertex cache, then number the vertices in order of first use
 
-			nif->set<int>( iSkinPart, "Num Partitions", parts.count() );
-			nif->updateArray( iSkinPart, "Partitions" );
+			part.triangles = MeshOptimizer::optimizeVertexCache( part.triangles, job.numVerts );
 
-			QModelIndex iBSSkinInstPartData;
+			QVector<int> vidx( job.numVerts, -1 );
+			for ( Triangle & tri : part.triangles ) {
+				for ( int t = 0; t < 3; t++ ) {
+					int v = tri[t];
 
-			if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
-				quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
-				iBSSkinInstPartData = nif->getIndex( iSkinInst, "Partitions" );
+					if ( vidx[v] < 0 ) {
+						vidx[v] = part.vertices.count();
+						part.vertices.append( v );
+					}
 
-				// why is QList.count() signed? cast to squash warning
-				if ( nparts != (quint32)parts.count() ) {
-					qCWarning( nsSpell ) << "BSDismemberSkinInstance partition count does not match Skin Partition count.  Adjusting to fit.";
-					nif->set<uint>( iSkinInst, "Num Partitions", parts.count() );
-					nif->updateArray( iSkinInst, "Partitions" );
+					tri[t] = vidx[v];
 				}
 			}
+		}
+	}
 
-			QList<int> prevPartBones;
+	//! Write the partitions of a skin to its NiSkinPartition
+	static void write( NifModel * nif, const Job & job, int maxBonesPerPartition, int maxBones, bool make_strips, bool pad )
+	{
+		QModelIndex iSkinInst = job.iSkinInst;
+		QModelIndex iSkinData = job.iSkinData;
+		QModelIndex iSkinPart = job.iSkinPart;
+		const QList<Partition> & parts = job.parts;
 
-			for ( int p = 0; p < parts.count(); p++ ) {
-				QModelIndex iPart = nif->getIndex( iSkinPart, "Partitions" ).child( p, 0 );
+		// create the NiSkinPartition if it doesn't exist yet
 
-				QList<int> bones = parts[p].bones;
-				std::sort( bones.begin(), bones.end() /*, std::less<int>()*/ );
+		if ( !iSkinPart.isValid() ) {
+			iSkinPart = nif->insertNiBlock( "NiSkinPartition", nif->getBlockNumber( iSkinData ) + 1 );
+			nif->setLink( iSkinInst, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+			nif->setLink( iSkinData, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+		}
 
-				// set partition flags for bs skin instance if present
-				if ( iBSSkinInstPartData.isValid() ) {
-					if ( bones != prevPartBones ) {
-						prevPartBones = bones;
-						nif->set<uint>( iBSSkinInstPartData.child( p, 0 ), "Part Flag", 257 );
-					}
-				}
+		// start writing NiSkinPartition
 
-				QVector<Triangle> triangles = parts[p].triangles;
+		nif->beginTransaction();
 
-				// Create the vertex map
+		nif->set<int>( iSkinPart, "Num Partitions", parts.count() );
+		nif->updateArray( iSkinPart, "Partitions" );
 
-				int idx = 0;
-				QVector<int> vidx( numVerts, -1 );
-				for ( const Triangle& tri : triangles ) {
-					for ( int t = 0; t < 3; t++ ) {
-						int v = tri[t];
+		QModelIndex iBSSkinInstPartData;
 
-						if ( vidx[v] < 0 )
-							vidx[v] = idx++;
-					}
-				}
-				QVector<int> vertices( idx, -1 );
+		if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
+			quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
+			iBSSkinInstPartData = nif->getIndex( iSkinInst, "Partitions" );
 
-				for ( int i = 0; i < numVerts; ++i ) {
-					int v = vidx[i];
+			// why is QList.count() signed? cast to squash warning
+			if ( nparts != (quint32)parts.count() ) {
+				qCWarning( nsSpell ) << "BSDismemberSkinInstance partition count does not match Skin Partition count.  Adjusting to fit.";
+				nif->set<uint>( iSkinInst, "Num Partitions", parts.count() );
+				nif->updateArray( iSkinInst, "Partitions" );
+			}
+		}
 
-					if ( v >= 0 ) {
-						vertices[v] = i;
-					}
-				}
+		QList<int> prevPartBones;
 
-				// map the vertices
+		for ( int p = 0; p < parts.count(); p++ ) {
+			QModelIndex iPart = nif->getIndex( iSkinPart, "Partitions" ).child( p, 0 );
 
-				for ( int tri = 0; tri < triangles.count(); tri++ ) {
-					for ( int t = 0; t < 3; t++ ) {
-						triangles[tri][t] = vertices.indexOf( triangles[tri][t] );
-					}
+			QList<int> bones = parts[p].bones;
+
+			// set partition flags for bs skin instance if present
+			if ( iBSSkinInstPartData.isValid() ) {
+				if ( bones != prevPartBones ) {
+					prevPartBones = bones;
+					nif->set<uint>( iBSSkinInstPartData.child( p, 0 ), "Part Flag", 257 );
 				}
+			}
 
-				// stripify the triangles
-				QVector<QVector<quint16> > strips;
-				int numTriangles = 0;
+			const QVector<Triangle> & triangles = parts[p].triangles;
+			const QVector<int> & vertices = parts[p].vertices;
 
-				if ( make_strips == true ) {
-					strips = stripify( triangles );
+			// stripify the triangles
+			QVector<QVector<quint16> > strips;
+			int numTriangles = 0;
 
-					for ( const QVector<quint16>& strip : strips ) {
-						numTriangles += strip.count() - 2;
-					}
-				} else {
-					numTriangles = triangles.count();
-				}
+			if ( make_strips == true ) {
+				strips = stripify( triangles );
 
-				// fill in counts
-				if ( pad ) {
-					while ( bones.size() < maxBonesPerPartition ) {
-						bones.append( 0 );
-					}
+				for ( const QVector<quint16>& strip : strips ) {
+					numTriangles += strip.count() - 2;
 				}
+			} else {
+				numTriangles = triangles.count();
+			}
 
-				// resort the bone weights in bone order
-				QMutableVectorIterator<QList<boneweight> > it( weights );
-
-				while ( it.hasNext() ) {
-					QList<boneweight> & bw = it.next();
-					std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
+			// fill in counts
+			if ( pad ) {
+				while ( bones.size() < maxBonesPerPartition ) {
+					bones.append( 0 );
 				}
+			}
 
-				nif->set<int>( iPart, "Num Vertices", vertices.count() );
-				nif->set<int>( iPart, "Num Triangles", numTriangles );
-				nif->set<int>( iPart, "Num Bones", bones.count() );
-				nif->set<int>( iPart, "Num Strips", strips.count() );
-				nif->set<int>( iPart, "Num Weights Per Vertex", maxBones );
+			nif->set<int>( iPart, "Num Vertices", vertices.count() );
+			nif->set<int>( iPart, "Num Triangles", numTriangles );
+			nif->set<int>( iPart, "Num Bones", bones.count() );
+			nif->set<int>( iPart, "Num Strips", strips.count() );
+			nif->set<int>( iPart, "Num Weights Per Vertex", maxBones );
 
-				// fill in bone map
+			// fill in bone map
 
-				QModelIndex iBoneMap = nif->getIndex( iPart, "Bones" );
-				nif->updateArray( iBoneMap );
-				nif->setArray<int>( iBoneMap, bones.toVector() );
+			QModelIndex iBoneMap = nif->getIndex( iPart, "Bones" );
+			nif->updateArray( iBoneMap );
+			nif->setArray<int>( iBoneMap, bones.toVector() );
 
-				// fill in vertex map
+			// fill in vertex map
 
-				nif->set<int>( iPart, "Has Vertex Map", 1 );
-				QModelIndex iVertexMap = nif->getIndex( iPart, "Vertex Map" );
-				nif->updateArray( iVertexMap );
-				nif->setArray<int>( iVertexMap, vertices );
+			nif->set<int>( iPart, "Has Vertex Map", 1 );
+			QModelIndex iVertexMap = nif->getIndex( iPart, "Vertex Map" );
+			nif->updateArray( iVertexMap );
+			nif->setArray<int>( iVertexMap, vertices );
 
-				// fill in vertex weights
+			// fill in vertex weights and bones
 
-				nif->set<int>( iPart, "Has Vertex Weights", 1 );
-				QModelIndex iVWeights = nif->getIndex( iPart, "Vertex Weights" );
-				nif->updateArray( iVWeights );
+			nif->set<int>( iPart, "Has Vertex Weights", 1 );
+			QModelIndex iVWeights = nif->getIndex( iPart, "Vertex Weights" );
+			nif->updateArray( iVWeights );
 
-				for ( int v = 0; v < nif->rowCount( iVWeights ); v++ ) {
-					QModelIndex iVertex = iVWeights.child( v, 0 );
-					nif->updateArray( iVertex );
-					QList<boneweight> list = weights.value( vertices[v] );
+			nif->set<int>( iPart, "Has Bone Indices", 1 );
+			QModelIndex iVBones = nif->getIndex( iPart, "Bone Indices" );
+			nif->updateArray( iVBones );
 
-					for ( int b = 0; b < maxBones; b++ )
-						nif->set<float>( iVertex.child( b, 0 ), list.count() > b ? list[ b ].second : 0.0 );
-				}
+			QVector<float> vweights( maxBones );
+			QVector<int> vbones( maxBones );
 
-				nif->set<int>( iPart, "Has Faces", 1 );
+			for ( int v = 0; v < vertices.count(); v++ ) {
+				const QList<boneweight> & list = job.weights[ vertices[v] ];
 
-				if ( make_strips == true ) {
-					//Clear out any existing triangle data that might be left over from an existing Skin Partition
-					QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
-					nif->updateArray( iTriangles );
+				for ( int b = 0; b < maxBones; b++ ) {
+					vweights[b] = list.count() > b ? list[ b ].second : 0.0;
+					vbones[b] = list.count() > b ? bones.indexOf( list[ b ].first ) : 0;
+				}
 
-					// write the strips
-					QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
-					nif->updateArray( iStripLengths );
+				QModelIndex iVertex = iVWeights.child( v, 0 );
+				nif->updateArray( iVertex );
+				nif->setArray<float>( iVertex, vweights );
 
-					for ( int s = 0; s < nif->rowCount( iStripLengths ); s++ )
-						nif->set<int>( iStripLengths.child( s, 0 ), strips.value( s ).count() );
+				iVertex = iVBones.child( v, 0 );
+				nif->updateArray( iVertex );
+				nif->setArray<int>( iVertex, vbones );
+			}
 
-					QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
-					nif->updateArray( iStrips );
+			nif->set<int>( iPart, "Has Faces", 1 );
 
-					for ( int s = 0; s < nif->rowCount( iStrips ); s++ ) {
-						nif->updateArray( iStrips.child( s, 0 ) );
-						nif->setArray<quint16>( iStrips.child( s, 0 ), strips.value( s ) );
-					}
-				} else {
-					//Clear out any existing strip data that might be left over from an existing Skin Partition
-					QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
-					nif->updateArray( iStripLengths );
-					QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
-					nif->updateArray( iStrips );
-
-					QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
-					nif->updateArray( iTriangles );
-					nif->setArray<Triangle>( iTriangles, triangles );
-				}
+			if ( make_strips == true ) {
+				//Clear out any existing triangle data that might be left over from an existing Skin Partition
+				QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
+				nif->updateArray( iTriangles );
 
-				// fill in vertex bones
+				// write the strips
+				QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
+				nif->updateArray( iStripLengths );
 
-				nif->set<int>( iPart, "Has Bone Indices", 1 );
-				QModelIndex iVBones = nif->getIndex( iPart, "Bone Indices" );
-				nif->updateArray( iVBones );
+				for ( int s = 0; s < nif->rowCount( iStripLengths ); s++ )
+					nif->set<int>( iStripLengths.child( s, 0 ), strips.value( s ).count() );
 
-				for ( int v = 0; v < nif->rowCount( iVBones ); v++ ) {
-					QModelIndex iVertex = iVBones.child( v, 0 );
-					nif->updateArray( iVertex );
-					QList<boneweight> list = weights.value( vertices[v] );
+				QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
+				nif->updateArray( iStrips );
 
-					for ( int b = 0; b < maxBones; b++ )
-						nif->set<int>( iVertex.child( b, 0 ), list.count() > b ? bones.indexOf( list[ b ].first ) : 0 );
+				for ( int s = 0; s < nif->rowCount( iStrips ); s++ ) {
+					nif->updateArray( iStrips.child( s, 0 ) );
+					nif->setArray<quint16>( iStrips.child( s, 0 ), strips.value( s ) );
 				}
+			} else {
+				//Clear out any existing strip data that might be left over from an existing Skin Partition
+				QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
+				nif->updateArray( iStripLengths );
+				QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
+				nif->updateArray( iStrips );
+
+				QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
+				nif->updateArray( iTriangles );
+				nif->setArray<Triangle>( iTriangles, triangles );
 			}
-
-			// done
-
-			return iShape;
 		}
-		catch ( QString & err )
-		{
-			if ( !err.isEmpty() )
-				QMessageBox::warning( 0, "NifSkope", err );
 
-			return iShape;
-		}
-	}
+		// done
 
-	static QList<int> mergeBones( QList<int> a, QList<int> b )
-	{
-		for ( const auto c : b ) {
-			if ( !a.contains( c ) ) {
-				a.append( c );
-			}
-		}
-		return a;
-	}
-
-	static bool containsBones( QList<int> a, QList<int> b )
-	{
-		for ( const auto c : b ) {
-			if ( !a.contains( c ) )
-				return false;
-		}
-		return true;
+		nif->commitTransaction();
 	}
 };
 
@@ -1028,12 +1100,7 @@ public:
 				indices.append( idx );
 		}
 
-		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
-
-		for ( const QModelIndex& idx : indices ) {
-			Partitioner.cast( nif, idx, mbpp, mbpv, make_strips );
-		}
+		spSkinPartition::partition( nif, indices );
 
 		qCWarning( nsSpell ) << Spell::tr( "did %1 partitions" ).arg( indices.count() );
 
@@ -2,9 +2,12 @@
 
 #include "blocks.h"
 #include "gl/gltools.h"
+#include "gl/gltools/meshoptimizer.h"
 
 #include "lib/nvtristripwrapper.h"
 
+#include <QtConcurrent/QtConcurrentMap>
+
 #include <climits>
 
 
@@ -30,6 +33,7 @@ template <typename T> void copyValue( NifModel * nif, const QModelIndex & iDst,
 
 class spStripify final : public Spell
 {
+public:
 	QString name() const override final { return Spell::tr( "Stripify" ); }
 	QString page() const override final { return Spell::tr( "Mesh" ); }
 
@@ -40,33 +44,32 @@ class spStripify final : public Spell
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		QPersistentModelIndex idx = index;
-		QPersistentModelIndex iData = nif->getBlock( nif->getLink( idx, "Data" ), "NiTriShapeData" );
+		return apply( nif, index, stripify( triangles( nif, index ), true ) );
+	}
 
-		if ( !iData.isValid() )
-			return idx;
+	//! The non-degenerate triangles of a NiTriShape
+	static QVector<Triangle> triangles( const NifModel * nif, const QModelIndex & index )
+	{
+		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ), "NiTriShapeData" );
 
 		QVector<Triangle> triangles;
-		QModelIndex iTriangles = nif->getIndex( iData, "Triangles" );
-
-		if ( !iTriangles.isValid() )
-			return idx;
-
-		int skip = 0;
-
-		for ( int t = 0; t < nif->rowCount( iTriangles ); t++ ) {
-			Triangle tri = nif->get<Triangle>( iTriangles.child( t, 0 ) );
 
+		for ( const Triangle & tri : nif->getArray<Triangle>( iData, "Triangles" ) ) {
 			if ( tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0] )
 				triangles.append( tri );
-			else
-				skip++;
 		}
 
-		//qDebug() << "num triangles" << triangles.count() << "skipped" << skip;
+		return triangles;
+	}
 
+	//! Replace the NiTriShapeData of a NiTriShape by NiTriStripsData holding the strips
+	static QModelIndex apply( NifModel * nif, const QModelIndex & index, const QVector<QVector<quint16> > & strips )
+	{
+		QPersistentModelIndex idx = index;
+		QPersistentModelIndex iData = nif->getBlock( nif->getLink( idx, "Data" ), "NiTriShapeData" );
 
-		QVector<QVector<quint16> > strips = stripify( triangles, true );
+		if ( !iData.isValid() || !nif->getIndex( iData, "Triangles" ).isValid() )
+			return idx;
 
 		if ( strips.count() <= 0 )
 			return idx;
@@ -222,10 +225,28 @@ public:
 
 		spStripify Stripper;
 
-		for ( const QModelIndex& idx : iTriShapes ) {
-			Stripper.castIfApplicable( nif, idx );
+		struct Job
+		{
+			QPersistentModelIndex iShape;
+			QVector<Triangle> triangles;
+			QVector<QVector<quint16> > strips;
+		};
+
+		QVector<Job> jobs;
+
+		for ( const QPersistentModelIndex & idx : iTriShapes ) {
+			if ( Stripper.isApplicable( nif, idx ) )
+				jobs.append( { idx, spStripify::triangles( nif, idx ), {} } );
 		}
 
+		// The strips do not depend on the model, build them in parallel
+		QtConcurrent::blockingMap( jobs, []( Job & job ) {
+			job.strips = stripify( job.triangles, true );
+		} );
+
+		for ( const Job & job : jobs )
+			spStripify::apply( nif, job.iShape, job.strips );
+
 		return QModelIndex();
 	}
 };
@@ -233,6 +254,139 @@ public:
 REGISTER_SPELL( spStripifyAll );
 
 
+//! Reorder the triangles of a shape for the vertex cache and to reduce overdraw
+class spOptimizeTriangles final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Optimize Triangle Order" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	//! The block holding the triangles of a shape
+	static QModelIndex getTriangleBlock( const NifModel * nif, const QModelIndex & index )
+	{
+		QModelIndex iShape = nif->getBlock( index );
+
+		if ( nif->isNiBlock( iShape, "NiTriShape" ) )
+			return nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+
+		// Dynamic shapes keep their positions elsewhere; skinned SSE shapes keep the triangles on the partition too
+		if ( nif->inherits( iShape, "BSTriShape" ) && !nif->isNiBlock( iShape, "BSDynamicTriShape" )
+		     && nif->get<int>( iShape, "Data Size" ) > 0 )
+			return iShape;
+
+		return QModelIndex();
+	}
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return getTriangleBlock( nif, index ).isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		optimize( nif, { nif->getBlock( index ) } );
+		return index;
+	}
+
+	//! Reorder the triangles of several shapes, in parallel
+	static void optimize( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+	{
+		struct Job
+		{
+			QPersistentModelIndex iBlock;
+			QVector<Triangle> triangles;
+			QVector<Vector3> verts;
+			MeshOptimizer::CacheStats before;
+			MeshOptimizer::CacheStats after;
+		};
+
+		QVector<Job> jobs;
+
+		for ( const QPersistentModelIndex & iShape : shapes ) {
+			Job job;
+			job.iBlock = getTriangleBlock( nif, iShape );
+
+			if ( !job.iBlock.isValid() )
+				continue;
+
+			job.triangles = nif->getArray<Triangle>( job.iBlock, "Triangles" );
+
+			if ( nif->isNiBlock( job.iBlock, "NiTriShapeData" ) ) {
+				job.verts = nif->getArray<Vector3>( job.iBlock, "Vertices" );
+			} else {
+				QModelIndex iVertData = nif->getIndex( job.iBlock, "Vertex Data" );
+
+				for ( int v = 0; v < nif->rowCount( iVertData ); v++ )
+					job.verts << nif->get<Vector3>( iVertData.child( v, 0 ), "Vertex" );
+			}
+
+			jobs.append( job );
+		}
+
+		QtConcurrent::blockingMap( jobs, []( Job & job ) {
+			job.before = MeshOptimizer::analyzeVertexCache( job.triangles );
+
+			QVector<Triangle> triangles = MeshOptimizer::optimizeVertexCache( job.triangles, job.verts.count() );
+			triangles = MeshOptimizer::optimizeOverdraw( triangles, job.verts );
+
+			job.after = MeshOptimizer::analyzeVertexCache( triangles );
+
+			// Keep the original order if it was already better
+			if ( job.after.misses < job.before.misses )
+				job.triangles = triangles;
+			else
+				job.after = job.before;
+		} );
+
+		for ( const Job & job : jobs ) {
+			if ( job.after.misses < job.before.misses )
+				nif->setArray<Triangle>( job.iBlock, "Triangles", job.triangles );
+
+			Message::append( tr( "Optimized triangle order" ),
+				tr( "Block %1: ACMR %2 -> %3, ATVR %4 -> %5" )
+				.arg( nif->getBlockNumber( job.iBlock ) )
+				.arg( job.before.acmr, 0, 'f', 3 ).arg( job.after.acmr, 0, 'f', 3 )
+				.arg( job.before.atvr, 0, 'f', 3 ).arg( job.after.atvr, 0, 'f', 3 ),
+				QMessageBox::Information
+			);
+		}
+	}
+};
+
+REGISTER_SPELL( spOptimizeTriangles );
+
+
+class spOptimizeAllTriangles final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Optimize All Triangle Orders" ); }
+	QString page() const override final { return Spell::tr( "Optimize" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		QList<QPersistentModelIndex> shapes;
+
+		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
+			QModelIndex idx = nif->getBlock( l );
+
+			if ( spOptimizeTriangles::getTriangleBlock( nif, idx ).isValid() )
+				shapes << idx;
+		}
+
+		spOptimizeTriangles::optimize( nif, shapes );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spOptimizeAllTriangles );
+
+
 class spTriangulate final : public Spell
 {
 	QString name() const override final { return Spell::tr( "Triangulate" ); }
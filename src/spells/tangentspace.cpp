@@ -2,6 +2,8 @@
 
 #include "lib/nvtristripwrapper.h"
 
+#include <QtConcurrent/QtConcurrentMap>
+
 
 bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & index )
 {
@@ -41,6 +43,47 @@ bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & ind
 QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 {
 	QPersistentModelIndex iShape = iBlock;
+
+	update( nif, { iShape } );
+
+	return iShape;
+}
+
+void spTangentSpace::update( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+{
+	// Read all shapes through the model first, the model is not thread safe
+	QVector<Job> jobs;
+	jobs.reserve( shapes.count() );
+
+	for ( const QPersistentModelIndex & iShape : shapes ) {
+		Job job;
+
+		if ( extract( nif, iShape, job ) )
+			jobs.append( job );
+	}
+
+	QtConcurrent::blockingMap( jobs, []( Job & job ) {
+		compute( job );
+	} );
+
+	// Write the results as one update
+	nif->setState( BaseModel::Processing );
+
+	for ( const Job & job : jobs )
+		write( nif, job );
+
+	nif->restoreState();
+
+	// Signal each shape once, unless the caller is holding the updates itself
+	if ( nif->getState() != BaseModel::Processing && nif->getProcessingResult() ) {
+		for ( const Job & job : jobs )
+			emit nif->dataChanged( job.iShape, job.iShape );
+	}
+}
+
+bool spTangentSpace::extract( const NifModel * nif, const QModelIndex & iBlock, Job & job )
+{
+	QModelIndex iShape = iBlock;
 	QModelIndex iData;
 	QModelIndex iPartBlock;
 	if ( nif->getUserVersion2() < 100 ) {
@@ -59,9 +102,9 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Vector3> verts;
-	QVector<Vector3> norms;
-	QVector<Vector2> texco;
+	QVector<Vector3> & verts = job.verts;
+	QVector<Vector3> & norms = job.norms;
+	QVector<Vector2> & texco = job.texco;
 
 	if ( nif->getUserVersion2() < 100 ) {
 		verts = nif->getArray<Vector3>( iData, "Vertices" );
@@ -86,8 +129,6 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Color4> vxcol = nif->getArray<Color4>( iData, "Vertex Colors" );
-
 	if ( nif->getUserVersion2() < 100 ) {
 		QModelIndex iTexCo = nif->getIndex( iData, "UV Sets" );
 		iTexCo = iTexCo.child( 0, 0 );
@@ -95,7 +136,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 
-	QVector<Triangle> triangles;
+	QVector<Triangle> & triangles = job.triangles;
 	QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
 	if ( iPoints.isValid() ) {
@@ -128,26 +169,38 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			.arg( texco.count() )
 			.arg( triangles.count() )
 		);
-		return iBlock;
+		return false;
 	}
 
-	QVector<Vector3> tan( verts.count() );
-	QVector<Vector3> bin( verts.count() );
+	job.iShape = iShape;
+	job.iData = iData;
+	job.iPartBlock = iPartBlock;
+
+	return true;
+}
+
+void spTangentSpace::compute( Job & job )
+{
+	const QVector<Vector3> & verts = job.verts;
+	const QVector<Vector3> & norms = job.norms;
+	const QVector<Vector2> & texco = job.texco;
 
-	QMultiHash<int, int> vmap;
+	QVector<Vector3> & tan = job.tan;
+	QVector<Vector3> & bin = job.bin;
 
-	//int skptricnt = 0;
+	tan.fill( Vector3(), verts.count() );
+	bin.fill( Vector3(), verts.count() );
 
-	for ( int t = 0; t < triangles.count(); t++ ) {
+	for ( const Triangle & tri : job.triangles ) {
 		// for each triangle caculate the texture flow direction
-		//qDebug() << "triangle" << t;
-
-		Triangle & tri = triangles[t];
 
 		int i1 = tri[0];
 		int i2 = tri[1];
 		int i3 = tri[2];
 
+		if ( i1 >= verts.count() || i2 >= verts.count() || i3 >= verts.count() )
+			continue;
+
 		const Vector3 & v1 = verts[i1];
 		const Vector3 & v2 = verts[i2];
 		const Vector3 & v3 = verts[i3];
@@ -164,17 +217,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 
 		float r = w2w1[0] * w3w1[1] - w3w1[0] * w2w1[1];
 
-		/*
-		if ( fabs( r ) <= 10e-10 )
-		{
-		    //if ( skptricnt++ < 3 )
-		    //	qDebug() << t;
-		    continue;
-		}
-
-		r = 1.0 / r;
-		*/
-		// this seems to produces better results
+		// Only the orientation of the texture matters, the magnitude is normalized away
 		r = ( r >= 0 ? +1 : -1 );
 
 		Vector3 sdir(
@@ -189,22 +232,28 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		    ( w2w1[0] * v3v1[2] - w3w1[0] * v2v1[2] ) * r
 		);
 
-		sdir.normalize();
-		tdir.normalize();
-
-		//qDebug() << sdir << tdir;
+		// As in MikkTSpace, each corner projects the face directions onto the plane
+		// of its normal and contributes with the angle of the face at that corner
+		const Vector3 * corner[3] = { &v1, &v2, &v3 };
 
 		for ( int j = 0; j < 3; j++ ) {
 			int i = tri[j];
+			const Vector3 & n = norms[i];
 
-			tan[i] += tdir;
-			bin[i] += sdir;
-		}
-	}
+			Vector3 e1 = *corner[( j + 1 ) % 3] - *corner[j];
+			Vector3 e2 = *corner[( j + 2 ) % 3] - *corner[j];
 
-	//qDebug() << "skipped triangles" << skptricnt;
+			float weight = ( e1.squaredLength() > 0 && e2.squaredLength() > 0 ) ? Vector3::angle( e1, e2 ) : 0.0f;
 
-	//int cnt = 0;
+			Vector3 t = tdir - n * Vector3::dotProduct( n, tdir );
+			Vector3 s = sdir - n * Vector3::dotProduct( n, sdir );
+
+			if ( t.squaredLength() > 0 )
+				tan[i] += t.normalize() * weight;
+			if ( s.squaredLength() > 0 )
+				bin[i] += s.normalize() * weight;
+		}
+	}
 
 	for ( int i = 0; i < verts.count(); i++ ) {
 		// for each vertex calculate tangent and binormal
@@ -213,31 +262,33 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		Vector3 & t = tan[i];
 		Vector3 & b = bin[i];
 
-		//qDebug() << n << t << b;
-
 		if ( t == Vector3() || b == Vector3() ) {
 			t[0] = n[1]; t[1] = n[2]; t[2] = n[0];
 			b = Vector3::crossProduct( n, t );
-			//if ( cnt++ < 3 )
-			//	qDebug() << i;
 		} else {
 			t.normalize();
 			t = ( t - n * Vector3::dotProduct( n, t ) );
 			t.normalize();
 
-			//b = Vector3::crossproduct( n, t );
-
 			b.normalize();
 			b = ( b - n * Vector3::dotProduct( n, b ) );
 			b = ( b - t * Vector3::dotProduct( t, b ) );
 			b.normalize();
 		}
-
-		//qDebug() << n << t << b;
-		//qDebug() << "";
 	}
+}
+
+void spTangentSpace::write( NifModel * nif, const Job & job )
+{
+	QModelIndex iShape = job.iShape;
+	QModelIndex iData = job.iData;
+	QModelIndex iPartBlock = job.iPartBlock;
 
-	//qDebug() << "unassigned vertices" << cnt;
+	const QVector<Vector3> & tan = job.tan;
+	const QVector<Vector3> & bin = job.bin;
+
+	if ( !iShape.isValid() || !iData.isValid() )
+		return;
 
 	bool isOblivion = false;
 
@@ -285,7 +336,8 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		else
 			numVerts = nif->get<int>( iShape, "Num Vertices" );
 
-		nif->setState( BaseModel::Processing );
+		numVerts = qMin( numVerts, tan.count() );
+
 		for ( int i = 0; i < numVerts; i++ ) {
 			auto idx = nif->index( i, 0, iData );
 
@@ -298,10 +350,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			nif->set<quint8>( idx, "Bitangent Y", bitYi );
 			nif->set<quint8>( idx, "Bitangent Z", bitZi );
 		}
-		nif->restoreState();
 	}
-
-	return iShape;
 }
 
 REGISTER_SPELL( spTangentSpace );
@@ -341,9 +390,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
-		}
+		spTangentSpace::update( nif, indices );
 
 		return QModelIndex();
 	}
@@ -365,7 +412,7 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QVector<QModelIndex> blks;
+		QList<QPersistentModelIndex> blks;
 		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
 			QModelIndex idx = nif->getBlock( l, "NiTriShape" );
 			if ( !idx.isValid() )
@@ -389,9 +436,7 @@ public:
 			blks << idx;
 		}
 
-		spTangentSpace update;
-		for ( auto& b : blks )
-			update.cast( nif, b );
+		spTangentSpace::update( nif, blks );
 
 		return QModelIndex();
 	}
@@ -17,6 +17,33 @@ public:
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final;
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final;
+
+	//! Updates the tangent spaces of several shapes, computing them in parallel
+	static void update( NifModel * nif, const QList<QPersistentModelIndex> & shapes );
+
+private:
+	//! The geometry and tangent space of one shape
+	struct Job
+	{
+		QPersistentModelIndex iShape;
+		QPersistentModelIndex iData;
+		QPersistentModelIndex iPartBlock;
+
+		QVector<Vector3> verts;
+		QVector<Vector3> norms;
+		QVector<Vector2> texco;
+		QVector<Triangle> triangles;
+
+		QVector<Vector3> tan;
+		QVector<Vector3> bin;
+	};
+
+	//! Reads the geometry of a shape; false if it is insufficient
+	static bool extract( const NifModel * nif, const QModelIndex & iBlock, Job & job );
+	//! Calculates the tangent space; does not access the model
+	static void compute( Job & job );
+	//! Writes the tangent space to the shape
+	static void write( NifModel * nif, const Job & job );
 };
 
 
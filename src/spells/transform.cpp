@@ -10,12 +10,233 @@
 #include <QDialog>
 #include <QDoubleSpinBox>
 #include <QGridLayout>
+#include <QInputDialog>
 #include <QLabel>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QPushButton>
 #include <QSettings>
 
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+/*
+ * MeshTransform
+ */
+bool MeshTransform::add( const NifModel * nif, const QModelIndex & index, const Matrix & linear, const Vector3 & translation, bool normals )
+{
+	QModelIndex iBlock = nif->getBlock( index );
+	if ( nif->inherits( iBlock, "NiGeometry" ) ) {
+		QModelIndex iData = nif->getBlock( nif->getLink( iBlock, "Data" ), "NiGeometryData" );
+		if ( iData.isValid() )
+			iBlock = iData;
+	}
+
+	Job job;
+	job.iData = iBlock;
+
+	if ( nif->inherits( iBlock, "NiGeometryData" ) ) {
+		job.verts = nif->getArray<Vector3>( iBlock, "Vertices" );
+		if ( normals ) {
+			job.norms = nif->getArray<Vector3>( iBlock, "Normals" );
+			job.tangents = nif->getArray<Vector3>( iBlock, "Tangents" );
+			job.bitangents = nif->getArray<Vector3>( iBlock, "Bitangents" );
+		}
+	} else {
+		QModelIndex iVertData = nif->getIndex( iBlock, "Vertex Data" );
+		int numVerts = nif->rowCount( iVertData );
+		VertexRows rows = ( numVerts > 0 ) ? vertexRows( nif, iVertData ) : VertexRows();
+
+		job.vertexData = true;
+
+		// Skyrim SE skinned shapes keep their vertices on the partition, only the bounds are on the shape
+		if ( rows.vertex < 0 )
+			numVerts = 0;
+
+		job.verts.reserve( numVerts );
+		for ( int i = 0; i < numVerts; i++ )
+			job.verts << nif->get<Vector3>( iVertData.child( i, 0 ).child( rows.vertex, 0 ) );
+
+		if ( normals && rows.normal >= 0 ) {
+			job.norms.reserve( numVerts );
+			for ( int i = 0; i < numVerts; i++ )
+				job.norms << nif->get<ByteVector3>( iVertData.child( i, 0 ).child( rows.normal, 0 ) );
+		}
+
+		if ( normals && rows.tangent >= 0 ) {
+			job.tangents.reserve( numVerts );
+			for ( int i = 0; i < numVerts; i++ )
+				job.tangents << nif->get<ByteVector3>( iVertData.child( i, 0 ).child( rows.tangent, 0 ) );
+		}
+
+		if ( normals && rows.bitangentX >= 0 && rows.bitangentY >= 0 && rows.bitangentZ >= 0 ) {
+			job.bitangents.reserve( numVerts );
+			for ( int i = 0; i < numVerts; i++ ) {
+				QModelIndex iVert = iVertData.child( i, 0 );
+
+				// Unpack Bitangent
+				auto bitX = nif->getValue( iVert.child( rows.bitangentX, 0 ) ).toFloat();
+				auto bitYi = nif->getValue( iVert.child( rows.bitangentY, 0 ) ).toCount();
+				auto bitZi = nif->getValue( iVert.child( rows.bitangentZ, 0 ) ).toCount();
+
+				job.bitangents << Vector3( bitX, (bitYi / 255.0) * 2.0 - 1.0, (bitZi / 255.0) * 2.0 - 1.0 );
+			}
+		}
+	}
+
+	// NiSkinPartition has vertex data but no bounds of its own
+	job.hasBound = nif->getIndex( iBlock, "Bounding Sphere" ).isValid() || nif->getIndex( iBlock, "Radius" ).isValid();
+
+	if ( ( job.verts.isEmpty() && !job.hasBound ) || blocks.contains( nif->getBlockNumber( iBlock ) ) )
+		return false;
+
+	blocks.insert( nif->getBlockNumber( iBlock ) );
+
+	if ( job.hasBound )
+		job.bound = BoundSphere( nif, iBlock );
+
+	job.linear = linear;
+	job.translation = translation;
+	job.normals = normals;
+
+	// Normals transform by the inverse transpose
+	Matrix inv = linear.inverted();
+	for ( int r = 0; r < 3; r++ ) {
+		for ( int c = 0; c < 3; c++ )
+			job.normal( r, c ) = inv( c, r );
+	}
+
+	// Radius grows with the longest axis
+	job.radiusScale = 0;
+	for ( int a = 0; a < 3; a++ ) {
+		job.radiusScale = std::max( job.radiusScale, Vector3( linear( 0, a ), linear( 1, a ), linear( 2, a ) ).length() );
+		job.radiusScale = std::max( job.radiusScale, Vector3( linear( a, 0 ), linear( a, 1 ), linear( a, 2 ) ).length() );
+	}
+
+	jobs << job;
+	return true;
+}
+
+bool MeshTransform::add( const NifModel * nif, const QModelIndex & index, const Transform & t, bool normals )
+{
+	Matrix linear = t.rotation;
+	for ( int r = 0; r < 3; r++ ) {
+		for ( int c = 0; c < 3; c++ )
+			linear( r, c ) *= t.scale;
+	}
+
+	return add( nif, index, linear, t.translation, normals );
+}
+
+void MeshTransform::apply( NifModel * nif )
+{
+	QtConcurrent::blockingMap( jobs, []( Job & job ) {
+		compute( job );
+	} );
+
+	nif->beginTransaction();
+	for ( const Job & job : jobs )
+		write( nif, job );
+	nif->commitTransaction();
+
+	jobs.clear();
+	blocks.clear();
+}
+
+MeshTransform::VertexRows MeshTransform::vertexRows( const NifModel * nif, const QModelIndex & iVertData )
+{
+	// Every vertex shares the layout of the first, so look the fields up once
+	QModelIndex iVert = iVertData.child( 0, 0 );
+
+	VertexRows rows;
+	rows.vertex = nif->getIndex( iVert, "Vertex" ).row();
+	rows.normal = nif->getIndex( iVert, "Normal" ).row();
+	rows.tangent = nif->getIndex( iVert, "Tangent" ).row();
+	rows.bitangentX = nif->getIndex( iVert, "Bitangent X" ).row();
+	rows.bitangentY = nif->getIndex( iVert, "Bitangent Y" ).row();
+	rows.bitangentZ = nif->getIndex( iVert, "Bitangent Z" ).row();
+	return rows;
+}
+
+void MeshTransform::compute( Job & job )
+{
+	const Matrix & linear = job.linear;
+	const Vector3 & translation = job.translation;
+
+	for ( Vector3 & v : job.verts )
+		v = linear * v + translation;
+
+	if ( job.normals ) {
+		for ( Vector3 & n : job.norms )
+			n = ( job.normal * n ).normalize();
+
+		// Tangent and bitangent lie in the surface and follow the linear part
+		for ( Vector3 & t : job.tangents )
+			t = ( linear * t ).normalize();
+
+		for ( Vector3 & b : job.bitangents )
+			b = ( linear * b ).normalize();
+	}
+
+	if ( job.hasBound ) {
+		job.bound.center = linear * job.bound.center + translation;
+		job.bound.radius *= job.radiusScale;
+	}
+}
+
+void MeshTransform::write( NifModel * nif, const Job & job )
+{
+	if ( !job.iData.isValid() )
+		return;
+
+	if ( !job.vertexData ) {
+		nif->setArray<Vector3>( job.iData, "Vertices", job.verts );
+
+		if ( !job.norms.isEmpty() )
+			nif->setArray<Vector3>( job.iData, "Normals", job.norms );
+		if ( !job.tangents.isEmpty() )
+			nif->setArray<Vector3>( job.iData, "Tangents", job.tangents );
+		if ( !job.bitangents.isEmpty() )
+			nif->setArray<Vector3>( job.iData, "Bitangents", job.bitangents );
+	} else if ( !job.verts.isEmpty() ) {
+		QModelIndex iVertData = nif->getIndex( job.iData, "Vertex Data" );
+		VertexRows rows = vertexRows( nif, iVertData );
+
+		int numVerts = std::min( nif->rowCount( iVertData ), job.verts.count() );
+		for ( int i = 0; i < numVerts; i++ ) {
+			QModelIndex iVert = iVertData.child( i, 0 );
+
+			QModelIndex iVertex = iVert.child( rows.vertex, 0 );
+			if ( !nif->set<HalfVector3>( iVertex, job.verts[i] ) )
+				nif->set<Vector3>( iVertex, job.verts[i] );
+
+			if ( i < job.norms.count() )
+				nif->set<ByteVector3>( iVert.child( rows.normal, 0 ), job.norms[i] );
+
+			if ( i < job.tangents.count() )
+				nif->set<ByteVector3>( iVert.child( rows.tangent, 0 ), job.tangents[i] );
+
+			if ( i < job.bitangents.count() ) {
+				// Pack Bitangent
+				const Vector3 & bit = job.bitangents[i];
+				nif->set<float>( iVert.child( rows.bitangentX, 0 ), bit[0] );
+				nif->set<quint8>( iVert.child( rows.bitangentY, 0 ), round( ((bit[1] + 1.0) / 2.0) * 255.0 ) );
+				nif->set<quint8>( iVert.child( rows.bitangentZ, 0 ), round( ((bit[2] + 1.0) / 2.0) * 255.0 ) );
+			}
+		}
+	}
+
+	if ( job.hasBound ) {
+		BoundSphere bound = job.bound;
+		bound.update( nif, job.iData );
+	}
+}
+
+
 bool spApplyTransformation::isApplicable( const NifModel * nif, const QModelIndex & index )
 {
 	return nif->itemType( index ) == "NiBlock" &&
@@ -68,87 +289,24 @@ QModelIndex spApplyTransformation::cast( NifModel * nif, const QModelIndex & ind
 
 		if ( iData.isValid() ) {
 			Transform t( nif, index );
-			QModelIndex iVertices = nif->getIndex( iData, "Vertices" );
-
-			if ( iVertices.isValid() ) {
-				QVector<Vector3> a = nif->getArray<Vector3>( iVertices );
-
-				for ( int v = 0; v < nif->rowCount( iVertices ); v++ )
-					a[v] = t * a[v];
-
-				nif->setArray<Vector3>( iVertices, a );
-
-				auto transformBTN = [nif, iData, &t]( QString str )
-				{
-					QModelIndex idx = nif->getIndex( iData, str );
-					if ( idx.isValid() ) {
-						auto a = nif->getArray<Vector3>( idx );
-						for ( int n = 0; n < a.size(); n++ )
-							a[n] = t.rotation * a[n];
-
-						nif->setArray<Vector3>( idx, a );
-					}
-				};
-
-				if ( !(t.rotation == Matrix()) ) {
-					transformBTN( "Normals" );
-					transformBTN( "Tangents" );
-					transformBTN( "Bitangents" );
-				}
-			}
 
-			auto bound = BoundSphere( nif, iData );
-			bound.center = t * bound.center;
-			bound.radius = t.scale * bound.radius;
-			bound.update( nif, iData );
+			MeshTransform mesh;
+			mesh.add( nif, iData, t, !(t.rotation == Matrix()) );
+			mesh.apply( nif );
 
 			t = Transform();
 			t.writeBack( nif, index );
 		}
 	} else if ( nif->inherits( nif->itemName( index ), "BSTriShape" ) ) {
 		// Should not be used on skinned anyway so do not bother with SSE skinned geometry support
-		QModelIndex iVertData = nif->getIndex( index, "Vertex Data" );
-		if ( !iVertData.isValid() )
+		if ( !nif->getIndex( index, "Vertex Data" ).isValid() )
 			return index;
 
 		Transform t( nif, index );
 
-		// Update Bounding Sphere
-		auto bound = BoundSphere( nif, index );
-		bound.center = t * bound.center;
-		bound.radius = t.scale * bound.radius;
-		bound.update( nif, index );
-
-		nif->setState( BaseModel::Processing );
-		for ( int i = 0; i < nif->rowCount( iVertData ); i++ ) {
-			auto iVert = iVertData.child( i, 0 );
-
-			auto vertex = t * nif->get<Vector3>( iVert, "Vertex" );
-			if ( !nif->set<HalfVector3>( iVert, "Vertex", vertex ) )
-				nif->set<Vector3>( iVert, "Vertex", vertex );
-
-			// Transform BTN if applicable
-			if ( !(t.rotation == Matrix()) ) {
-				auto normal = nif->get<ByteVector3>( iVert, "Normal" );
-				nif->set<ByteVector3>( iVert, "Normal", t.rotation * normal );
-
-				auto tangent = nif->get<ByteVector3>( iVert, "Tangent" );
-				nif->set<ByteVector3>( iVert, "Tangent", t.rotation * tangent );
-
-				// Unpack, Transform, Pack Bitangent
-				auto bitX = nif->getValue( nif->getIndex( iVert, "Bitangent X" ) ).toFloat();
-				auto bitYi = nif->getValue( nif->getIndex( iVert, "Bitangent Y" ) ).toCount();
-				auto bitZi = nif->getValue( nif->getIndex( iVert, "Bitangent Z" ) ).toCount();
-
-				auto bit = t.rotation * Vector3( bitX, (bitYi / 255.0) * 2.0 - 1.0, (bitZi / 255.0) * 2.0 - 1.0 );
-
-				nif->set<float>( iVert, "Bitangent X", bit[0] );
-				nif->set<quint8>( iVert, "Bitangent Y", round( ((bit[1] + 1.0) / 2.0) * 255.0 ) );
-				nif->set<quint8>( iVert, "Bitangent Z", round( ((bit[2] + 1.0) / 2.0) * 255.0 ) );
-			}
-		}
-
-		nif->resetState();
+		MeshTransform mesh;
+		mesh.add( nif, index, t, !(t.rotation == Matrix()) );
+		mesh.apply( nif );
 
 		t = Transform();
 		t.writeBack( nif, index );
@@ -304,6 +462,38 @@ public:
 REGISTER_SPELL( spEditTransformation );
 
 
+//! Collects every block linked below \a root, depth first
+static QList<int> branchBlocks( const NifModel * nif, int root )
+{
+	QList<int> blocks;
+	QSet<int> visited;
+
+	std::function<void( int )> visit = [&]( int b ) {
+		if ( b < 0 || visited.contains( b ) )
+			return;
+
+		visited.insert( b );
+		blocks << b;
+
+		for ( const auto link : nif->getChildLinks( b ) )
+			visit( link );
+	};
+
+	visit( root );
+	return blocks;
+}
+
+//! Queues a shape's geometry, including the vertex data of a Skyrim SE skin partition
+static void addShape( MeshTransform & mesh, const NifModel * nif, const QModelIndex & iShape, const Matrix & linear, bool normals )
+{
+	mesh.add( nif, iShape, linear, Vector3(), normals );
+
+	QModelIndex iSkin = nif->getBlock( nif->getLink( iShape, "Skin" ), "NiSkinInstance" );
+	QModelIndex iPartition = nif->getBlock( nif->getLink( iSkin, "Skin Partition" ), "NiSkinPartition" );
+	if ( iPartition.isValid() && nif->getIndex( iPartition, "Vertex Data" ).isValid() )
+		mesh.add( nif, iPartition, linear, Vector3(), normals );
+}
+
 class spScaleVertices final : public Spell
 {
 public:
@@ -312,7 +502,7 @@ public:
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
 	{
-		return nif->inherits( index, "NiGeometry" );
+		return nif->inherits( index, "NiGeometry" ) || nif->inherits( index, "BSTriShape" ) || nif->inherits( index, "NiNode" );
 	}
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
@@ -350,38 +540,254 @@ public:
 
 		settings.setValue( key, chkNormals->isChecked() );
 
-		QModelIndex iData = nif->getBlock( nif->getLink( nif->getBlock( index ), "Data" ), "NiGeometryData" );
+		Matrix linear;
+		for ( int a = 0; a < 3; a++ )
+			linear( a, a ) = scale[a]->value();
+
+		// On a node, scale every shape below it in its own space
+		MeshTransform mesh;
+		for ( const auto b : branchBlocks( nif, nif->getBlockNumber( index ) ) ) {
+			QModelIndex iShape = nif->getBlock( b );
+			if ( nif->inherits( iShape, "NiGeometry" ) || nif->inherits( iShape, "BSTriShape" ) )
+				addShape( mesh, nif, iShape, linear, chkNormals->isChecked() );
+		}
+
+		mesh.apply( nif );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spScaleVertices );
+
+//! Interpolators and key data that animate the transform of the block itself
+static QSet<int> ownTransformAnimation( const NifModel * nif, int block )
+{
+	QSet<int> blocks;
+
+	auto addInterpolator = [nif, &blocks]( int interp ) {
+		if ( interp < 0 )
+			return;
+
+		blocks.insert( interp );
+
+		int data = nif->getLink( nif->getBlock( interp ), "Data" );
+		if ( data >= 0 )
+			blocks.insert( data );
+	};
+
+	QModelIndex iBlock = nif->getBlock( block );
+	QString name = nif->get<QString>( iBlock, "Name" );
+
+	QSet<int> controllers;
+	for ( int c = nif->getLink( iBlock, "Controller" ); c >= 0 && !controllers.contains( c ); c = nif->getLink( nif->getBlock( c ), "Next Controller" ) ) {
+		controllers.insert( c );
+		QModelIndex iCtrl = nif->getBlock( c );
 
-		QVector<Vector3> vertices = nif->getArray<Vector3>( iData, "Vertices" );
-		QMutableVectorIterator<Vector3> it( vertices );
+		if ( nif->inherits( iCtrl, "NiKeyframeController" ) ) {
+			addInterpolator( nif->getLink( iCtrl, "Interpolator" ) );
 
-		while ( it.hasNext() ) {
-			Vector3 & v = it.next();
+			int data = nif->getLink( iCtrl, "Data" );
+			if ( data >= 0 )
+				blocks.insert( data );
+		} else if ( nif->inherits( iCtrl, "NiControllerManager" ) ) {
+			// Sequences animate the whole branch, only their transform tracks of the block itself belong to it
+			for ( const auto seq : nif->getLinkArray( iCtrl, "Controller Sequences" ) ) {
+				QModelIndex iBlocks = nif->getIndex( nif->getBlock( seq ), "Controlled Blocks" );
 
-			for ( int a = 0; a < 3; a++ )
-				v[a] *= scale[a]->value();
+				for ( int r = 0; r < nif->rowCount( iBlocks ); r++ ) {
+					QModelIndex iCB = iBlocks.child( r, 0 );
+
+					QString nodename = nif->get<QString>( iCB, "Node Name" );
+					if ( nodename.isEmpty() ) {
+						QModelIndex idx = nif->getIndex( iCB, "Node Name Offset" );
+						nodename = idx.sibling( idx.row(), NifModel::ValueCol ).data( NifSkopeDisplayRole ).toString();
+					}
+
+					int interp = nif->getLink( iCB, "Interpolator" );
+					if ( nodename == name && nif->inherits( nif->getBlock( interp ), "NiTransformInterpolator" ) )
+						addInterpolator( interp );
+				}
+			}
 		}
+	}
 
-		nif->setArray<Vector3>( iData, "Vertices", vertices );
+	return blocks;
+}
 
-		if ( chkNormals->isChecked() ) {
-			QVector<Vector3> norms = nif->getArray<Vector3>( iData, "Normals" );
-			QMutableVectorIterator<Vector3> it( norms );
+//! Uniformly rescale a branch along with its skinning, collision and animation
+class spRescaleBranch final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Rescale Branch" ); }
+	QString page() const override final { return Spell::tr( "Transform" ); }
 
-			while ( it.hasNext() ) {
-				Vector3 & v = it.next();
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif->isNiBlock( index ) && nif->inherits( index, "NiAVObject" );
+	}
 
-				for ( int a = 0; a < 3; a++ )
-					v[a] *= scale[a]->value();
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		bool ok = false;
+		float s = QInputDialog::getDouble( nullptr, Spell::tr( "Rescale Branch" ), Spell::tr( "Scale factor" ), 1.0, 0.0001, 10000.0, 4, &ok );
+		if ( !ok || s == 1.0f )
+			return index;
+
+		QPersistentModelIndex iRoot = index;
+		int root = nif->getBlockNumber( index );
+
+		Matrix linear;
+		for ( int a = 0; a < 3; a++ )
+			linear( a, a ) = s;
+
+		// Keyframe interpolators mark unused channels with -FLT_MAX
+		auto valid = []( const Vector3 & v ) {
+			return std::abs( v[0] ) < 1e30f && std::abs( v[1] ) < 1e30f && std::abs( v[2] ) < 1e30f;
+		};
+
+		auto scale3 = [nif, s, &valid]( const QModelIndex & parent, const QString & name ) {
+			QModelIndex idx = nif->getIndex( parent, name );
+			if ( idx.isValid() && valid( nif->get<Vector3>( idx ) ) )
+				nif->set<Vector3>( idx, nif->get<Vector3>( idx ) * s );
+		};
+
+		auto scale4 = [nif, s]( const QModelIndex & parent, const QString & name ) {
+			QModelIndex idx = nif->getIndex( parent, name );
+			if ( idx.isValid() ) {
+				Vector4 v = nif->get<Vector4>( idx );
+				nif->set<Vector4>( idx, Vector4( Vector3( v ) * s, v[3] ) );
+			}
+		};
+
+		auto scale1 = [nif, s]( const QModelIndex & parent, const QString & name ) {
+			QModelIndex idx = nif->getIndex( parent, name );
+			if ( idx.isValid() )
+				nif->set<float>( idx, nif->get<float>( idx ) * s );
+		};
+
+		auto scaleTranslation = [nif, &scale3]( const QModelIndex & iBlock ) {
+			QModelIndex t = nif->getIndex( iBlock, "Transform" );
+			if ( !t.isValid() )
+				t = nif->getIndex( iBlock, "Skin Transform" );
+			scale3( t.isValid() ? t : iBlock, "Translation" );
+		};
+
+		auto scaleSphere = [nif, &scale3, &scale1]( const QModelIndex & iParent ) {
+			QModelIndex iSphere = nif->getIndex( iParent, "Bounding Sphere" );
+			if ( iSphere.isValid() ) {
+				scale3( iSphere, "Center" );
+				scale1( iSphere, "Radius" );
+			} else {
+				scale3( iParent, "Bounding Sphere Offset" );
+				scale1( iParent, "Bounding Sphere Radius" );
 			}
+		};
 
-			nif->setArray<Vector3>( iData, "Normals", norms );
+		// The root keeps its translation, so the animation of the root itself is kept too
+		QSet<int> rootAnimation = ownTransformAnimation( nif, root );
+
+		MeshTransform mesh;
+		bool mopp = false;
+
+		nif->beginTransaction();
+
+		for ( const auto b : branchBlocks( nif, root ) ) {
+			if ( rootAnimation.contains( b ) )
+				continue;
+
+			QModelIndex iBlock = nif->getBlock( b );
+
+			// The root keeps its place in its parent
+			if ( b != root && nif->inherits( iBlock, "NiAVObject" ) )
+				scaleTranslation( iBlock );
+
+			if ( nif->inherits( iBlock, "NiGeometryData" ) || nif->getIndex( iBlock, "Vertex Data" ).isValid() ) {
+				mesh.add( nif, iBlock, linear, Vector3(), false );
+			} else if ( nif->isNiBlock( iBlock, { "NiSkinData", "BSSkin::BoneData" } ) ) {
+				scaleTranslation( iBlock );
+
+				QModelIndex iBones = nif->getIndex( iBlock, "Bone List" );
+				for ( int i = 0; i < nif->rowCount( iBones ); i++ ) {
+					QModelIndex iBone = iBones.child( i, 0 );
+					scaleTranslation( iBone );
+					scaleSphere( iBone );
+				}
+			} else if ( nif->inherits( iBlock, "NiTransformInterpolator" ) ) {
+				scaleTranslation( iBlock );
+			} else if ( nif->inherits( iBlock, "NiKeyframeData" ) ) {
+				QModelIndex iKeys = nif->getIndex( nif->getIndex( iBlock, "Translations" ), "Keys" );
+				for ( int i = 0; i < nif->rowCount( iKeys ); i++ ) {
+					QModelIndex iKey = iKeys.child( i, 0 );
+					scale3( iKey, "Value" );
+					scale3( iKey, "Forward" );
+					scale3( iKey, "Backward" );
+				}
+			} else if ( nif->isNiBlock( iBlock, "BSBound" ) ) {
+				scale3( iBlock, "Center" );
+				scale3( iBlock, "Dimensions" );
+			} else if ( nif->inherits( iBlock, "bhkRigidBody" ) ) {
+				scale4( iBlock, "Translation" );
+				scale4( iBlock, "Center" );
+			} else if ( nif->isNiBlock( iBlock, { "bhkTransformShape", "bhkConvexTransformShape" } ) ) {
+				Matrix4 tm = nif->get<Matrix4>( iBlock, "Transform" );
+				Vector3 trans, scale;
+				Matrix rot;
+				tm.decompose( trans, rot, scale );
+				tm.compose( trans * s, rot, scale );
+				nif->set<Matrix4>( iBlock, "Transform", tm );
+			} else if ( nif->isNiBlock( iBlock, "bhkConvexVerticesShape" ) ) {
+				QVector<Vector4> verts = nif->getArray<Vector4>( iBlock, "Vertices" );
+				for ( Vector4 & v : verts )
+					v = Vector4( Vector3( v ) * s, v[3] );
+				nif->setArray<Vector4>( iBlock, "Vertices", verts );
+
+				QVector<Vector4> norms = nif->getArray<Vector4>( iBlock, "Normals" );
+				for ( Vector4 & n : norms )
+					n[3] *= s;
+				nif->setArray<Vector4>( iBlock, "Normals", norms );
+
+				scale1( iBlock, "Radius" );
+			} else if ( nif->isNiBlock( iBlock, { "bhkSphereShape", "bhkBoxShape" } ) ) {
+				scale1( iBlock, "Radius" );
+				scale3( iBlock, "Dimensions" );
+			} else if ( nif->isNiBlock( iBlock, "bhkCapsuleShape" ) ) {
+				scale3( iBlock, "First Point" );
+				scale3( iBlock, "Second Point" );
+				scale1( iBlock, "Radius" );
+				scale1( iBlock, "Radius 1" );
+				scale1( iBlock, "Radius 2" );
+			} else if ( nif->isNiBlock( iBlock, "bhkCylinderShape" ) ) {
+				scale4( iBlock, "Vertex A" );
+				scale4( iBlock, "Vertex B" );
+				scale1( iBlock, "Radius" );
+				scale1( iBlock, "Cylinder Radius" );
+			} else if ( nif->isNiBlock( iBlock, "bhkMultiSphereShape" ) ) {
+				QModelIndex iSpheres = nif->getIndex( iBlock, "Spheres" );
+				for ( int i = 0; i < nif->rowCount( iSpheres ); i++ ) {
+					scale3( iSpheres.child( i, 0 ), "Center" );
+					scale1( iSpheres.child( i, 0 ), "Radius" );
+				}
+			} else if ( nif->isNiBlock( iBlock, "hkPackedNiTriStripsData" ) ) {
+				QVector<Vector3> verts = nif->getArray<Vector3>( iBlock, "Vertices" );
+				for ( Vector3 & v : verts )
+					v *= s;
+				nif->setArray<Vector3>( iBlock, "Vertices", verts );
+			} else if ( nif->isNiBlock( iBlock, "bhkMoppBvTreeShape" ) ) {
+				mopp = true;
+			}
 		}
 
-		return QModelIndex();
-	}
-};
+		// Uniform scale leaves the normals as they are
+		mesh.apply( nif );
 
-REGISTER_SPELL( spScaleVertices );
+		nif->commitTransaction();
+
+		if ( mopp )
+			Message::info( nullptr, Spell::tr( "The branch contains MOPP code, which must be updated to match the new scale." ) );
 
+		return iRoot;
+	}
+};
 
+REGISTER_SPELL( spRescaleBranch );
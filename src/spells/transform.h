@@ -3,6 +3,10 @@
 
 #include "spellbook.h"
 
+#include "gl/gltools/boundsphere.h"
+
+#include <QSet>
+
 class spApplyTransformation final : public Spell
 {
 public:
@@ -13,4 +17,70 @@ public:
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final;
 };
 
+//! Applies affine transforms to shape geometry in bulk
+/*!
+ * Geometry is read out of the model on the GUI thread, transformed on the
+ * thread pool and written back in one transaction. Positions, normals,
+ * tangents, bitangents and bounding spheres are handled together.
+ */
+class MeshTransform final
+{
+public:
+	//! Queues geometry for the transform \a linear * v + \a translation
+	/*!
+	 * \a index may be a NiGeometry, NiGeometryData, or any block with
+	 * "Vertex Data" (BSTriShape, NiSkinPartition). Geometry shared by
+	 * several shapes is only queued once.
+	 *
+	 * \param normals	Whether to transform the normals and tangent space too
+	 * \return		False if \a index holds neither vertices nor bounds, or was already queued
+	 */
+	bool add( const NifModel * nif, const QModelIndex & index, const Matrix & linear, const Vector3 & translation = Vector3(), bool normals = true );
+	bool add( const NifModel * nif, const QModelIndex & index, const Transform & t, bool normals = true );
+
+	//! Transforms all queued geometry, then writes it back in one transaction
+	void apply( NifModel * nif );
+
+	//! Number of queued geometry blocks
+	int count() const { return jobs.count(); }
+
+private:
+	struct Job
+	{
+		QPersistentModelIndex iData;
+		bool vertexData = false;
+		bool hasBound = false;
+
+		Matrix linear;
+		Matrix normal;
+		Vector3 translation;
+		float radiusScale = 1.0f;
+		bool normals = true;
+
+		QVector<Vector3> verts;
+		QVector<Vector3> norms;
+		QVector<Vector3> tangents;
+		QVector<Vector3> bitangents;
+		BoundSphere bound;
+	};
+
+	//! Rows of the fields of one BSVertexData, shared by all vertices of a shape
+	struct VertexRows
+	{
+		int vertex = -1;
+		int normal = -1;
+		int tangent = -1;
+		int bitangentX = -1;
+		int bitangentY = -1;
+		int bitangentZ = -1;
+	};
+
+	static VertexRows vertexRows( const NifModel * nif, const QModelIndex & iVertData );
+	static void compute( Job & job );
+	static void write( NifModel * nif, const Job & job );
+
+	QVector<Job> jobs;
+	QSet<int> blocks;
+};
+
 #endif
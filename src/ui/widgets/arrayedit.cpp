@@ -0,0 +1,337 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#include "arrayedit.h"
+
+#include "message.h"
+#include "model/nifmodel.h"
+#include "model/undocommands.h"
+
+#include <QHeaderView>
+#include <QLayout>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableView>
+#include <QUndoStack>
+
+#include <algorithm>
+
+
+//! @file arrayedit.cpp ArrayTableModel, ArrayEdit
+
+ArrayTableModel::ArrayTableModel( NifModel * n, const QModelIndex & array, QObject * parent )
+	: QAbstractTableModel( parent ), nif( n ), iArray( array )
+{
+	connect( nif, &NifModel::dataChanged, this, &ArrayTableModel::nifDataChanged );
+	connect( nif, &NifModel::rowsInserted, this, &ArrayTableModel::nifRowsChanged );
+	connect( nif, &NifModel::rowsRemoved, this, &ArrayTableModel::nifRowsChanged );
+	connect( nif, &NifModel::modelReset, this, &ArrayTableModel::reset );
+
+	reset();
+}
+
+void ArrayTableModel::reset()
+{
+	beginResetModel();
+
+	fieldRows.clear();
+	fieldNames.clear();
+	fetched = 0;
+
+	if ( nif && iArray.isValid() ) {
+		// The fields of the first element are the columns of every element
+		QModelIndex first = nif->index( 0, 0, iArray );
+		for ( int r = 0; first.isValid() && r < nif->rowCount( first ); r++ ) {
+			QModelIndex field = nif->index( r, 0, first );
+			auto item = static_cast<NifItem *>( field.internalPointer() );
+			if ( item && item->condition() ) {
+				fieldRows.append( r );
+				fieldNames.append( nif->itemName( field ) );
+			}
+		}
+
+		fetched = std::min( nif->rowCount( iArray ), pageSize );
+	}
+
+	endResetModel();
+}
+
+int ArrayTableModel::rowCount( const QModelIndex & parent ) const
+{
+	return parent.isValid() ? 0 : fetched;
+}
+
+int ArrayTableModel::columnCount( const QModelIndex & parent ) const
+{
+	if ( parent.isValid() )
+		return 0;
+
+	return fieldRows.isEmpty() ? 1 : fieldRows.count();
+}
+
+QModelIndex ArrayTableModel::fieldIndex( const QModelIndex & index ) const
+{
+	if ( !nif || !iArray.isValid() || !index.isValid() || index.row() >= fetched )
+		return QModelIndex();
+
+	if ( fieldRows.isEmpty() )
+		return nif->index( index.row(), NifModel::ValueCol, iArray );
+
+	QModelIndex element = nif->index( index.row(), 0, iArray );
+	return nif->index( fieldRows.value( index.column() ), NifModel::ValueCol, element );
+}
+
+QVariant ArrayTableModel::data( const QModelIndex & index, int role ) const
+{
+	QModelIndex field = fieldIndex( index );
+	if ( !field.isValid() )
+		return QVariant();
+
+	switch ( role ) {
+	case Qt::DisplayRole:
+	case Qt::ToolTipRole:
+		return nif->data( field, role );
+	case Qt::EditRole:
+		return nif->getValue( field ).toString();
+	default:
+		return QVariant();
+	}
+}
+
+bool ArrayTableModel::setData( const QModelIndex & index, const QVariant & value, int role )
+{
+	QModelIndex field = fieldIndex( index );
+	if ( role != Qt::EditRole || !field.isValid() )
+		return false;
+
+	NifValue oldValue = nif->getValue( field );
+	NifValue newValue = oldValue;
+	if ( !newValue.setFromString( value.toString() ) )
+		return false;
+
+	// Value is unchanged, do not push to Undo Stack
+	if ( newValue.toString() == oldValue.toString() )
+		return true;
+
+	ChangeValueCommand::createTransaction();
+	nif->undoStack->push( new ChangeValueCommand( field, oldValue, newValue, headerData( index.column(), Qt::Horizontal ).toString(), nif ) );
+
+	return true;
+}
+
+QVariant ArrayTableModel::headerData( int section, Qt::Orientation orientation, int role ) const
+{
+	if ( role != Qt::DisplayRole )
+		return QVariant();
+
+	if ( orientation == Qt::Vertical )
+		return section;
+
+	return fieldRows.isEmpty() ? tr( "Value" ) : fieldNames.value( section );
+}
+
+Qt::ItemFlags ArrayTableModel::flags( const QModelIndex & index ) const
+{
+	QModelIndex field = fieldIndex( index );
+	if ( !field.isValid() )
+		return Qt::NoItemFlags;
+
+	// Strings are shared through the header and nested compounds have no value of their own
+	const NifValue & value = nif->getValue( field );
+	if ( value.type() == NifValue::tNone || value.isString()
+		 || value.type() == NifValue::tStringIndex || value.type() == NifValue::tFilePath )
+		return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+
+	return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable;
+}
+
+bool ArrayTableModel::canFetchMore( const QModelIndex & parent ) const
+{
+	return !parent.isValid() && nif && iArray.isValid() && fetched < nif->rowCount( iArray );
+}
+
+void ArrayTableModel::fetchMore( const QModelIndex & parent )
+{
+	if ( !canFetchMore( parent ) )
+		return;
+
+	int count = std::min( pageSize, nif->rowCount( iArray ) - fetched );
+
+	beginInsertRows( QModelIndex(), fetched, fetched + count - 1 );
+	fetched += count;
+	endInsertRows();
+}
+
+void ArrayTableModel::fetchTo( int row )
+{
+	while ( row >= fetched && canFetchMore( QModelIndex() ) )
+		fetchMore( QModelIndex() );
+}
+
+int ArrayTableModel::find( const QString & text, int start ) const
+{
+	if ( !nif || !iArray.isValid() || text.isEmpty() )
+		return -1;
+
+	// Searches the model directly, the elements after the fetched pages are only fetched for a match
+	int count = nif->rowCount( iArray );
+	for ( int i = 0; i < count; i++ ) {
+		int r = ( start + i ) % count;
+
+		if ( fieldRows.isEmpty() ) {
+			if ( nif->data( nif->index( r, NifModel::ValueCol, iArray ) ).toString().contains( text, Qt::CaseInsensitive ) )
+				return r;
+			continue;
+		}
+
+		QModelIndex element = nif->index( r, 0, iArray );
+		for ( int f : fieldRows ) {
+			if ( nif->data( nif->index( f, NifModel::ValueCol, element ) ).toString().contains( text, Qt::CaseInsensitive ) )
+				return r;
+		}
+	}
+
+	return -1;
+}
+
+bool ArrayTableModel::inArray( const QModelIndex & index ) const
+{
+	for ( QModelIndex i = index; i.isValid(); i = i.parent() ) {
+		if ( i == iArray )
+			return true;
+	}
+
+	return false;
+}
+
+int ArrayTableModel::elementRow( const QModelIndex & index ) const
+{
+	QModelIndex i = index;
+	while ( i.isValid() && i.parent() != iArray )
+		i = i.parent();
+
+	return i.isValid() ? i.row() : -1;
+}
+
+void ArrayTableModel::nifDataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight )
+{
+	if ( fetched == 0 || !iArray.isValid() )
+		return;
+
+	int first = 0;
+	int last = fetched - 1;
+
+	if ( inArray( topLeft.parent() ) ) {
+		// Only the elements holding the changed items
+		first = elementRow( topLeft );
+		last = std::min( elementRow( bottomRight ), last );
+	} else {
+		// The array itself or an item above it is in the changed range, eg. its block after a spell
+		bool spansArray = false;
+		for ( QModelIndex i = iArray; i.isValid() && !spansArray; i = i.parent() )
+			spansArray = ( i.parent() == topLeft.parent() && i.row() >= topLeft.row() && i.row() <= bottomRight.row() );
+
+		if ( !spansArray )
+			return;
+	}
+
+	if ( first >= 0 && first <= last )
+		emit dataChanged( index( first, 0 ), index( last, columnCount() - 1 ) );
+}
+
+void ArrayTableModel::nifRowsChanged( const QModelIndex & parent )
+{
+	// Elements were added or removed, or the array itself went away
+	if ( !iArray.isValid() || inArray( parent ) )
+		reset();
+}
+
+
+/*
+ *  ArrayEdit
+ */
+
+ArrayEdit::ArrayEdit( NifModel * n, const QModelIndex & array )
+	: QWidget( n->getWindow(), Qt::Tool ), nif( n )
+{
+	setAttribute( Qt::WA_DeleteOnClose );
+	setWindowTitle( tr( "%1 [%2]" ).arg( nif->itemName( array ) ).arg( nif->rowCount( array ) ) );
+
+	connect( nif, &NifModel::destroyed, this, &ArrayEdit::close );
+
+	table = new ArrayTableModel( nif, array, this );
+
+	view = new QTableView;
+	view->setModel( table );
+	view->horizontalHeader()->setStretchLastSection( true );
+	view->verticalHeader()->setDefaultSectionSize( view->fontMetrics().height() + 4 );
+
+	findEdit = new QLineEdit;
+	findEdit->setPlaceholderText( tr( "Find value" ) );
+	connect( findEdit, &QLineEdit::returnPressed, this, &ArrayEdit::findNext );
+
+	QPushButton * btFind = new QPushButton( tr( "Find Next" ) );
+	connect( btFind, &QPushButton::clicked, this, &ArrayEdit::findNext );
+
+	QHBoxLayout * findLayout = new QHBoxLayout;
+	findLayout->addWidget( findEdit );
+	findLayout->addWidget( btFind );
+
+	QVBoxLayout * layout = new QVBoxLayout;
+	layout->addLayout( findLayout );
+	layout->addWidget( view );
+	setLayout( layout );
+
+	resize( 640, 480 );
+}
+
+void ArrayEdit::findNext()
+{
+	QString text = findEdit->text();
+	if ( text.isEmpty() )
+		return;
+
+	int start = view->currentIndex().isValid() ? view->currentIndex().row() + 1 : 0;
+	int row = table->find( text, start );
+
+	if ( row < 0 ) {
+		Message::info( this, tr( "No element contains \"%1\"." ).arg( text ) );
+		return;
+	}
+
+	table->fetchTo( row );
+
+	QModelIndex index = table->index( row, std::max( view->currentIndex().column(), 0 ) );
+	view->setCurrentIndex( index );
+	view->scrollTo( index, QAbstractItemView::PositionAtCenter );
+}
@@ -0,0 +1,126 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+
+#ifndef ARRAYEDIT_H
+#define ARRAYEDIT_H
+
+#include <QAbstractTableModel> // Inherited
+#include <QWidget>             // Inherited
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+
+//! @file arrayedit.h ArrayTableModel, ArrayEdit
+
+class NifModel;
+class QLineEdit;
+class QTableView;
+
+/*! Presents the elements of a NifModel array as table rows, with one column per field
+ *
+ * The array is exposed in pages of pageSize rows through canFetchMore() and fetchMore(),
+ * so views only ever create indexes for the elements scrolled to. Edits are pushed to the
+ * NifModel undo stack like edits in the tree.
+ */
+class ArrayTableModel final : public QAbstractTableModel
+{
+	Q_OBJECT
+
+public:
+	ArrayTableModel( NifModel * nif, const QModelIndex & array, QObject * parent = nullptr );
+
+	int rowCount( const QModelIndex & parent = QModelIndex() ) const override final;
+	int columnCount( const QModelIndex & parent = QModelIndex() ) const override final;
+	QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const override final;
+	bool setData( const QModelIndex & index, const QVariant & value, int role = Qt::EditRole ) override final;
+	QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole ) const override final;
+	Qt::ItemFlags flags( const QModelIndex & index ) const override final;
+
+	bool canFetchMore( const QModelIndex & parent ) const override final;
+	void fetchMore( const QModelIndex & parent ) override final;
+
+	//! The NifModel value index shown at \a index
+	QModelIndex fieldIndex( const QModelIndex & index ) const;
+	//! The first element from \a start on, wrapping around, with a field containing \a text; -1 if there is none
+	int find( const QString & text, int start ) const;
+	//! Fetch the pages up to \a row
+	void fetchTo( int row );
+
+	//! Rows fetched at once
+	static constexpr int pageSize = 1000;
+
+public slots:
+	//! Rereads the fields and starts again from the first page
+	void reset();
+
+protected slots:
+	void nifDataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight );
+	void nifRowsChanged( const QModelIndex & parent );
+
+private:
+	//! Whether \a index is the array or below it
+	bool inArray( const QModelIndex & index ) const;
+	//! The row of the element holding \a index, which is below the array
+	int elementRow( const QModelIndex & index ) const;
+
+	QPointer<NifModel> nif;
+	QPersistentModelIndex iArray;
+
+	//! Rows of the shown fields in each element, empty for arrays of plain values
+	QVector<int> fieldRows;
+	QStringList fieldNames;
+	//! Number of rows fetched so far
+	int fetched = 0;
+};
+
+//! A tool window editing an array as a table, for arrays too large to browse in the tree
+class ArrayEdit final : public QWidget
+{
+	Q_OBJECT
+
+public:
+	ArrayEdit( NifModel * nif, const QModelIndex & array );
+
+protected slots:
+	void findNext();
+
+protected:
+	QPointer<NifModel> nif;
+	ArrayTableModel * table;
+	QTableView * view;
+	QLineEdit * findEdit;
+};
+
+#endif // ARRAYEDIT_H
@@ -41,9 +41,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMimeData>
 #include <QClipboard>
 #include <QKeyEvent>
+#include <QSet>
 
 #include <vector>
 
+//! Arrays with more rows than this are not expanded or scanned automatically
+static const int ARRAY_LIMIT = 100;
+
 NifTreeView::NifTreeView( QWidget * parent, Qt::WindowFlags flags ) : QTreeView()
 {
 	Q_UNUSED( flags );
@@ -51,6 +55,7 @@ NifTreeView::NifTreeView( QWidget * parent, Qt::WindowFlags flags ) : QTreeView(
 	setParent( parent );
 
 	connect( this, &NifTreeView::expanded, this, &NifTreeView::scrollExpand );
+	connect( this, &NifTreeView::expanded, this, &NifTreeView::updateExpandedConditions );
 }
 
 NifTreeView::~NifTreeView()
@@ -62,6 +67,8 @@ void NifTreeView::setModel( QAbstractItemModel * model )
 	if ( nif )
 		disconnect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
 
+	pendingConditions.clear();
+
 	nif = qobject_cast<BaseModel *>( model );
 
 	QTreeView::setModel( model );
@@ -123,8 +130,13 @@ void NifTreeView::setAllExpanded( const QModelIndex & index, bool e )
 		QModelIndex child = model()->index( r, 0, index );
 
 		if ( model()->hasChildren( child ) ) {
+			// The elements of huge arrays are left as they are unless collapsing an expanded one
+			bool recurse = model()->rowCount( child ) <= ARRAY_LIMIT || ( !e && isExpanded( child ) );
+
 			setExpanded( child, e );
-			setAllExpanded( child, e );
+
+			if ( recurse )
+				setAllExpanded( child, e );
 		}
 	}
 }
@@ -284,8 +296,66 @@ void NifTreeView::updateConditions( const QModelIndex & topLeft, const QModelInd
 	if ( nif->getState() != BaseModel::Default )
 		return;
 
-	Q_UNUSED( bottomRight );
-	updateConditionRecurse( topLeft.parent() );
+	if ( topLeft.parent() == bottomRight.parent() ) {
+		queueDependentConditions( topLeft.parent(), topLeft.row(), bottomRight.row() );
+	} else {
+		queueDependentConditions( topLeft.parent(), topLeft.row(), topLeft.row() );
+		queueDependentConditions( bottomRight.parent(), bottomRight.row(), bottomRight.row() );
+	}
+}
+
+void NifTreeView::queueDependentConditions( const QModelIndex & parent, int first, int last )
+{
+	if ( first > last )
+		std::swap( first, last );
+
+	NifItem * p = static_cast<NifItem *>(parent.internalPointer());
+	if ( !p ) {
+		// Block level change, any field of these blocks may have changed so recheck each of them as a whole
+		for ( int r = first; r <= last && r < model()->rowCount( parent ); r++ )
+			pendingConditions.append( model()->index( r, 0, parent ) );
+	} else {
+		QSet<QString> names;
+		for ( int r = first; r <= last && r < p->childCount(); r++ )
+			names.insert( p->child( r )->name() );
+
+		// Same dependency test as NifModel::invalidateDependentConditions: only later siblings
+		//	naming a changed field in their condition or arguments can change visibility
+		for ( int r = first; r < p->childCount(); r++ ) {
+			NifItem * c = p->child( r );
+			if ( c->cond().isEmpty() && c->arg().isEmpty() )
+				continue;
+
+			for ( const QString & name : names ) {
+				if ( c->cond().contains( name ) || c->arg().contains( name ) ) {
+					pendingConditions.append( model()->index( r, 0, parent ) );
+					break;
+				}
+			}
+		}
+	}
+
+	if ( !pendingConditions.isEmpty() && !conditionsQueued ) {
+		conditionsQueued = true;
+		QMetaObject::invokeMethod( this, "flushConditions", Qt::QueuedConnection );
+	}
+}
+
+void NifTreeView::flushConditions()
+{
+	conditionsQueued = false;
+
+	QList<QPersistentModelIndex> pending;
+	pending.swap( pendingConditions );
+
+	if ( !nif || pending.isEmpty() )
+		return;
+
+	for ( const QPersistentModelIndex & index : pending ) {
+		if ( index.isValid() && index.model() == nif )
+			updateConditionRecurse( index );
+	}
+
 	doItemsLayout();
 }
 
@@ -302,14 +372,23 @@ void NifTreeView::updateConditionRecurse( const QModelIndex & index )
 	if ( item->parent() && item->parent()->isArray() && !item->childCount() )
 		return;
 
-	for ( int r = 0; r < model()->rowCount( index ); r++ ) {
-		QModelIndex child = model()->index( r, 0, index );
-		updateConditionRecurse( child );
+	// Rows below a collapsed item are updated once it is expanded
+	if ( index == rootIndex() || isExpanded( index ) ) {
+		for ( int r = 0; r < model()->rowCount( index ); r++ ) {
+			QModelIndex child = model()->index( r, 0, index );
+			updateConditionRecurse( child );
+		}
 	}
 
 	setRowHidden( index.row(), index.parent(), doRowHiding && !item->condition() );
 }
 
+void NifTreeView::updateExpandedConditions( const QModelIndex & index )
+{
+	if ( nif && doRowHiding && index.model() == nif )
+		updateConditionRecurse( index );
+}
+
 auto splitMime = []( QString format ) {
 	QStringList split = format.split( "/" );
 	if ( split.value( 0 ) == "nifskope"
@@ -488,7 +567,6 @@ void NifTreeView::currentChanged( const QModelIndex & current, const QModelIndex
 	auto mdl = static_cast<NifModel *>( nif );
 	if ( mdl && mdl->isNiBlock( current ) ) {
 		auto cnt = mdl->rowCount( current );
-		const int ARRAY_LIMIT = 100;
 		if ( mdl->inherits( current, "NiTransformInterpolator" ) 
 			 || mdl->inherits( current, "NiBSplineTransformInterpolator" ) ) {
 			// Auto-Expand NiQuatTransform
@@ -83,6 +83,10 @@ public slots:
 protected slots:
 	//! Recursively updates version conditions
 	void updateConditionRecurse( const QModelIndex & index );
+	//! Updates the rows queued by updateConditions() in one pass
+	void flushConditions();
+	//! Updates version conditions below a newly expanded item; connected to expanded()
+	void updateExpandedConditions( const QModelIndex & index );
 	//! Called when the current index changes
 	void currentChanged( const QModelIndex & current, const QModelIndex & previous ) override final;
 
@@ -97,9 +101,16 @@ protected:
 
 	void autoExpand( const QModelIndex & index );
 
+	//! Queues the rows whose conditions may depend on rows first to last of parent, or the whole blocks for top-level rows
+	void queueDependentConditions( const QModelIndex & parent, int first, int last );
+
 	bool doRowHiding = true;
 	bool autoExpanded = false;
 
+	//! Rows whose visibility is updated on the next event loop pass
+	QList<QPersistentModelIndex> pendingConditions;
+	bool conditionsQueued = false;
+
 	class BaseModel * nif = nullptr;
 
 	//! Row Copy